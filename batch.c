@@ -0,0 +1,312 @@
+#include "index.h"
+#include "assert.h"
+#include "card.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @file batch.c
+ * @brief 삽입 묶음을 트리에 위에서부터 한 번에 내려보내는 삽입입니다.
+ *
+ * @details 묶음을 Hilbert 값으로 정렬한 후에 루트에서부터 내려가면서
+ * 노드마다 묶음을 자식별로 나눕니다. (buffer tree 방식)
+ * - 노드 하나는 묶음 하나에 한 번만 방문하므로 데이터마다 루트에서부터
+ *   내려가는 RTreeInsertRect보다 방문하는 노드의 수가 훨씬 적습니다.
+ * - 넘친 노드는 데이터 하나씩 분할하지 않고 원래의 브랜치와 새로운 브랜치를
+ *   Hilbert 값으로 정렬해서 필요한 수의 노드에 고르게 나눕니다.
+ *   나눠진 노드들은 부모에 한 번에 넣으므로 부모도 같은 방법으로 나눕니다.
+ * 자식을 고르는 기준은 트리에 설정된 방법의 RTreePickBranch(Hilbert R-tree는
+ * RTreeHilbertPick)이고, 자식을 고를 때는 묶음을 넣기 전의 사각형을 봅니다.
+ * 앞의 데이터가 고른 자식이 늘어나지 않고 받을 수 있으면 다시 고르지 않으므로
+ * 겹친 자식들 중에서는 RTreePickBranch와 다른 자식을 고를 수 있습니다.
+ */
+
+/**
+ * @brief 묶음 하나를 넣는 동안 사용하는 작업 공간입니다.
+ *
+ * @details 모두 처음에 한 번 할당하므로 트리를 고치기 시작한 후에는 메모리가
+ * 부족해서 실패하는 일이 없습니다.
+ */
+struct RTreeBatch {
+	struct RTree *t;
+	int n; /* 묶음의 크기 */
+	int *pick; /* 자식별로 나눌 때 데이터마다 고른 브랜치 (n) */
+	struct RTreeHilbertEntry *tmp; /* 자식별로 나눌 때의 공간 (n) */
+	struct RTreeHilbertEntry *split; /* 넘친 노드의 브랜치들 (ANYMAXCARD + n) */
+	struct RTreeHilbertEntry *sib; /* level마다 자식이 나눠진 노드들 (n) */
+};
+
+static int RTreeCompareKey(const void *A, const void *B)
+{
+	uint64_t a = ((const struct RTreeHilbertEntry *)A)->key;
+	uint64_t b = ((const struct RTreeHilbertEntry *)B)->key;
+	return (a > b) - (a < b);
+}
+
+/**
+ * @brief level에 들어갈 브랜치를 정렬하는 Hilbert 값을 구합니다.
+ *
+ * @details Hilbert R-tree의 내장 노드는 자식의 LHV를, 나머지는 사각형의
+ * 중심의 Hilbert 값을 사용합니다.
+ */
+static uint64_t RTreeBatchKey(struct RTree *t, int level, struct Branch *b)
+{
+#ifdef RTREE_HILBERT
+	if (t->method == RTREE_HILBERT_TREE && level > 0)
+		return RTreeNodeLhv(b->child);
+#endif
+	(void)t;
+	(void)level;
+	return RTreeHilbertKey(&b->rect);
+}
+
+/**
+ * @brief 노드에 브랜치들을 넣고, 넘치면 여러 노드로 나눕니다.
+ *
+ * @details 넘치는 경우에는 노드의 브랜치와 새로운 브랜치를 Hilbert 값으로
+ * 정렬해서 꽉 채운 노드 수로 나눈 만큼의 노드에 고르게 나눕니다.
+ * 첫 번째 몫은 n에 그대로 두므로 n의 부모에는 나머지 노드들만 더합니다.
+ *
+ * @param bt 작업 공간에 해당합니다.
+ * @param n 브랜치를 넣을 노드
+ * @param e 넣을 브랜치들
+ * @param m 넣을 브랜치의 수
+ * @param out n이 나눠지면 새로운 노드의 브랜치들이 들어갑니다.
+ *
+ * @return 새로운 노드의 수
+ */
+static int RTreeBatchAdd(struct RTreeBatch *bt, struct Node *n,
+			 struct RTreeHilbertEntry *e, int m,
+			 struct RTreeHilbertEntry *out)
+{
+	register struct RTree *t = bt->t;
+	register struct RTreeHilbertEntry *buf = bt->split;
+	struct Node *nn;
+	int i, j, k, total, level = n->level, max = MAXKIDS(t, n);
+
+	if (n->count + m <= max) {
+		for (i = 0; i < m; i++)
+			RTreeAddBranch(t, &e[i].branch, n, NULL);
+		return 0;
+	}
+
+	for (i = 0; i < n->count; i++) {
+		RTreeGetBranch(n, i, &buf[i].branch);
+		buf[i].key = RTreeBatchKey(t, level, &buf[i].branch);
+	}
+	memcpy(buf + n->count, e, m * sizeof(struct RTreeHilbertEntry));
+	total = n->count + m;
+	qsort(buf, total, sizeof(struct RTreeHilbertEntry), RTreeCompareKey);
+
+	k = (total + max - 1) / max;
+	RTreeInitNode(n);
+	for (i = 0, j = 0; i < k; i++) {
+		nn = i == 0 ? n : RTreeNewNode(t);
+		nn->level = level;
+		for (; j < (long)total * (i + 1) / k; j++)
+			RTreeAddBranch(t, &buf[j].branch, nn, NULL);
+		if (i == 0)
+			continue;
+		out[i - 1].branch.child = nn;
+		out[i - 1].branch.rect = RTreeNodeCover(nn);
+		out[i - 1].key =
+			RTreeBatchKey(t, level + 1, &out[i - 1].branch);
+	}
+	return k - 1;
+}
+
+/**
+ * @brief n을 루트로 하는 서브트리에 데이터들을 넣습니다.
+ *
+ * @details 데이터들을 자식별로 나눈 후에 자식마다 재귀적으로 넣고, 나눠진
+ * 자식들의 새로운 노드를 n에 한 번에 넣습니다. 자식별로 나눌 때 순서를
+ * 유지하므로 자식에게 넘기는 데이터도 Hilbert 값으로 정렬되어 있습니다.
+ *
+ * @param bt 작업 공간에 해당합니다.
+ * @param n 서브트리의 루트
+ * @param e 넣을 데이터들, 자식별로 다시 정렬됩니다.
+ * @param m 넣을 데이터의 수
+ * @param out n이 나눠지면 새로운 노드의 브랜치들이 들어갑니다.
+ *
+ * @return 새로운 노드의 수
+ */
+static int RTreeBatchInsert2(struct RTreeBatch *bt, struct Node *n,
+			     struct RTreeHilbertEntry *e, int m,
+			     struct RTreeHilbertEntry *out)
+{
+	register struct RTree *t = bt->t;
+	struct RTreeHilbertEntry *sib;
+	struct Rect cover;
+	int start[ANYMAXCARD + 1], pos[ANYMAXCARD];
+	register int i, c;
+	int nsib = 0, split;
+
+	if (n->level == 0)
+		return RTreeBatchAdd(bt, n, e, m, out);
+
+	/**
+	 * @brief 데이터마다 자식을 고르고, 자식별로 모이도록 순서를 유지하며
+	 * 나눕니다. (counting sort) 묶음은 Hilbert 순서이므로 앞의 데이터가 고른
+	 * 자식의 사각형 안에 들어가는 데이터는 늘리지 않아도 되는 그 자식으로
+	 * 바로 보냅니다.
+	 */
+	memset(start, 0, (n->count + 1) * sizeof(int));
+	for (i = 0, c = -1; i < m; i++) {
+#ifdef RTREE_HILBERT
+		if (t->method == RTREE_HILBERT_TREE)
+			c = RTreeHilbertPick(n, e[i].key);
+		else
+#endif
+		if (c < 0 || !RTreeContained(&e[i].branch.rect,
+					     &n->branch[c].rect))
+			c = RTreePickBranch(t, &e[i].branch.rect, n);
+		bt->pick[i] = c;
+		start[c + 1]++;
+	}
+	for (c = 0; c < n->count; c++) {
+		start[c + 1] += start[c];
+		pos[c] = start[c];
+	}
+	for (i = 0; i < m; i++)
+		bt->tmp[pos[bt->pick[i]]++] = e[i];
+	memcpy(e, bt->tmp, m * sizeof(struct RTreeHilbertEntry));
+
+	/**
+	 * @brief 자식의 분할로 생긴 노드들은 level마다 따로 둔 공간에 모읍니다.
+	 * 나눠지지 않은 자식의 사각형은 넣은 데이터들로 늘리기만 합니다.
+	 */
+	sib = bt->sib + (size_t)n->level * bt->n;
+	for (c = 0; c < n->count; c++) {
+		if (start[c] == start[c + 1])
+			continue;
+		split = RTreeBatchInsert2(bt, n->branch[c].child, e + start[c],
+					  start[c + 1] - start[c], sib + nsib);
+		if (split) {
+			cover = RTreeNodeCover(n->branch[c].child);
+		} else {
+			cover = n->branch[c].rect;
+			for (i = start[c]; i < start[c + 1]; i++)
+				cover = RTreeCombineRect(&cover,
+							 &e[i].branch.rect);
+		}
+		RTreeSetBranchRect(n, c, &cover);
+#ifdef RTREE_HILBERT
+		RTreeUpdateAggregate(n, c);
+#else
+		if (split)
+			RTreeUpdateAggregate(n, c);
+		else
+			n->subcount[c] += start[c + 1] - start[c];
+#endif
+		nsib += split;
+	}
+	return RTreeBatchAdd(bt, n, sib, nsib, out);
+}
+
+/**
+ * @brief 데이터 묶음을 트리에 한 번에 삽입합니다.
+ *
+ * @details 묶음을 Hilbert 값으로 정렬한 후에 루트에서부터 한 번에 내려보내고,
+ * 루트가 나눠지면 하나가 될 때까지 새로운 루트를 만듭니다. RTREE_CONCURRENT로
+ * 빌드한 경우에는 RTreeInsertRect로 하나씩 넣습니다. 삽입한 데이터는 rects의
+ * is_use와 관계없이 살아있는 데이터가 됩니다.
+ *
+ * @param T 삽입할 트리에 해당합니다.
+ * @param Rects 삽입되는 사각형들에 해당합니다.
+ * @param Ids 삽입되는 사각형들의 id, 트리에 없는 서로 다른 id여야 합니다.
+ * @param N 삽입되는 사각형의 수
+ *
+ * @return 성공 시 0, 메모리가 부족한 경우 트리를 바꾸지 않고 -1을 반환합니다.
+ */
+int RTreeInsertBatch(struct RTree *T, struct Rect *Rects, tid_t *Ids, int N)
+{
+	register struct RTree *t = T;
+	struct RTreeBatch bt;
+	struct RTreeHilbertEntry *e, *sib, *out;
+	struct Node *newroot;
+	struct Branch b;
+	int i, height, nsib;
+	long nodes;
+
+	assert(t && N >= 0 && t->root);
+	if (N == 0)
+		return 0;
+	assert(Rects && Ids);
+
+#ifdef RTREE_CONCURRENT
+	for (i = 0; i < N; i++)
+		if (RTreeInsertRect(t, &Rects[i], Ids[i], 0) < 0)
+			return -1;
+	return 0;
+#endif
+	for (i = 0; i < N; i++)
+		if (RTreeReserveId(t, Ids[i]))
+			return -1;
+
+	/**
+	 * @brief m개를 받은 노드는 많아야 ceil(m / card)개의 노드를 새로 만들고,
+	 * 데이터를 받는 노드는 level마다 N개, 전체로는 기존 노드의 수를 넘지
+	 * 않습니다. 따라서 새로운 노드는 2 * (N / card + 받는 노드의 수)와
+	 * 새로운 루트들을 넘지 않으므로 트리를 고치기 전에 확보해 둡니다.
+	 */
+	height = t->root->level;
+	nodes = (long)N * (height + 1);
+	if (nodes > (long)t->node_pool.nused)
+		nodes = t->node_pool.nused;
+	i = NODECARD(t) < LEAFCARD(t) ? NODECARD(t) : LEAFCARD(t);
+	nodes = 2 * (N / i + 1 + nodes + RTREE_MAX_DEPTH) + RTREE_MAX_DEPTH;
+	if (RTreeReserveNodes(t, nodes))
+		return -1;
+
+	/**
+	 * @brief 루트가 나눠질 때 새로운 루트의 입력과 출력으로 쓸 공간을
+	 * 두 level 더 둡니다.
+	 */
+	bt.t = t;
+	bt.n = N;
+	bt.pick = (int *)malloc(N * sizeof(int));
+	e = (struct RTreeHilbertEntry *)malloc(
+		N * sizeof(struct RTreeHilbertEntry));
+	bt.tmp = (struct RTreeHilbertEntry *)malloc(
+		N * sizeof(struct RTreeHilbertEntry));
+	bt.split = (struct RTreeHilbertEntry *)malloc(
+		(ANYMAXCARD + N) * sizeof(struct RTreeHilbertEntry));
+	bt.sib = (struct RTreeHilbertEntry *)malloc(
+		(size_t)(height + 3) * N * sizeof(struct RTreeHilbertEntry));
+	if (!bt.pick || !e || !bt.tmp || !bt.split || !bt.sib) {
+		nsib = -1;
+		goto out;
+	}
+
+	for (i = 0; i < N; i++) {
+		e[i].branch.rect = Rects[i];
+		e[i].branch.rect.is_use = true;
+		e[i].branch.child = (struct Node *)Ids[i];
+		e[i].key = RTreeHilbertKey(&e[i].branch.rect);
+	}
+	qsort(e, N, sizeof(struct RTreeHilbertEntry), RTreeCompareKey);
+
+	sib = bt.sib + (size_t)(height + 1) * N;
+	nsib = RTreeBatchInsert2(&bt, t->root, e, N, sib);
+	while (nsib > 0) { /**< 루트가 나눠진 경우 */
+		newroot = RTreeNewNode(t);
+		newroot->level = t->root->level + 1;
+		b.rect = RTreeNodeCover(t->root);
+		b.child = t->root;
+		RTreeAddBranch(t, &b, newroot, NULL);
+		t->root = newroot;
+		out = sib == bt.sib + (size_t)(height + 1) * N ?
+			      sib + N :
+			      sib - N;
+		nsib = RTreeBatchAdd(&bt, newroot, sib, nsib, out);
+		sib = out;
+	}
+
+out:
+	free(bt.pick);
+	free(e);
+	free(bt.tmp);
+	free(bt.split);
+	free(bt.sib);
+	return nsib < 0 ? -1 : 0;
+}
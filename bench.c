@@ -0,0 +1,395 @@
+/**
+ * @file bench.c
+ * @brief 삽입과 분할 방법, 부피 척도별로 트리를 만드는 시간과 탐색 시에
+ * 방문하는 노드의 수를 비교합니다.
+ *
+ * @details 사용법: bench [명령 파일] (기본값은 pin.txt)
+ * 방법과 척도마다 빈 트리에 '+'와 '-'를 순서대로 적용한 후에, 모든 '?'의 원을
+ * 감싸는 사각형으로 탐색하면서 방문한 노드의 수를 셉니다. 탐색은 갱신이 모두
+ * 끝난 최종 트리에 대해서 수행하므로 방법 사이의 트리 모양만 비교하게 됩니다.
+ * 부피 척도를 사용하지 않는 R*-tree와 Hilbert R-tree는 기본 척도로만 실행합니다.
+ * 방법마다 기본 척도로 lazy 삭제도 실행해서 삭제 하나에 드는 재삽입 수를
+ * 비교합니다. 마지막으로 같은 갱신과 탐색을 LSM 방식의 forest로 실행합니다.
+ * KNN_EVERY개의 탐색마다 하나씩 원의 중심에서 가까운 KNN_K개를 최근접
+ * 탐색으로 찾아서 모든 데이터와 비교한 결과와 같은 지 확인합니다.
+ */
+
+#include "index.h"
+#include "cmd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define KNN_K 10 /**< 최근접 탐색을 확인할 때 찾는 데이터의 수 */
+#define KNN_EVERY 100 /**< 최근접 탐색을 확인하는 탐색의 간격 */
+
+/**
+ * @brief enum RTreeSplitMethod 순서의 방법 이름입니다.
+ */
+static const char *const method_names[METHODS] = {
+	"linear",
+	"rstar",
+	"quadratic",
+	"angtan",
+	"hilbert",
+};
+
+/**
+ * @brief enum RTreeAreaMetric 순서의 척도 이름입니다.
+ */
+static const char *const metric_names[METRICS] = {
+	"sphere",
+	"box",
+	"surface",
+	"fastsphere",
+};
+
+static struct Command *cmds;
+static long ncmds;
+static long max_id;
+
+/**
+ * @brief 명령 파일을 모두 읽어서 cmds에 넣습니다.
+ *
+ * @return 성공 시 0, 실패 시 -1
+ */
+static int LoadCommands(const char *path)
+{
+	struct CmdReader in;
+	struct Command *tmp;
+	long size = 1 << 16;
+	int ret;
+
+	if (CmdOpen(&in, path))
+		return -1;
+	cmds = (struct Command *)malloc(size * sizeof(struct Command));
+	while (cmds && (ret = CmdNext(&in, &cmds[ncmds])) > 0) {
+		if (cmds[ncmds].op != '?' && cmds[ncmds].id > max_id)
+			max_id = cmds[ncmds].id;
+		if (++ncmds < size)
+			continue;
+		size *= 2;
+		tmp = (struct Command *)realloc(cmds,
+						size * sizeof(struct Command));
+		if (!tmp)
+			free(cmds);
+		cmds = tmp;
+	}
+	CmdClose(&in);
+	return cmds && ret == 0 ? 0 : -1;
+}
+
+static double Now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief RTreeSearch와 같은 순서로 내려가면서 방문한 노드의 수를 셉니다.
+ */
+static long CountVisits(struct Node *n, struct Rect *r)
+{
+	long visits = 1;
+	int i;
+
+	if (n->level == 0)
+		return visits;
+	for (i = 0; i < n->count; i++)
+		if (RTreeOverlap(r, &n->branch[i].rect))
+			visits += CountVisits(n->branch[i].child, r);
+	return visits;
+}
+
+/**
+ * @brief 트리의 노드 수와 브랜치 수, 노드들이 가질 수 있는 브랜치 수를 셉니다.
+ */
+static void CountFill(struct Node *n, long *nodes, long *branches, long *slots)
+{
+	int i;
+
+	(*nodes)++;
+	*branches += n->count;
+	*slots += n->level > 0 ? MAXCARD : LEAFMAXCARD;
+	if (n->level == 0)
+		return;
+	for (i = 0; i < n->count; i++)
+		CountFill(n->branch[i].child, nodes, branches, slots);
+}
+
+/**
+ * @brief 최근접 탐색의 결과를 모든 데이터와 비교해서 구한 결과와 비교합니다.
+ *
+ * @details 거리가 같은 데이터는 어느 것이 먼저 나와도 되므로, 순서대로의
+ * 거리가 같은 지와 찾은 id들이 살아있고 그 거리에 있는 지를 확인합니다.
+ *
+ * @param point 기준점
+ * @param n 최근접 탐색이 찾은 데이터의 수
+ * @param ids 최근접 탐색이 찾은 id들
+ * @param d2s 최근접 탐색이 찾은 거리의 제곱들
+ *
+ * @return 같으면 0, 다르면 1
+ */
+static int CheckNearest(RectReal *point, int n, tid_t *ids, RectDist *d2s,
+			struct Rect *pos, bool *live)
+{
+	RectDist best[KNN_K], d2;
+	long id;
+	int i, m = 0;
+
+	for (id = 0; id <= max_id; id++) {
+		if (!live[id])
+			continue;
+		d2 = RTreeMinDist2(&pos[id], point);
+		if (m == KNN_K && d2 >= best[m - 1])
+			continue;
+		for (i = m < KNN_K ? m++ : m - 1; i > 0 && best[i - 1] > d2;
+		     i--)
+			best[i] = best[i - 1];
+		best[i] = d2;
+	}
+	if (n != m)
+		return 1;
+	for (i = 0; i < n; i++) {
+		if (d2s[i] != best[i] || ids[i] < 0 || ids[i] > max_id ||
+		    !live[ids[i]])
+			return 1;
+		if (RTreeMinDist2(&pos[ids[i]], point) != d2s[i])
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief 한 가지 방법과 척도로 트리를 만들고 탐색한 결과를 출력합니다.
+ *
+ * @param lazy 0이 아니면 기본 비율로 lazy 삭제를 사용합니다.
+ *
+ * @return 성공 시 0, 실패 시 -1
+ */
+static int Run(int method, int metric, int lazy, struct Rect *pos, bool *live)
+{
+	struct RTree *t;
+	struct Rect r;
+	struct Command *c;
+	struct RTreeDeleteStats ds;
+	RectReal point[NUMDIMS];
+	tid_t ids[KNN_K];
+	RectDist d2s[KNN_K];
+	double start, build, search;
+	long i, nqueries = 0, visits = 0, hits = 0, nupdates = 0;
+	long nodes = 0, branches = 0, slots = 0, nknn = 0, knn_errors = 0;
+	int n;
+
+	t = RTreeNewIndex();
+	if (!t)
+		return -1;
+	if (!RTreeSetSplitMethod(t, method) || !RTreeSetAreaMetric(t, metric) ||
+	    (lazy && !RTreeSetLazyDelete(t, RTREE_LAZY_NODE_PCT,
+					 RTREE_LAZY_TREE_PCT))) {
+		printf("%-9s %-10s %-5s not available in this build\n",
+		       method_names[method], metric_names[metric],
+		       lazy ? "lazy" : "eager");
+		RTreeFreeIndex(t);
+		return 0;
+	}
+
+	start = Now();
+	for (i = 0; i < ncmds; i++) {
+		c = &cmds[i];
+		if (c->op == '+' && !live[c->id]) {
+			pos[c->id].is_use = true;
+			pos[c->id].boundary[0] = pos[c->id].boundary[2] = c->x;
+			pos[c->id].boundary[1] = pos[c->id].boundary[3] = c->y;
+			RTreeInsertRect(t, &pos[c->id], c->id, 0);
+			live[c->id] = true;
+			nupdates++;
+		} else if (c->op == '-' && c->id <= max_id && live[c->id]) {
+			RTreeDeleteRect(t, &pos[c->id], c->id);
+			live[c->id] = false;
+			nupdates++;
+		}
+	}
+	build = Now() - start;
+
+	start = Now();
+	for (i = 0; i < ncmds; i++) {
+		c = &cmds[i];
+		if (c->op != '?')
+			continue;
+		r.boundary[0] = c->x - c->r;
+		r.boundary[1] = c->y - c->r;
+		r.boundary[2] = c->x + c->r;
+		r.boundary[3] = c->y + c->r;
+		visits += CountVisits(t->root, &r);
+		hits += RTreeSearch(t, &r, NULL, NULL);
+		nqueries++;
+	}
+	search = Now() - start;
+
+	for (i = 0; i < ncmds; i++) {
+		c = &cmds[i];
+		if (c->op != '?' || nknn++ % KNN_EVERY)
+			continue;
+		point[0] = c->x;
+		point[1] = c->y;
+		n = RTreeNearest(t, point, KNN_K, ids, d2s);
+		if (n < 0) {
+			RTreeFreeIndex(t);
+			return -1;
+		}
+		knn_errors += CheckNearest(point, n, ids, d2s, pos, live);
+	}
+
+	CountFill(t->root, &nodes, &branches, &slots);
+	RTreeGetDeleteStats(t, &ds);
+	printf("%-9s %-10s %-5s build %8.3fs  updates/s %9.0f  "
+	       "reinserts/delete %6.2f  height %d  nodes %7ld  fill %5.1f%%  "
+	       "search %8.3fs  visits/query %9.1f  hits/query %9.1f  "
+	       "knn errors %ld\n",
+	       method_names[method], metric_names[metric],
+	       lazy ? "lazy" : "eager", build,
+	       build > 0 ? nupdates / build : 0.0,
+	       ds.deletes ? (double)ds.reinserted / ds.deletes : 0.0,
+	       t->root->level + 1, nodes,
+	       100.0 * branches / slots, search,
+	       nqueries ? (double)visits / nqueries : 0.0,
+	       nqueries ? (double)hits / nqueries : 0.0, knn_errors);
+	RTreeFreeIndex(t);
+	return knn_errors ? -1 : 0;
+}
+
+/**
+ * @brief 같은 갱신과 탐색을 forest로 실행한 결과를 출력합니다.
+ *
+ * @details 갱신 시간에는 마지막 병합을 기다리는 시간도 포함합니다.
+ *
+ * @return 성공 시 0, 실패 시 -1
+ */
+static int RunForest(struct Rect *pos, bool *live)
+{
+	struct RTreeForest *f;
+	struct RTreeForestStats fs;
+	struct Rect r;
+	struct Command *c;
+	RectReal point[NUMDIMS];
+	tid_t ids[KNN_K];
+	RectDist d2s[KNN_K];
+	double start, build, search;
+	long i, nqueries = 0, hits = 0, nupdates = 0, nknn = 0, knn_errors = 0;
+	int n;
+
+	f = RTreeNewForest(RTREE_FOREST_BUFFER);
+	if (!f)
+		return -1;
+
+	start = Now();
+	for (i = 0; i < ncmds; i++) {
+		c = &cmds[i];
+		if (c->op == '+' && !live[c->id]) {
+			pos[c->id].is_use = true;
+			pos[c->id].boundary[0] = pos[c->id].boundary[2] = c->x;
+			pos[c->id].boundary[1] = pos[c->id].boundary[3] = c->y;
+			if (RTreeForestInsert(f, &pos[c->id], c->id))
+				break;
+			live[c->id] = true;
+			nupdates++;
+		} else if (c->op == '-' && c->id <= max_id && live[c->id]) {
+			RTreeForestDelete(f, c->id);
+			live[c->id] = false;
+			nupdates++;
+		}
+	}
+	if (i < ncmds || RTreeForestSync(f)) {
+		RTreeFreeForest(f);
+		return -1;
+	}
+	build = Now() - start;
+
+	start = Now();
+	for (i = 0; i < ncmds; i++) {
+		c = &cmds[i];
+		if (c->op != '?')
+			continue;
+		r.boundary[0] = c->x - c->r;
+		r.boundary[1] = c->y - c->r;
+		r.boundary[2] = c->x + c->r;
+		r.boundary[3] = c->y + c->r;
+		hits += RTreeForestSearch(f, &r, NULL, NULL);
+		nqueries++;
+	}
+	search = Now() - start;
+
+	for (i = 0; i < ncmds; i++) {
+		c = &cmds[i];
+		if (c->op != '?' || nknn++ % KNN_EVERY)
+			continue;
+		point[0] = c->x;
+		point[1] = c->y;
+		n = RTreeForestNearest(f, point, KNN_K, ids, d2s);
+		if (n < 0) {
+			RTreeFreeForest(f);
+			return -1;
+		}
+		knn_errors += CheckNearest(point, n, ids, d2s, pos, live);
+	}
+
+	RTreeGetForestStats(f, &fs);
+	printf("%-9s %-10s %-5s build %8.3fs  updates/s %9.0f  "
+	       "trees %2d  merges %5ld  rewrites/insert %6.2f  stalls %ld  "
+	       "search %8.3fs  hits/query %9.1f  knn errors %ld\n",
+	       "forest", "-", "lazy", build,
+	       build > 0 ? nupdates / build : 0.0, fs.trees, fs.merges,
+	       fs.inserts ? (double)fs.merged / fs.inserts : 0.0, fs.stalls,
+	       search, nqueries ? (double)hits / nqueries : 0.0, knn_errors);
+	RTreeFreeForest(f);
+	return knn_errors ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = argc > 1 ? argv[1] : "pin.txt";
+	struct Rect *pos;
+	bool *live;
+	int method, metric, lazy;
+
+	if (LoadCommands(path)) {
+		fprintf(stderr, "'%s' read failed\n", path);
+		return -1;
+	}
+	pos = (struct Rect *)calloc(max_id + 1, sizeof(struct Rect));
+	live = (bool *)calloc(max_id + 1, sizeof(bool));
+	if (!pos || !live) {
+		fprintf(stderr, "cannot allocate the memory to 'pos'\n");
+		return -1;
+	}
+
+	for (method = 0; method < METHODS; method++) {
+		for (metric = 0; metric < METRICS; metric++) {
+			if (metric > 0 && (method == RTREE_RSTAR ||
+					   method == RTREE_HILBERT_TREE))
+				break;
+			for (lazy = 0; lazy < (metric == 0 ? 2 : 1); lazy++) {
+				memset(live, 0, (max_id + 1) * sizeof(bool));
+				if (Run(method, metric, lazy, pos, live)) {
+					fprintf(stderr, "%s %s failed\n",
+						method_names[method],
+						metric_names[metric]);
+					return -1;
+				}
+			}
+		}
+	}
+	memset(live, 0, (max_id + 1) * sizeof(bool));
+	if (RunForest(pos, live)) {
+		fprintf(stderr, "forest failed\n");
+		return -1;
+	}
+	free(pos);
+	free(live);
+	free(cmds);
+	return 0;
+}
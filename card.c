@@ -1,31 +1,134 @@
-
 #include "card.h"
 #include "index.h"
 
-int NODECARD = MAXCARD;
-int LEAFCARD = MAXCARD;
-
-static int set_max(int *which, int new_max)
+static int set_max(int *which, int new_max, int limit)
 {
-	if (2 > new_max || new_max > MAXCARD)
+	if (2 > new_max || new_max > limit)
 		return 0;
 	*which = new_max;
 	return 1;
 }
 
-int RTreeSetNodeMax(int new_max)
+int RTreeSetNodeMax(struct RTree *t, int new_max)
+{
+	return set_max(&NODECARD(t), new_max, MAXCARD);
+}
+int RTreeSetLeafMax(struct RTree *t, int new_max)
+{
+	return set_max(&LEAFCARD(t), new_max, LEAFMAXCARD);
+}
+int RTreeGetNodeMax(struct RTree *t)
+{
+	return NODECARD(t);
+}
+int RTreeGetLeafMax(struct RTree *t)
+{
+	return LEAFCARD(t);
+}
+
+/**
+ * @brief 트리의 삽입과 분할 방법을 설정합니다.
+ *
+ * @details 노드의 최소 채움 수가 방법에 따라 다르므로 비어있는 트리에서만
+ * 바꿀 수 있습니다. RTREE_HILBERT_TREE는 RTREE_HILBERT로 빌드하고
+ * RTREE_CONCURRENT로 빌드하지 않은 경우에만 사용할 수 있습니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param method enum RTreeSplitMethod 중 하나
+ *
+ * @return 설정한 경우 1, 그렇지 않은 경우 0
+ */
+int RTreeSetSplitMethod(struct RTree *t, int method)
+{
+	if (method < 0 || method >= METHODS)
+		return 0;
+#if !defined(RTREE_HILBERT) || defined(RTREE_CONCURRENT)
+	if (method == RTREE_HILBERT_TREE)
+		return 0;
+#endif
+	if (t->root->level > 0 || t->root->count > 0)
+		return 0;
+	t->method = method;
+	return 1;
+}
+int RTreeGetSplitMethod(struct RTree *t)
+{
+	return t->method;
+}
+
+/**
+ * @brief 트리의 부피 척도를 설정합니다.
+ *
+ * @details 노드에 저장된 브랜치의 부피가 척도에 따라 다르므로 비어있는
+ * 트리에서만 바꿀 수 있습니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param metric enum RTreeAreaMetric 중 하나
+ *
+ * @return 설정한 경우 1, 그렇지 않은 경우 0
+ */
+int RTreeSetAreaMetric(struct RTree *t, int metric)
 {
-	return set_max(&NODECARD, new_max);
+	if (metric < 0 || metric >= METRICS)
+		return 0;
+	if (t->root->level > 0 || t->root->count > 0)
+		return 0;
+	t->metric = metric;
+	return 1;
 }
-int RTreeSetLeafMax(int new_max)
+int RTreeGetAreaMetric(struct RTree *t)
 {
-	return set_max(&LEAFCARD, new_max);
+	return t->metric;
 }
-int RTreeGetNodeMax()
+
+/**
+ * @brief 삭제를 tombstone으로 미뤄두는 lazy 삭제를 설정합니다.
+ *
+ * @details 삭제한 데이터는 표시만 해두고, leaf 안의 tombstone 비율이
+ * node_pct%에 이르면 그 leaf를, 트리 전체의 비율이 tree_pct%에 이르면
+ * 트리 전체를 한 번에 정리합니다. 0인 기준은 보지 않으며, 둘 다 0이면
+ * 남은 tombstone을 모두 정리하고 바로 지우는 삭제로 돌아갑니다.
+ * 잠금 없이 탐색하는 RTREE_CONCURRENT와 leaf에 표시할 자리가 없는
+ * RTREE_POINTLEAF로 빌드한 경우에는 사용할 수 없습니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param node_pct leaf를 정리하는 tombstone 비율 (0 ~ 100)
+ * @param tree_pct 트리 전체를 정리하는 tombstone 비율 (0 ~ 100)
+ *
+ * @return 설정한 경우 1, 그렇지 않은 경우 0
+ */
+int RTreeSetLazyDelete(struct RTree *t, int node_pct, int tree_pct)
 {
-	return NODECARD;
+	if (node_pct < 0 || node_pct > 100 || tree_pct < 0 || tree_pct > 100)
+		return 0;
+#if defined(RTREE_POINTLEAF) || defined(RTREE_CONCURRENT)
+	if (node_pct || tree_pct)
+		return 0;
+#endif
+	t->lazy_node = node_pct;
+	t->lazy_tree = tree_pct;
+	if (!LazyDelete(t))
+		RTreePurge(t);
+	return 1;
 }
-int RTreeGetLeafMax()
+
+/**
+ * @brief RTreeUpdateRect가 제자리에서 옮기기 위해 leaf의 사각형을 늘려도
+ * 되는 정도를 설정합니다.
+ *
+ * @details 늘린 사각형의 둘레가 원래 둘레의 (100 + pct)% 이하인 경우에만
+ * 제자리에서 옮기고, 그렇지 않으면 지운 후에 다시 삽입합니다.
+ * 0이면 leaf의 사각형 안에서 옮기는 경우만 제자리에서 처리합니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param pct 늘려도 되는 둘레의 비율 (0 ~ 100)
+ *
+ * @return 설정한 경우 1, 그렇지 않은 경우 0
+ */
+int RTreeSetUpdateSlack(struct RTree *t, int pct)
 {
-	return LEAFCARD;
+	if (pct < 0 || pct > 100)
+		return 0;
+	t->update_slack = pct;
+	return 1;
 }
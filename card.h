@@ -2,13 +2,25 @@
 #ifndef __CARD__
 #define __CARD__
 
-extern int NODECARD;
-extern int LEAFCARD;
+#define NODECARD(t) ((t)->nodecard)
+#define LEAFCARD(t) ((t)->leafcard)
 
-#define MinNodeFill (NODECARD / 2)
-#define MinLeafFill (LEAFCARD / 2)
+/**
+ * @brief 노드가 가져야 하는 최소 브랜치 수입니다.
+ *
+ * @details R*-tree는 분할할 수 있는 경우를 넓히기 위해서 40%를 사용합니다.
+ */
+#define MinFill(t, card)                                                       \
+	((t)->method == RTREE_RSTAR ? (card)*2 / 5 : (card) / 2)
+#define MinNodeFill(t) MinFill(t, NODECARD(t))
+#define MinLeafFill(t) MinFill(t, LEAFCARD(t))
 
-#define MAXKIDS(n) ((n)->level > 0 ? NODECARD : LEAFCARD)
-#define MINFILL(n) ((n)->level > 0 ? MinNodeFill : MinLeafFill)
+#define MAXKIDS(t, n) ((n)->level > 0 ? NODECARD(t) : LEAFCARD(t))
+#define MINFILL(t, n) ((n)->level > 0 ? MinNodeFill(t) : MinLeafFill(t))
+
+/**
+ * @brief 삭제를 tombstone으로 미뤄두는 지를 확인합니다.
+ */
+#define LazyDelete(t) ((t)->lazy_node || (t)->lazy_tree)
 
 #endif
@@ -0,0 +1,191 @@
+/**
+ * @file circle.c
+ * @brief 브랜치마다 저장된 서브트리의 데이터 수를 사용하는 원 탐색입니다.
+ *
+ * @details 동시에 트리를 고치는 스레드가 없을 때에만 사용할 수 있습니다.
+ */
+
+#include "assert.h"
+#include "index.h"
+
+/**
+ * @brief 원 안의 데이터 수를 세기 위해서 서브트리를 재귀적으로 탐색합니다.
+ *
+ * @details 브랜치의 사각형이 원 안에 완전히 들어가면 내려가지 않고
+ * 저장된 데이터 수를 더하고, 원과 전혀 겹치지 않으면 건너뜁니다.
+ * 따라서 원의 경계에 걸친 노드만 방문하게 됩니다.
+ *
+ * @param n 탐색할 노드
+ * @param c 원
+ * @param p 원의 중심
+ * @param r2 반지름의 제곱
+ *
+ * @return 원 안의 데이터 수
+ */
+static long RTreeCircleCount2(struct Node *n, struct RTreeCircle *c,
+			      RectReal *p, RectDist r2)
+{
+	register int i;
+	register struct Rect *rect;
+	register long hits = 0;
+	struct Rect tmp;
+
+#ifdef RTREE_POINTLEAF
+	if (n->level == 0) { /**< 점은 두 거리가 같으므로 한 번만 구합니다. */
+		register RectDist dx, dy;
+		for (i = 0; i < n->count; i++) {
+			dx = n->point[i].p[0] - p[0];
+			dy = n->point[i].p[1] - p[1];
+			hits += dx * dx + dy * dy - r2 < c->eps;
+		}
+		return hits;
+	}
+#endif
+	for (i = 0; i < n->count; i++) {
+		rect = RTreeEntryRect(n, i, &tmp);
+		if (RTreeMinDist2(rect, p) - r2 >= c->eps)
+			continue; /**< 원 밖 */
+		if (RTreeMaxDist2(rect, p) - r2 < c->eps)
+			hits += n->subcount[i]; /**< 원 안, tombstone은 0 */
+		else if (n->level > 1 ||
+			 (n->level == 1 && RTreeLeafValid(n->branch[i].child)))
+			hits += RTreeCircleCount2(n->branch[i].child, c, p, r2);
+	}
+	return hits;
+}
+
+/**
+ * @brief 원 안에 완전히 들어가는 데이터의 수를 구합니다.
+ *
+ * @details 점의 경우에는 중심까지의 거리의 제곱 d2가 d2 - r * r < eps인
+ * 점의 수와 같습니다. 방문하는 노드의 수는 원 안의 데이터 수가 아니라
+ * 원의 둘레에 비례합니다.
+ *
+ * @param T 탐색할 트리
+ * @param C 원
+ *
+ * @return 원 안의 데이터 수
+ */
+long RTreeCircleCount(struct RTree *T, struct RTreeCircle *C)
+{
+	register struct RTree *t = T;
+	register struct RTreeCircle *c = C;
+	RectReal p[NUMDIMS];
+
+	assert(t && c && t->root);
+
+	p[0] = c->cx;
+	p[1] = c->cy;
+	return RTreeCircleCount2(t->root, c, p, (RectDist)c->r * c->r);
+}
+
+/**
+ * @brief 지금까지 찾은 가장 먼 점입니다.
+ */
+struct RTreeFarthest {
+	tid_t id;
+	RectDist d2; /**< 아직 찾지 못했으면 음수 */
+};
+
+/**
+ * @brief 원 안에서 가장 먼 점을 찾기 위해서 서브트리를 재귀적으로 탐색합니다.
+ *
+ * @details 가장 먼 점이 될 수 있는 거리가 큰 브랜치부터 방문해서 지금까지 찾은
+ * 점보다 분명히 가까운 브랜치는 빨리 건너뛸 수 있도록 합니다.
+ *
+ * @param n 탐색할 노드
+ * @param c 원
+ * @param p 원의 중심
+ * @param r2 반지름의 제곱
+ * @param f 지금까지 찾은 가장 먼 점
+ */
+static void RTreeCircleFarthest2(struct Node *n, struct RTreeCircle *c,
+				 RectReal *p, RectDist r2,
+				 struct RTreeFarthest *f)
+{
+	RectDist far[ANYMAXCARD];
+	int order[ANYMAXCARD];
+	register struct Rect *rect;
+	struct Rect tmp;
+	register RectDist d2;
+	register int i, j, m;
+	tid_t id;
+
+	/**
+	 * @brief 원과 겹치는 브랜치들을 가장 먼 거리가 큰 순서로 정렬합니다.
+	 */
+	for (i = 0, m = 0; i < n->count; i++) {
+		if (n->level == 0 && !RTreeLeafLive(n, i))
+			continue;
+		rect = RTreeEntryRect(n, i, &tmp);
+		if (RTreeMinDist2(rect, p) - r2 >= c->eps)
+			continue;
+		d2 = RTreeMaxDist2(rect, p);
+		if (n->level == 0 && d2 - r2 >= c->eps)
+			continue; /**< 원 안에 완전히 들어가지 않는 데이터 */
+		for (j = m++; j > 0 && far[j - 1] < d2; j--) {
+			far[j] = far[j - 1];
+			order[j] = order[j - 1];
+		}
+		far[j] = d2;
+		order[j] = i;
+	}
+
+	for (j = 0; j < m; j++) {
+		d2 = far[j];
+		if (d2 < f->d2 - c->eps)
+			break; /**< 남은 브랜치에는 더 멀거나 같은 점이 없음 */
+		i = order[j];
+		if (n->level > 0) {
+			if (n->level > 1 ||
+			    RTreeLeafValid(n->branch[i].child))
+				RTreeCircleFarthest2(n->branch[i].child, c,
+						     p, r2, f);
+			continue;
+		}
+		id = RTreeLeafId(n, i);
+		if (d2 > f->d2) {
+			f->id = id;
+			f->d2 = d2;
+		} else if (f->d2 - d2 < c->eps) {
+			f->id = f->id > id ? id : f->id;
+			f->d2 = d2;
+		}
+	}
+}
+
+/**
+ * @brief 원 안에 완전히 들어가는 데이터 중에서 중심으로부터 가장 먼 것을 찾습니다.
+ *
+ * @details 거리의 제곱의 차이가 eps보다 작은 데이터들은 같은 거리로 보고
+ * id가 더 작은 것을 고릅니다.
+ *
+ * @param T 탐색할 트리
+ * @param C 원
+ * @param Id 찾은 데이터의 id가 기록됩니다.
+ * @param D2 찾은 데이터까지의 거리의 제곱이 기록됩니다. NULL일 수 있습니다.
+ *
+ * @return 찾은 경우 1, 원 안에 데이터가 없는 경우 0
+ */
+int RTreeCircleFarthest(struct RTree *T, struct RTreeCircle *C, tid_t *Id,
+			RectDist *D2)
+{
+	register struct RTree *t = T;
+	register struct RTreeCircle *c = C;
+	struct RTreeFarthest f;
+	RectReal p[NUMDIMS];
+
+	assert(t && c && Id && t->root);
+
+	p[0] = c->cx;
+	p[1] = c->cy;
+	f.id = 0;
+	f.d2 = -1;
+	RTreeCircleFarthest2(t->root, c, p, (RectDist)c->r * c->r, &f);
+	if (f.d2 < 0)
+		return 0;
+	*Id = f.id;
+	if (D2)
+		*D2 = f.d2;
+	return 1;
+}
@@ -0,0 +1,449 @@
+/**
+ * @file cmd.c
+ * @brief pin.txt 형식의 명령을 읽고, pout.txt 형식의 결과를 쓰는 함수들입니다.
+ *
+ * @details 명령 파일은 mmap으로 올린 후에 fscanf 없이 직접 읽고,
+ * 결과는 버퍼에 직접 숫자를 적은 후에 버퍼가 찰 때마다 write로 씁니다.
+ * 결과의 형식은 fprintf(fout, "%ld %ld\r\n", ...)와 같습니다.
+ *
+ * 이진 명령 파일은 고정 크기의 레코드들이므로 mmap된 영역을 그대로
+ * struct CmdRecord 배열로 읽습니다.
+ */
+
+#include "cmd.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_TOKEN 64 /**< strtod로 넘길 수 있는 숫자의 최대 길이 */
+#define MAX_LINE 128 /**< 텍스트 명령 한 줄의 최대 길이 */
+
+_Static_assert(sizeof(struct CmdFileHeader) == 16, "header must be 16 bytes");
+_Static_assert(sizeof(struct CmdRecord) == 40, "record must be 40 bytes");
+
+/**
+ * @brief 10^0 ~ 10^22은 double로 정확하게 표현됩니다.
+ */
+static const double pow10_tbl[] = {
+	1e0,  1e1,  1e2,  1e3,	1e4,  1e5,  1e6,  1e7,	1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static int IsSpace(char c)
+{
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' ||
+	       c == '\f';
+}
+
+static int IsDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+/**
+ * @brief fscanf의 " "처럼 공백 문자들을 건너뜁니다.
+ */
+static void SkipSpace(struct CmdReader *r)
+{
+	while (r->cur < r->end && IsSpace(*r->cur))
+		r->cur++;
+}
+
+/**
+ * @brief 정수 하나를 읽습니다. (fscanf의 " %ld"에 해당합니다.)
+ *
+ * @return 성공 시 0, 숫자가 없는 경우 -1
+ */
+static int ScanLong(struct CmdReader *r, long *v)
+{
+	const char *p;
+	unsigned long x = 0;
+	int neg = 0;
+
+	SkipSpace(r);
+	p = r->cur;
+	if (p < r->end && (*p == '+' || *p == '-'))
+		neg = *p++ == '-';
+	if (p == r->end || !IsDigit(*p))
+		return -1;
+	while (p < r->end && IsDigit(*p))
+		x = x * 10 + (*p++ - '0');
+	*v = neg ? -(long)x : (long)x;
+	r->cur = p;
+	return 0;
+}
+
+/**
+ * @brief 읽은 실수를 좌표의 형식으로 바꿉니다.
+ *
+ * @details RTREE_INTCOORD로 빌드한 경우에는 정수가 아니거나 int32_t의 범위를
+ * 벗어난 값을 잘라서 넣지 않고 잘못된 형식으로 처리합니다.
+ *
+ * @return 성공 시 0, 좌표로 나타낼 수 없는 경우 -1
+ */
+static int ToReal(double x, RectReal *v)
+{
+#ifdef RTREE_INTCOORD
+	if (!(x >= INT32_MIN && x <= INT32_MAX) || x != (double)(int32_t)x)
+		return -1;
+#endif
+	*v = (RectReal)x;
+	return 0;
+}
+
+/**
+ * @brief 실수 하나를 읽습니다. (fscanf의 " %lf"에 해당합니다.)
+ *
+ * @details 유효 숫자가 2^53 이하이고 소수점 아래 자리가 22개 이하인 경우에는
+ * 두 정확한 값의 나눗셈이므로 한 번의 반올림으로 strtod와 같은 값을 얻습니다.
+ * (Clinger의 fast path) 지수 표기 등 나머지 경우는 strtod에 맡깁니다.
+ *
+ * @return 성공 시 0, 숫자가 없거나 좌표로 나타낼 수 없는 경우 -1
+ */
+static int ScanReal(struct CmdReader *r, RectReal *v)
+{
+	char token[MAX_TOKEN];
+	const char *p, *start;
+	char *stop;
+	double x;
+	uint64_t mant = 0;
+	int neg = 0, ndigits = 0, frac = 0, exact = 1;
+	size_t len;
+
+	SkipSpace(r);
+	p = start = r->cur;
+	if (p < r->end && (*p == '+' || *p == '-'))
+		neg = *p++ == '-';
+	for (; p < r->end && IsDigit(*p); p++, ndigits++) {
+		if (mant > (1ULL << 53) / 10)
+			exact = 0;
+		mant = mant * 10 + (*p - '0');
+	}
+	if (p < r->end && *p == '.') {
+		for (p++; p < r->end && IsDigit(*p); p++, ndigits++, frac++) {
+			if (mant > (1ULL << 53) / 10)
+				exact = 0;
+			mant = mant * 10 + (*p - '0');
+		}
+	}
+	if (p < r->end && !IsSpace(*p))
+		exact = 0; /**< 지수 표기, inf, nan 등 */
+
+	if (ndigits > 0 && exact && mant <= (1ULL << 53) && frac <= 22) {
+		x = (double)mant / pow10_tbl[frac];
+		if (ToReal(neg ? -x : x, v))
+			return -1;
+		r->cur = p;
+		return 0;
+	}
+
+	for (p = start; p < r->end && !IsSpace(*p); p++)
+		;
+	len = p - start;
+	if (len == 0 || len >= MAX_TOKEN)
+		return -1;
+	memcpy(token, start, len);
+	token[len] = '\0';
+	x = strtod(token, &stop);
+	if (stop == token || ToReal(x, v))
+		return -1;
+	r->cur = start + (stop - token);
+	return 0;
+}
+
+/**
+ * @brief 명령 파일을 mmap으로 올립니다.
+ *
+ * @return 성공 시 0, 실패 시 -1
+ */
+int CmdOpen(struct CmdReader *r, const char *path)
+{
+	struct stat st;
+
+	r->base = NULL;
+	r->size = 0;
+	r->fd = open(path, O_RDONLY);
+	if (r->fd < 0)
+		return -1;
+	if (fstat(r->fd, &st) < 0) {
+		close(r->fd);
+		return -1;
+	}
+	r->size = st.st_size;
+	if (r->size > 0) {
+		r->base = (char *)mmap(NULL, r->size, PROT_READ, MAP_PRIVATE,
+				       r->fd, 0);
+		if (r->base == MAP_FAILED) {
+			close(r->fd);
+			return -1;
+		}
+#ifdef MADV_SEQUENTIAL
+		madvise(r->base, r->size, MADV_SEQUENTIAL);
+#endif
+	}
+	r->cur = r->base;
+	r->end = r->base + r->size;
+	r->binary = false;
+
+	if (r->size >= sizeof(struct CmdFileHeader) &&
+	    !memcmp(r->base, CMD_MAGIC, sizeof(CMD_MAGIC) - 1)) {
+		struct CmdFileHeader *h = (struct CmdFileHeader *)r->base;
+
+		if (h->version != CMD_VERSION ||
+		    h->recsize != sizeof(struct CmdRecord)) {
+			CmdClose(r);
+			return -1;
+		}
+		r->cur += sizeof(struct CmdFileHeader);
+		r->binary = true;
+	}
+	return 0;
+}
+
+/**
+ * @brief 이진 형식에서 다음 명령을 읽습니다.
+ *
+ * @return 명령을 읽은 경우 1, 파일의 끝인 경우 0, 형식이 잘못된 경우 -1
+ */
+static int CmdNextRecord(struct CmdReader *r, struct Command *c)
+{
+	const struct CmdRecord *rec = (const struct CmdRecord *)r->cur;
+
+	if (r->cur == r->end)
+		return 0;
+	if ((size_t)(r->end - r->cur) < sizeof(struct CmdRecord))
+		return -1;
+	r->cur += sizeof(struct CmdRecord);
+
+	c->op = rec->op;
+	c->id = rec->id;
+	if (ToReal(rec->x, &c->x) || ToReal(rec->y, &c->y) ||
+	    ToReal(rec->r, &c->r))
+		return -1;
+	return (c->op == '+' || c->op == '-' || c->op == '?') ? 1 : -1;
+}
+
+/**
+ * @brief 다음 명령을 읽습니다.
+ *
+ * @return 명령을 읽은 경우 1, 파일의 끝인 경우 0, 형식이 잘못된 경우 -1
+ */
+int CmdNext(struct CmdReader *r, struct Command *c)
+{
+	if (r->binary)
+		return CmdNextRecord(r, c);
+
+	SkipSpace(r);
+	if (r->cur == r->end)
+		return 0;
+
+	c->op = *r->cur++;
+	switch (c->op) {
+	case '+':
+		if (ScanLong(r, &c->id) || ScanReal(r, &c->x) ||
+		    ScanReal(r, &c->y))
+			return -1;
+		break;
+	case '-':
+		if (ScanLong(r, &c->id))
+			return -1;
+		break;
+	case '?':
+		if (ScanReal(r, &c->x) || ScanReal(r, &c->y) ||
+		    ScanReal(r, &c->r))
+			return -1;
+		break;
+	default:
+		return -1;
+	}
+	return 1;
+}
+
+void CmdClose(struct CmdReader *r)
+{
+	if (r->base)
+		munmap(r->base, r->size);
+	close(r->fd);
+}
+
+/**
+ * @brief 결과 파일을 열고 cap 크기의 버퍼를 만듭니다.
+ *
+ * @return 성공 시 0, 실패 시 -1
+ */
+int OutOpen(struct OutBuf *o, const char *path, size_t cap)
+{
+	o->buf = (char *)malloc(cap);
+	if (!o->buf)
+		return -1;
+	o->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (o->fd < 0) {
+		free(o->buf);
+		return -1;
+	}
+	o->len = 0;
+	o->cap = cap;
+	return 0;
+}
+
+/**
+ * @brief 버퍼에 모인 결과를 파일에 씁니다.
+ *
+ * @return 성공 시 0, 실패 시 -1
+ */
+int OutFlush(struct OutBuf *o)
+{
+	size_t done = 0;
+	ssize_t n;
+
+	while (done < o->len) {
+		n = write(o->fd, o->buf + done, o->len - done);
+		if (n < 0)
+			return -1;
+		done += n;
+	}
+	o->len = 0;
+	return 0;
+}
+
+/**
+ * @brief 버퍼에 10진수 정수를 적습니다.
+ */
+static void OutLong(struct OutBuf *o, long v)
+{
+	char tmp[24];
+	unsigned long x = v < 0 ? -(unsigned long)v : (unsigned long)v;
+	int n = 0;
+
+	do {
+		tmp[n++] = '0' + x % 10;
+		x /= 10;
+	} while (x);
+	if (v < 0)
+		o->buf[o->len++] = '-';
+	while (n > 0)
+		o->buf[o->len++] = tmp[--n];
+}
+
+/**
+ * @brief 탐색 결과 한 줄을 적습니다.
+ *
+ * @details 점이 없는 경우에는 "0\r\n"을, 있는 경우에는
+ * "점의 수 가장 먼 점의 id\r\n"을 적습니다.
+ *
+ * @return 성공 시 0, 파일 쓰기에 실패한 경우 -1
+ */
+int OutResult(struct OutBuf *o, long nhits, long max_id)
+{
+	/**
+	 * @brief 한 줄은 최대 (부호 + 20자리) * 2 + 3 글자입니다.
+	 */
+	if (o->cap - o->len < 64 && OutFlush(o))
+		return -1;
+	OutLong(o, nhits);
+	if (nhits != 0) {
+		o->buf[o->len++] = ' ';
+		OutLong(o, max_id);
+	}
+	o->buf[o->len++] = '\r';
+	o->buf[o->len++] = '\n';
+	return 0;
+}
+
+/**
+ * @brief 버퍼에 len 바이트를 적습니다.
+ *
+ * @return 성공 시 0, 파일 쓰기에 실패한 경우 -1
+ */
+static int OutWrite(struct OutBuf *o, const void *data, size_t len)
+{
+	if (o->cap - o->len < len && OutFlush(o))
+		return -1;
+	memcpy(o->buf + o->len, data, len);
+	o->len += len;
+	return 0;
+}
+
+/**
+ * @brief 이진 명령 파일의 헤더를 적습니다.
+ *
+ * @return 성공 시 0, 파일 쓰기에 실패한 경우 -1
+ */
+int OutHeader(struct OutBuf *o)
+{
+	struct CmdFileHeader h;
+
+	memcpy(h.magic, CMD_MAGIC, sizeof(h.magic));
+	h.version = CMD_VERSION;
+	h.recsize = sizeof(struct CmdRecord);
+	return OutWrite(o, &h, sizeof(h));
+}
+
+/**
+ * @brief 명령 하나를 이진 레코드로 적습니다.
+ *
+ * @return 성공 시 0, 파일 쓰기에 실패한 경우 -1
+ */
+int OutRecord(struct OutBuf *o, struct Command *c)
+{
+	struct CmdRecord rec;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.op = c->op;
+	if (c->op != '?')
+		rec.id = c->id;
+	if (c->op != '-') {
+		rec.x = c->x;
+		rec.y = c->y;
+	}
+	if (c->op == '?')
+		rec.r = c->r;
+	return OutWrite(o, &rec, sizeof(rec));
+}
+
+/**
+ * @brief 명령 하나를 pin.txt 형식의 한 줄로 적습니다.
+ *
+ * @details 실수는 %.17g로 적으므로 다시 읽으면 같은 값이 됩니다.
+ *
+ * @return 성공 시 0, 파일 쓰기에 실패한 경우 -1
+ */
+int OutText(struct OutBuf *o, struct Command *c)
+{
+	char line[MAX_LINE];
+	int len;
+
+	switch (c->op) {
+	case '+':
+		len = snprintf(line, sizeof(line), "+ %ld %.17g %.17g\r\n",
+			       c->id, (double)c->x, (double)c->y);
+		break;
+	case '-':
+		len = snprintf(line, sizeof(line), "- %ld\r\n", c->id);
+		break;
+	default:
+		len = snprintf(line, sizeof(line), "? %.17g %.17g %.17g\r\n",
+			       (double)c->x, (double)c->y, (double)c->r);
+		break;
+	}
+	return OutWrite(o, line, len);
+}
+
+/**
+ * @brief 남은 결과를 쓰고 파일을 닫습니다.
+ *
+ * @return 성공 시 0, 실패 시 -1
+ */
+int OutClose(struct OutBuf *o)
+{
+	int ret = OutFlush(o);
+
+	if (close(o->fd) < 0)
+		ret = -1;
+	free(o->buf);
+	return ret;
+}
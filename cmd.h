@@ -0,0 +1,80 @@
+#ifndef __CMD__
+#define __CMD__
+
+#include "index.h"
+
+/**
+ * @brief pin.txt의 명령 하나에 해당합니다.
+ *
+ * @details 삽입은 id, x, y를, 삭제는 id를, 탐색은 x, y, r을 사용합니다.
+ */
+struct Command {
+	char op; /**< '+', '-', '?' 중 하나 */
+	long id;
+	RectReal x, y, r;
+};
+
+/**
+ * @brief 이진 명령 파일의 헤더입니다.
+ *
+ * @details 헤더 뒤에는 struct CmdRecord가 빈틈 없이 이어집니다.
+ * 모든 값은 기록한 기계의 byte order(little endian)를 따릅니다.
+ */
+struct CmdFileHeader {
+	char magic[8]; /**< CMD_MAGIC */
+	uint32_t version; /**< CMD_VERSION */
+	uint32_t recsize; /**< sizeof(struct CmdRecord) */
+};
+
+#define CMD_MAGIC "RTCMDBIN"
+#define CMD_VERSION 1
+
+/**
+ * @brief 이진 명령 파일의 명령 하나에 해당합니다.
+ *
+ * @details 삽입은 id, x, y를, 삭제는 id를, 탐색은 x, y, r을 사용하고
+ * 사용하지 않는 필드는 0으로 채웁니다.
+ */
+struct CmdRecord {
+	uint8_t op; /**< '+', '-', '?' 중 하나 */
+	uint8_t pad[7];
+	int64_t id;
+	double x, y, r;
+};
+
+/**
+ * @brief mmap으로 올린 명령 파일을 앞에서부터 읽어가는 reader입니다.
+ *
+ * @details 파일이 CMD_MAGIC으로 시작하면 이진 형식으로, 아니면 pin.txt와
+ * 같은 텍스트 형식으로 읽습니다.
+ */
+struct CmdReader {
+	int fd;
+	char *base; /**< mmap된 영역의 시작 */
+	size_t size; /**< 파일의 크기 */
+	const char *cur, *end; /**< 아직 읽지 않은 영역 */
+	bool binary; /**< 이진 형식인 지 여부 */
+};
+
+/**
+ * @brief 결과를 모아두었다가 크게 한 번에 쓰는 writer입니다.
+ */
+struct OutBuf {
+	int fd;
+	char *buf;
+	size_t len, cap;
+};
+
+extern int CmdOpen(struct CmdReader *, const char *path);
+extern int CmdNext(struct CmdReader *, struct Command *);
+extern void CmdClose(struct CmdReader *);
+
+extern int OutOpen(struct OutBuf *, const char *path, size_t cap);
+extern int OutResult(struct OutBuf *, long nhits, long max_id);
+extern int OutHeader(struct OutBuf *);
+extern int OutRecord(struct OutBuf *, struct Command *);
+extern int OutText(struct OutBuf *, struct Command *);
+extern int OutFlush(struct OutBuf *);
+extern int OutClose(struct OutBuf *);
+
+#endif
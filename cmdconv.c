@@ -0,0 +1,52 @@
+/**
+ * @file cmdconv.c
+ * @brief pin.txt 형식의 텍스트 명령 파일과 이진 명령 파일을 서로 변환합니다.
+ *
+ * @details 사용법: cmdconv -b <입력> <출력> (텍스트 -> 이진)
+ *                  cmdconv -t <입력> <출력> (이진 -> 텍스트)
+ * 입력의 형식은 CmdOpen이 자동으로 판단하므로 어느 쪽이든 읽을 수 있습니다.
+ */
+
+#include "cmd.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CONV_BUF_SIZE (1 << 20)
+
+int main(int argc, char *argv[])
+{
+	struct CmdReader in;
+	struct OutBuf out;
+	struct Command cmd;
+	bool binary;
+	long n = 0;
+	int ret;
+
+	if (argc != 4 || (strcmp(argv[1], "-b") && strcmp(argv[1], "-t"))) {
+		fprintf(stderr, "usage: %s -b|-t <input> <output>\n", argv[0]);
+		return -1;
+	}
+	binary = !strcmp(argv[1], "-b");
+
+	if (CmdOpen(&in, argv[2])) {
+		fprintf(stderr, "'%s' open failed\n", argv[2]);
+		return -1;
+	}
+	if (OutOpen(&out, argv[3], CONV_BUF_SIZE)) {
+		fprintf(stderr, "'%s' open failed\n", argv[3]);
+		CmdClose(&in);
+		return -1;
+	}
+
+	ret = binary ? OutHeader(&out) : 0;
+	while (!ret && (ret = CmdNext(&in, &cmd)) > 0) {
+		ret = binary ? OutRecord(&out, &cmd) : OutText(&out, &cmd);
+		n++;
+	}
+	CmdClose(&in);
+	if (OutClose(&out) || ret) {
+		fprintf(stderr, "conversion failed after %ld commands\n", n);
+		return -1;
+	}
+	return 0;
+}
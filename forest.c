@@ -0,0 +1,608 @@
+#include "index.h"
+#include "assert.h"
+#include <float.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @file forest.c
+ * @brief 삽입이 많은 경우를 위한 LSM 방식의 트리 묶음(forest)입니다.
+ *
+ * @details 새로운 데이터는 작은 동적 트리(버퍼)에 넣고, 버퍼가 가득 차면
+ * 얼려서(frozen) 병합 스레드에 넘긴 후에 새로운 버퍼를 씁니다.
+ * 병합 스레드는 Bentley-Saxe의 이진 카운터처럼 처음으로 비어있는 level k를
+ * 찾아서 얼린 버퍼와 level 0 ~ k - 1의 살아있는 데이터를 모아 RTreeBulkLoad로
+ * 꽉 채운 트리 하나를 만들고 level k에 둡니다. 따라서 level i의 트리는
+ * 버퍼의 약 2^i배 크기이고 트리의 수는 데이터 수의 로그를 넘지 않습니다.
+ *
+ * - 탐색은 버퍼, 얼린 버퍼, 모든 level의 트리에 나눠서 하고 결과를 합칩니다.
+ * - level의 트리는 lazy 삭제로 두어서 삭제는 tombstone만 남기고,
+ *   tombstone은 병합할 때 옮기지 않고 버립니다. lazy 삭제를 쓸 수 없는
+ *   빌드에서는 바로 지우는 삭제를 사용합니다.
+ * - 병합 중에 입력 트리에서 지운 데이터는 id를 모아두었다가 새로운 트리를
+ *   넣기 전에 다시 지웁니다.
+ *
+ * 삽입과 삭제는 forest의 rwlock을 쓰기로, 탐색과 병합의 데이터 수집은
+ * 읽기로 잡고, 새로운 트리를 만드는 동안에는 잠금을 잡지 않습니다.
+ */
+
+/**
+ * @brief forest 하나에 해당합니다.
+ */
+struct RTreeForest {
+	struct RTree *buffer; /* 삽입을 받는 동적 트리 */
+	struct RTree *frozen; /* 병합을 기다리는 얼린 버퍼, 없으면 NULL */
+	struct RTree *level[RTREE_FOREST_LEVELS]; /* 꽉 채운 트리, 없으면 NULL */
+	long nbuffer; /* 버퍼의 데이터 수 */
+	long buffer_max; /* 버퍼를 얼리는 데이터 수 */
+	bool merging; /* frozen을 병합하는 중 */
+	int merge_top; /* 병합하는 가장 높은 level */
+	tid_t *pending; /* 병합 중에 입력 트리에서 지운 id */
+	long npending, pending_cap;
+	struct RTreeForestStats stats;
+	pthread_rwlock_t lock; /* 트리들과 위의 값들을 보호합니다 */
+	pthread_mutex_t merge_lock; /* 아래의 플래그들을 보호합니다 */
+	pthread_cond_t merge_cond;
+	bool request; /* 병합 스레드가 아직 받지 않은 병합 요청 */
+	bool busy; /* 병합 스레드가 병합하는 중 */
+	bool failed; /* 메모리가 부족해서 병합하지 못함 */
+	bool exit; /* 병합 스레드를 끝냄 */
+	pthread_t merger;
+};
+
+/**
+ * @brief forest가 사용할 트리를 하나 만듭니다.
+ *
+ * @param packed 0이 아니면 level에 둘 트리로 lazy 삭제를 설정합니다.
+ */
+static struct RTree *RTreeForestNewTree(int packed)
+{
+	struct RTree *t = RTreeNewIndex();
+
+	if (t && packed) /**< 쓸 수 없는 빌드에서는 바로 지웁니다. */
+		RTreeSetLazyDelete(t, 0, 100);
+	return t;
+}
+
+/**
+ * @brief id가 병합하는 중인 입력 트리에 있었던 경우 id를 모아둡니다.
+ *
+ * @return 성공 시 0, 메모리가 부족한 경우 -1
+ */
+static int RTreeForestRemember(struct RTreeForest *f, tid_t id)
+{
+	tid_t *tmp;
+	long cap;
+
+	if (f->npending == f->pending_cap) {
+		cap = f->pending_cap ? f->pending_cap * 2 : 256;
+		tmp = (tid_t *)realloc(f->pending, cap * sizeof(tid_t));
+		if (!tmp)
+			return -1;
+		f->pending = tmp;
+		f->pending_cap = cap;
+	}
+	f->pending[f->npending++] = id;
+	return 0;
+}
+
+/**
+ * @brief 쓰기 잠금을 잡은 상태에서 id를 가진 데이터를 찾아서 지웁니다.
+ *
+ * @return 지운 경우 0, 없는 경우 1, 메모리가 부족한 경우 -1
+ */
+static int RTreeForestDelete2(struct RTreeForest *f, tid_t id)
+{
+	struct RTree *t;
+	int k;
+
+	if (RTreeDeleteId(f->buffer, id) == 0) {
+		f->nbuffer--;
+		return 0;
+	}
+	for (k = -1; k < RTREE_FOREST_LEVELS; k++) {
+		t = k < 0 ? f->frozen : f->level[k];
+		if (!t || RTreeDeleteId(t, id))
+			continue;
+		if (t->lazy_node || t->lazy_tree)
+			f->stats.tombstones++;
+		if (f->merging && k <= f->merge_top)
+			return RTreeForestRemember(f, id);
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * @brief 트리의 살아있는 데이터를 모두 배열에 덧붙입니다.
+ */
+static long RTreeForestCollect(struct RTree *t, struct Rect *rects,
+			       tid_t *ids, long n)
+{
+	struct RTreeCursor c;
+	struct Rect all;
+	int i;
+
+	for (i = 0; i < NUMDIMS; i++) {
+		all.boundary[i] = -RECTREAL_MAX;
+		all.boundary[i + NUMDIMS] = RECTREAL_MAX;
+	}
+	RTreeCursorOpen(&c, t, &all);
+	while (RTreeCursorNext(&c, &ids[n], &rects[n]))
+		n++;
+	RTreeCursorClose(&c);
+	return n;
+}
+
+/**
+ * @brief 얼린 버퍼와 level 0 ~ merge_top의 트리를 트리 하나로 합칩니다.
+ *
+ * @details 데이터는 읽기 잠금 아래에서 모으고, 트리는 잠금 없이 만든 후에
+ * 쓰기 잠금 아래에서 모아둔 삭제를 다시 하고 입력 트리들과 바꿉니다.
+ *
+ * @return 성공 시 0, 메모리가 부족한 경우 -1
+ */
+static int RTreeForestMerge(struct RTreeForest *f)
+{
+	struct RTree *in[RTREE_FOREST_LEVELS + 1], *t = NULL;
+	struct Rect *rects = NULL;
+	tid_t *ids = NULL;
+	long total = 0, n = 0, dead = 0, i;
+	int k, top, nin = 0;
+
+	pthread_rwlock_rdlock(&f->lock);
+	top = f->merge_top;
+	in[nin++] = f->frozen;
+	for (k = 0; k <= top; k++)
+		if (f->level[k])
+			in[nin++] = f->level[k];
+	for (k = 0; k < nin; k++) {
+		total += RTreeNodeTotal(in[k]->root);
+		dead += in[k]->ndead;
+	}
+	if (total > 0) {
+		rects = (struct Rect *)malloc(total * sizeof(struct Rect));
+		ids = (tid_t *)malloc(total * sizeof(tid_t));
+	}
+	if (total > 0 && (!rects || !ids)) {
+		pthread_rwlock_unlock(&f->lock);
+		goto fail;
+	}
+	for (k = 0; k < nin; k++)
+		n = RTreeForestCollect(in[k], rects, ids, n);
+	pthread_rwlock_unlock(&f->lock);
+	assert(n == total);
+
+	t = RTreeForestNewTree(1);
+	if (!t || RTreeBulkLoad(t, rects, ids, n))
+		goto fail;
+	free(rects);
+	free(ids);
+
+	pthread_rwlock_wrlock(&f->lock);
+	for (i = 0; i < f->npending; i++)
+		if (RTreeDeleteId(t, f->pending[i]) == 0)
+			n--;
+	f->npending = 0;
+	f->merging = false;
+	f->frozen = NULL;
+	for (k = 0; k < top; k++)
+		f->level[k] = NULL;
+	f->level[top] = n > 0 ? t : NULL;
+	f->stats.merges++;
+	f->stats.merged += total;
+	f->stats.dropped += dead;
+	pthread_rwlock_unlock(&f->lock);
+
+	for (k = 0; k < nin; k++)
+		RTreeFreeIndex(in[k]);
+	if (n == 0)
+		RTreeFreeIndex(t);
+	return 0;
+
+fail:
+	free(rects);
+	free(ids);
+	RTreeFreeIndex(t);
+	pthread_rwlock_wrlock(&f->lock); /**< 입력 트리들은 그대로 둡니다. */
+	f->npending = 0;
+	f->merging = false;
+	pthread_rwlock_unlock(&f->lock);
+	return -1;
+}
+
+/**
+ * @brief 얼린 버퍼가 생길 때마다 병합하는 스레드입니다.
+ */
+static void *RTreeForestMerger(void *arg)
+{
+	struct RTreeForest *f = (struct RTreeForest *)arg;
+	int failed;
+
+	for (;;) {
+		pthread_mutex_lock(&f->merge_lock);
+		while (!f->request && !f->exit)
+			pthread_cond_wait(&f->merge_cond, &f->merge_lock);
+		if (!f->request) { /**< 남은 병합이 없을 때만 끝냅니다. */
+			pthread_mutex_unlock(&f->merge_lock);
+			return NULL;
+		}
+		f->request = false;
+		f->busy = true;
+		pthread_mutex_unlock(&f->merge_lock);
+
+		failed = RTreeForestMerge(f);
+
+		pthread_mutex_lock(&f->merge_lock);
+		f->failed = failed != 0;
+		f->busy = false;
+		pthread_cond_broadcast(&f->merge_cond);
+		pthread_mutex_unlock(&f->merge_lock);
+	}
+}
+
+/**
+ * @brief 진행 중인 병합이 끝날 때까지 기다립니다.
+ *
+ * @return 병합에 성공했거나 병합이 없었던 경우 0, 실패한 경우 -1
+ */
+static int RTreeForestWait(struct RTreeForest *f)
+{
+	int failed;
+
+	pthread_mutex_lock(&f->merge_lock);
+	while (f->request || f->busy)
+		pthread_cond_wait(&f->merge_cond, &f->merge_lock);
+	failed = f->failed;
+	pthread_mutex_unlock(&f->merge_lock);
+	return failed ? -1 : 0;
+}
+
+/**
+ * @brief 쓰기 잠금을 잡은 상태에서 가득 찬 버퍼를 얼려서 병합을 시작합니다.
+ *
+ * @details 이전 병합이 끝나지 않았으면 잠금을 풀고 기다립니다. 이전 병합이
+ * 실패해서 얼린 버퍼가 남아있으면 그 버퍼를 다시 병합합니다.
+ *
+ * @return 성공 시 0, 메모리가 부족한 경우 -1
+ */
+static int RTreeForestFreeze(struct RTreeForest *f)
+{
+	struct RTree *t;
+	int k;
+
+	while (f->merging) {
+		f->stats.stalls++;
+		pthread_rwlock_unlock(&f->lock);
+		RTreeForestWait(f);
+		pthread_rwlock_wrlock(&f->lock);
+	}
+	if (f->nbuffer < f->buffer_max) /**< 기다리는 동안 얼린 경우 */
+		return 0;
+	if (!f->frozen) {
+		t = RTreeForestNewTree(0);
+		if (!t)
+			return -1;
+		f->frozen = f->buffer;
+		f->buffer = t;
+		f->nbuffer = 0;
+	}
+
+	for (k = 0; k < RTREE_FOREST_LEVELS - 1 && f->level[k]; k++)
+		;
+	f->merge_top = k; /**< 모두 찬 경우에는 가장 높은 level에 합칩니다. */
+	f->merging = true;
+	pthread_mutex_lock(&f->merge_lock);
+	f->request = true;
+	pthread_cond_signal(&f->merge_cond);
+	pthread_mutex_unlock(&f->merge_lock);
+	return 0;
+}
+
+/**
+ * @brief 빈 forest를 만들고 병합 스레드를 시작합니다.
+ *
+ * @param buffer_max 버퍼를 얼리는 데이터 수, 0 이하이면
+ * RTREE_FOREST_BUFFER를 사용합니다.
+ *
+ * @return 성공 시 forest, 실패 시 NULL
+ */
+struct RTreeForest *RTreeNewForest(long buffer_max)
+{
+	struct RTreeForest *f;
+
+	f = (struct RTreeForest *)calloc(1, sizeof(struct RTreeForest));
+	if (!f)
+		return NULL;
+	f->buffer_max = buffer_max > 0 ? buffer_max : RTREE_FOREST_BUFFER;
+	f->buffer = RTreeForestNewTree(0);
+	if (!f->buffer) {
+		free(f);
+		return NULL;
+	}
+	pthread_rwlock_init(&f->lock, NULL);
+	pthread_mutex_init(&f->merge_lock, NULL);
+	pthread_cond_init(&f->merge_cond, NULL);
+	if (pthread_create(&f->merger, NULL, RTreeForestMerger, f)) {
+		pthread_rwlock_destroy(&f->lock);
+		pthread_mutex_destroy(&f->merge_lock);
+		pthread_cond_destroy(&f->merge_cond);
+		RTreeFreeIndex(f->buffer);
+		free(f);
+		return NULL;
+	}
+	return f;
+}
+
+/**
+ * @brief 진행 중인 병합을 마친 후에 병합 스레드를 끝내고 forest를 해제합니다.
+ */
+void RTreeFreeForest(struct RTreeForest *f)
+{
+	int k;
+
+	if (!f)
+		return;
+	pthread_mutex_lock(&f->merge_lock);
+	f->exit = true;
+	pthread_cond_signal(&f->merge_cond);
+	pthread_mutex_unlock(&f->merge_lock);
+	pthread_join(f->merger, NULL);
+
+	RTreeFreeIndex(f->buffer);
+	RTreeFreeIndex(f->frozen);
+	for (k = 0; k < RTREE_FOREST_LEVELS; k++)
+		RTreeFreeIndex(f->level[k]);
+	free(f->pending);
+	pthread_rwlock_destroy(&f->lock);
+	pthread_mutex_destroy(&f->merge_lock);
+	pthread_cond_destroy(&f->merge_cond);
+	free(f);
+}
+
+/**
+ * @brief forest에 데이터를 넣습니다. 같은 id의 데이터가 있으면 바꿉니다.
+ *
+ * @param F forest에 해당합니다.
+ * @param R 넣을 사각형에 해당합니다.
+ * @param Tid 넣을 데이터의 id
+ *
+ * @return 성공 시 0, 메모리가 부족한 경우 -1
+ */
+int RTreeForestInsert(struct RTreeForest *F, struct Rect *R, tid_t Tid)
+{
+	register struct RTreeForest *f = F;
+	int ret;
+
+	assert(f && R);
+
+	pthread_rwlock_wrlock(&f->lock);
+	ret = RTreeForestDelete2(f, Tid);
+	if (ret >= 0 && RTreeInsertRect(f->buffer, R, Tid, 0) >= 0) {
+		f->nbuffer++;
+		f->stats.inserts++;
+		ret = f->nbuffer >= f->buffer_max ? RTreeForestFreeze(f) : 0;
+	} else {
+		ret = -1;
+	}
+	pthread_rwlock_unlock(&f->lock);
+	return ret;
+}
+
+/**
+ * @brief forest에서 id를 가진 데이터를 지웁니다.
+ *
+ * @details 버퍼에 있으면 바로 지우고, level의 트리에 있으면 tombstone을
+ * 남겨서 병합할 때 버립니다.
+ *
+ * @return 지운 경우 0, 없는 경우 1, 메모리가 부족한 경우 -1
+ */
+int RTreeForestDelete(struct RTreeForest *f, tid_t tid)
+{
+	int ret;
+
+	assert(f);
+
+	pthread_rwlock_wrlock(&f->lock);
+	ret = RTreeForestDelete2(f, tid);
+	if (ret == 0)
+		f->stats.deletes++;
+	pthread_rwlock_unlock(&f->lock);
+	return ret;
+}
+
+/**
+ * @brief 읽기 잠금 아래에서 탐색할 트리들을 모읍니다.
+ *
+ * @return 트리의 수
+ */
+static int RTreeForestTrees(struct RTreeForest *f, struct RTree **trees)
+{
+	int k, n = 0;
+
+	trees[n++] = f->buffer;
+	if (f->frozen)
+		trees[n++] = f->frozen;
+	for (k = 0; k < RTREE_FOREST_LEVELS; k++)
+		if (f->level[k])
+			trees[n++] = f->level[k];
+	return n;
+}
+
+/**
+ * @brief 사각형과 겹치는 데이터를 모든 트리에서 찾습니다.
+ *
+ * @param f forest에 해당합니다.
+ * @param r 탐색 범위에 해당합니다.
+ * @param cb 찾을 때마다 호출하며, 0을 반환하면 탐색을 멈춥니다.
+ * NULL이면 수만 셉니다.
+ * @param arg cb에 넘길 인자
+ *
+ * @return 찾은 데이터의 수
+ */
+int RTreeForestSearch(struct RTreeForest *f, struct Rect *r,
+		      SearchHitCallback cb, void *arg)
+{
+	struct RTree *trees[RTREE_FOREST_LEVELS + 2];
+	struct RTreeCursor c;
+	tid_t id;
+	int k, n, hits = 0, stop = 0;
+
+	assert(f && r);
+
+	pthread_rwlock_rdlock(&f->lock);
+	n = RTreeForestTrees(f, trees);
+	for (k = 0; k < n && !stop; k++) {
+		RTreeCursorOpen(&c, trees[k], r);
+		while (RTreeCursorNext(&c, &id, NULL)) {
+			hits++;
+			if (cb && !cb((int)id, arg)) {
+				stop = 1;
+				break;
+			}
+		}
+		RTreeCursorClose(&c);
+	}
+	pthread_rwlock_unlock(&f->lock);
+	return hits;
+}
+
+/**
+ * @brief 원 안에 완전히 들어가는 데이터의 수를 모든 트리에서 구합니다.
+ */
+long RTreeForestCircleCount(struct RTreeForest *f, struct RTreeCircle *c)
+{
+	struct RTree *trees[RTREE_FOREST_LEVELS + 2];
+	long hits = 0;
+	int k, n;
+
+	assert(f && c);
+
+	pthread_rwlock_rdlock(&f->lock);
+	n = RTreeForestTrees(f, trees);
+	for (k = 0; k < n; k++)
+		hits += RTreeCircleCount(trees[k], c);
+	pthread_rwlock_unlock(&f->lock);
+	return hits;
+}
+
+/**
+ * @brief 원 안에서 가장 먼 데이터를 모든 트리에서 찾습니다.
+ *
+ * @details 트리마다 찾은 결과를 RTreeCircleFarthest와 같은 기준으로 합칩니다.
+ *
+ * @return 찾은 경우 1, 원 안에 데이터가 없는 경우 0
+ */
+int RTreeForestCircleFarthest(struct RTreeForest *f, struct RTreeCircle *c,
+			      tid_t *Id, RectDist *D2)
+{
+	struct RTree *trees[RTREE_FOREST_LEVELS + 2];
+	RectDist d2, best = -1;
+	tid_t id, best_id = 0;
+	int k, n;
+
+	assert(f && c && Id);
+
+	pthread_rwlock_rdlock(&f->lock);
+	n = RTreeForestTrees(f, trees);
+	for (k = 0; k < n; k++) {
+		if (!RTreeCircleFarthest(trees[k], c, &id, &d2))
+			continue;
+		if (d2 > best + c->eps || best < 0) {
+			best_id = id;
+			best = d2;
+		} else if (d2 > best - c->eps) {
+			best_id = best_id > id ? id : best_id;
+			best = d2 > best ? d2 : best;
+		}
+	}
+	pthread_rwlock_unlock(&f->lock);
+	if (best < 0)
+		return 0;
+	*Id = best_id;
+	if (D2)
+		*D2 = best;
+	return 1;
+}
+
+/**
+ * @brief 기준점에서 가장 가까운 k개의 데이터를 모든 트리에서 찾습니다.
+ *
+ * @details 트리마다 최근접 커서를 열고, 커서들이 다음에 내놓을 데이터 중에서
+ * 가장 가까운 것을 차례로 고릅니다. 거리가 같으면 id가 작은 것을 고릅니다.
+ *
+ * @return 찾은 데이터의 수, 메모리가 부족한 경우 -1을 반환합니다.
+ */
+int RTreeForestNearest(struct RTreeForest *f, RectReal *point, int k,
+		       tid_t *ids, RectDist *d2s)
+{
+	struct RTree *trees[RTREE_FOREST_LEVELS + 2];
+	struct RTreeNearestCursor c[RTREE_FOREST_LEVELS + 2];
+	tid_t head[RTREE_FOREST_LEVELS + 2];
+	RectDist dist[RTREE_FOREST_LEVELS + 2];
+	int live[RTREE_FOREST_LEVELS + 2];
+	int i, j, n, best, found = 0;
+
+	assert(f && point && k >= 0 && ids);
+
+	pthread_rwlock_rdlock(&f->lock);
+	n = RTreeForestTrees(f, trees);
+	for (i = 0; i < n; i++) {
+		live[i] = RTreeNearestOpen(&c[i], trees[i], point) ? -1 :
+			  RTreeNearestNext(&c[i], &head[i], &dist[i]);
+		if (live[i] < 0) {
+			found = -1;
+			n = i + 1;
+			break;
+		}
+	}
+	while (found >= 0 && found < k) {
+		best = -1;
+		for (j = 0; j < n; j++)
+			if (live[j] > 0 &&
+			    (best < 0 || dist[j] < dist[best] ||
+			     (dist[j] == dist[best] && head[j] < head[best])))
+				best = j;
+		if (best < 0)
+			break;
+		ids[found] = head[best];
+		if (d2s)
+			d2s[found] = dist[best];
+		found++;
+		live[best] = RTreeNearestNext(&c[best], &head[best],
+					      &dist[best]);
+		if (live[best] < 0)
+			found = -1;
+	}
+	for (i = 0; i < n; i++)
+		RTreeNearestClose(&c[i]);
+	pthread_rwlock_unlock(&f->lock);
+	return found;
+}
+
+/**
+ * @brief 진행 중인 병합이 끝날 때까지 기다립니다.
+ *
+ * @return 마지막 병합에 성공했거나 병합이 없었던 경우 0, 실패한 경우 -1
+ */
+int RTreeForestSync(struct RTreeForest *f)
+{
+	assert(f);
+	return RTreeForestWait(f);
+}
+
+/**
+ * @brief forest의 통계와 지금 가진 트리의 수를 가져옵니다.
+ */
+void RTreeGetForestStats(struct RTreeForest *f, struct RTreeForestStats *s)
+{
+	struct RTree *trees[RTREE_FOREST_LEVELS + 2];
+
+	assert(f && s);
+
+	pthread_rwlock_rdlock(&f->lock);
+	*s = f->stats;
+	s->trees = RTreeForestTrees(f, trees);
+	pthread_rwlock_unlock(&f->lock);
+}
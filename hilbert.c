@@ -0,0 +1,285 @@
+#include "index.h"
+#include "assert.h"
+#include "card.h"
+#include <stdlib.h>
+
+/**
+ * @file hilbert.c
+ * @brief RTREE_HILBERT로 빌드한 경우에 사용하는 Hilbert R-tree의 삽입입니다.
+ *
+ * @details Kamel과 Faloutsos의 방법을 따릅니다.
+ * - 브랜치마다 서브트리의 가장 큰 Hilbert 값(LHV)을 가지며, 삽입할 데이터의
+ *   Hilbert 값보다 크거나 같은 LHV 중에서 가장 작은 브랜치로 내려갑니다.
+ * - 노드가 넘치면 바로 분할하지 않고 Hilbert 순서로 이웃한 형제 노드와
+ *   브랜치들을 고르게 나눠 갖습니다. 형제 노드도 꽉 찬 경우에만 새로운 노드를
+ *   만들어서 두 노드의 브랜치들을 세 노드에 나눕니다. (2-to-3 분할)
+ * 따라서 노드는 평균적으로 2/3 이상 채워지게 됩니다.
+ *
+ * Hilbert 값은 RTreeInsertBatch도 사용하므로 RTreeHilbertKey는 항상 빌드합니다.
+ */
+
+#if NUMDIMS != 2
+#error "RTreeHilbertKey supports only two dimensions"
+#endif
+
+/**
+ * @brief 좌표를 Hilbert 곡선의 격자 좌표로 바꿉니다.
+ *
+ * @details 좌표는 [0, 2^32)의 정수 격자로 보고, 범위를 벗어나면 가장 가까운
+ * 끝으로 맞춥니다.
+ */
+static uint32_t RTreeHilbertCoord(RectDist c)
+{
+	if (c <= 0)
+		return 0;
+	if (c >= (RectDist)UINT32_MAX)
+		return UINT32_MAX;
+	return (uint32_t)c;
+}
+
+/**
+ * @brief 사각형의 중심의 Hilbert 값을 구합니다.
+ *
+ * @param r 사각형
+ *
+ * @return 2^32 x 2^32 격자 위의 차수 32인 Hilbert 곡선에서의 위치
+ */
+uint64_t RTreeHilbertKey(struct Rect *r)
+{
+	register uint32_t x, y, s, rx, ry, tmp;
+	register uint64_t d = 0;
+
+	x = RTreeHilbertCoord(((RectDist)r->boundary[0] + r->boundary[2]) / 2);
+	y = RTreeHilbertCoord(((RectDist)r->boundary[1] + r->boundary[3]) / 2);
+	for (s = 1u << 31; s > 0; s >>= 1) {
+		rx = (x & s) > 0;
+		ry = (y & s) > 0;
+		d += (uint64_t)s * s * ((3 * rx) ^ ry);
+		if (ry == 0) { /**< 사분면에 맞게 회전합니다. */
+			if (rx == 1) {
+				x = ~x;
+				y = ~y;
+			}
+			tmp = x;
+			x = y;
+			y = tmp;
+		}
+	}
+	return d;
+}
+
+#ifdef RTREE_HILBERT
+
+/**
+ * @brief 노드 아래에 있는 데이터 중에서 가장 큰 Hilbert 값을 구합니다.
+ */
+uint64_t RTreeNodeLhv(struct Node *n)
+{
+	register int i;
+	register uint64_t lhv = 0;
+
+	for (i = 0; i < n->count; i++)
+		if (n->lhv[i] > lhv)
+			lhv = n->lhv[i];
+	return lhv;
+}
+
+/**
+ * @brief Hilbert 값이 key인 데이터를 넣을 브랜치를 고릅니다.
+ *
+ * @return key보다 크거나 같은 LHV 중에서 가장 작은 브랜치,
+ * 없으면 LHV가 가장 큰 브랜치
+ */
+int RTreeHilbertPick(struct Node *n, uint64_t key)
+{
+	register int i, best = -1, last = 0;
+
+	assert(n->count > 0);
+	for (i = 0; i < n->count; i++) {
+		if (n->lhv[i] >= key && (best < 0 || n->lhv[i] < n->lhv[best]))
+			best = i;
+		if (n->lhv[i] > n->lhv[last])
+			last = i;
+	}
+	return best >= 0 ? best : last;
+}
+
+static int RTreeCompareHilbert(const void *A, const void *B)
+{
+	uint64_t a = ((const struct RTreeHilbertEntry *)A)->key;
+	uint64_t b = ((const struct RTreeHilbertEntry *)B)->key;
+	return (a > b) - (a < b);
+}
+
+/**
+ * @brief 노드의 브랜치들을 Hilbert 값과 함께 버퍼에 넣고 노드를 비웁니다.
+ */
+static int RTreeHilbertGather(struct Node *n, struct RTreeHilbertEntry *buf)
+{
+	register int i;
+	int level = n->level, count = n->count;
+
+	for (i = 0; i < count; i++) {
+		buf[i].key = n->lhv[i];
+		buf[i].branch = n->branch[i];
+	}
+	RTreeInitNode(n);
+	n->level = level;
+	return count;
+}
+
+/**
+ * @brief 넘친 자식 노드의 브랜치들을 형제 노드와 나눠 갖도록 합니다.
+ *
+ * @details 자식과 Hilbert 순서로 이웃한 형제의 브랜치, 그리고 새로운 브랜치를
+ * Hilbert 값으로 정렬한 후에 두 노드에 고르게 나눕니다. 두 노드에 모두
+ * 들어가지 않으면 새로운 노드를 만들어서 세 노드에 나눕니다.
+ * 형제가 없는 경우에는 자식과 새로운 노드 둘로 나눕니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param n 넘친 자식을 가진 노드
+ * @param i 넘친 자식의 브랜치 번호
+ * @param b 자식에 넣으려던 브랜치, 새로운 노드가 생기면 그 노드의 브랜치가
+ * 들어갑니다.
+ *
+ * @return 새로운 노드가 생겨서 n에 b를 넣어야 하는 경우 1, 그렇지 않은 경우 0
+ */
+static int RTreeHilbertOverflow(struct RTree *t, struct Node *n, int i,
+				struct Branch *b)
+{
+	struct RTreeHilbertEntry *buf = t->split.HilbertBuf;
+	struct Node *nodes[3], *c = n->branch[i].child;
+	struct Rect cover;
+	register int k, e;
+	int lo = -1, hi = -1, j, total, nnodes, level = c->level;
+
+	/**
+	 * @brief LHV가 바로 다음인 형제를, 없으면 바로 앞인 형제를 고릅니다.
+	 */
+	for (k = 0; k < n->count; k++) {
+		if (k == i)
+			continue;
+		if (n->lhv[k] >= n->lhv[i]) {
+			if (hi < 0 || n->lhv[k] < n->lhv[hi])
+				hi = k;
+		} else if (lo < 0 || n->lhv[k] > n->lhv[lo]) {
+			lo = k;
+		}
+	}
+	j = hi >= 0 ? hi : lo;
+
+	total = RTreeHilbertGather(c, buf);
+	nodes[0] = c;
+	nnodes = 1;
+	if (j >= 0) {
+		total += RTreeHilbertGather(n->branch[j].child, buf + total);
+		nodes[nnodes++] = n->branch[j].child;
+		if (j == lo) { /**< Hilbert 순서대로 노드를 놓습니다. */
+			nodes[1] = c;
+			nodes[0] = n->branch[j].child;
+		}
+	}
+	buf[total].key = level > 0 ? RTreeNodeLhv(b->child) :
+				     RTreeHilbertKey(&b->rect);
+	buf[total].branch = *b;
+	total++;
+	qsort(buf, total, sizeof(struct RTreeHilbertEntry),
+	      RTreeCompareHilbert);
+
+	if (total > nnodes * MAXKIDS(t, c)) {
+		nodes[nnodes] = RTreeNewNode(t);
+		nodes[nnodes]->level = level;
+		nnodes++;
+	}
+	for (k = 0, e = 0; k < nnodes; k++)
+		for (; e < (long)total * (k + 1) / nnodes; e++)
+			RTreeAddBranch(t, &buf[e].branch, nodes[k], NULL);
+
+	cover = RTreeNodeCover(c);
+	RTreeSetBranchRect(n, i, &cover);
+	RTreeUpdateAggregate(n, i);
+	if (j >= 0) {
+		cover = RTreeNodeCover(n->branch[j].child);
+		RTreeSetBranchRect(n, j, &cover);
+		RTreeUpdateAggregate(n, j);
+	}
+	if (nnodes == (j >= 0 ? 2 : 1))
+		return 0;
+
+	b->child = nodes[nnodes - 1];
+	b->rect = RTreeNodeCover(b->child);
+	return 1;
+}
+
+/**
+ * @brief 서브트리에 브랜치를 삽입합니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param b 삽입할 브랜치, n이 넘친 경우에는 n의 부모에 넣을 브랜치가 들어갑니다.
+ * @param n 삽입할 서브트리의 루트
+ * @param level 브랜치를 넣을 노드의 level
+ * @param key 삽입할 브랜치의 Hilbert 값
+ *
+ * @return n이 꽉 차서 b를 넣지 못한 경우 1, 그렇지 않은 경우 0
+ */
+static int RTreeHilbertInsert2(struct RTree *t, struct Branch *b,
+			       struct Node *n, int level, uint64_t key)
+{
+	struct Rect cover;
+	int i;
+
+	if (n->level > level) {
+		i = RTreeHilbertPick(n, key);
+		if (!RTreeHilbertInsert2(t, b, n->branch[i].child, level,
+					 key)) {
+			cover = RTreeNodeCover(n->branch[i].child);
+			RTreeSetBranchRect(n, i, &cover);
+			RTreeUpdateAggregate(n, i);
+			return 0;
+		}
+		if (!RTreeHilbertOverflow(t, n, i, b))
+			return 0;
+	}
+	if (n->count >= MAXKIDS(t, n))
+		return 1;
+	RTreeAddBranch(t, b, n, NULL);
+	return 0;
+}
+
+/**
+ * @brief Hilbert R-tree에 사각형 데이터를 삽입합니다.
+ *
+ * @details 루트가 넘치면 새로운 루트를 만든 후에 형제가 없는 자식이 넘친
+ * 경우와 같이 둘로 나눕니다.
+ *
+ * @param t 삽입할 트리에 해당합니다.
+ * @param r 삽입되는 사각형에 해당합니다.
+ * @param tid 삽입되는 사각형의 ID, level이 0보다 크면 서브트리의 루트입니다.
+ * @param level 삽입할 노드의 level에 해당합니다.
+ *
+ * @return 루트가 분할된 경우 1을 반환, 그렇지 않은 경우 0을 반환합니다.
+ */
+int RTreeHilbertInsert(struct RTree *t, struct Rect *r, tid_t tid, int level)
+{
+	struct Node *newroot;
+	struct Branch b, rb;
+	uint64_t key;
+
+	b.rect = *r;
+	b.child = (struct Node *)tid;
+	key = level > 0 ? RTreeNodeLhv(b.child) : RTreeHilbertKey(r);
+	if (!RTreeHilbertInsert2(t, &b, t->root, level, key))
+		return 0;
+
+	newroot = RTreeNewNode(t);
+	newroot->level = t->root->level + 1;
+	rb.rect = RTreeNodeCover(t->root);
+	rb.child = t->root;
+	RTreeAddBranch(t, &rb, newroot, NULL);
+	RTreeHilbertOverflow(t, newroot, 0, &b);
+	RTreeAddBranch(t, &b, newroot, NULL);
+	t->root = newroot;
+	return 1;
+}
+
+#endif /* RTREE_HILBERT */
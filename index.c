@@ -2,65 +2,519 @@
 #include "index.h"
 #include "assert.h"
 #include "card.h"
+#include "pool.h"
 #include <malloc.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 
 /**
  * @brief 하나의 노드로 구성된 비어있는 새로운 인덱스를 만들도록 합니다.
  *
- * @return 새롭게 생성된 노드 x를 반환합니다.
+ * @details 트리는 루트, 노드의 최대 엔트리 수, 분할에 사용하는 작업 공간,
+ * 노드와 재삽입 리스트의 풀을 모두 가지고 있습니다. 따라서 서로 다른 트리는
+ * 전역 상태를 공유하지 않으며, 각각 다른 스레드에서 사용할 수 있습니다.
+ *
+ * @return 새롭게 생성된 트리를 반환합니다. 실패 시 NULL을 반환합니다.
+ */
+struct RTree *RTreeNewIndex()
+{
+	struct RTree *t;
+
+	t = (struct RTree *)malloc(sizeof(struct RTree));
+	if (!t)
+		return NULL;
+	RTreePoolInit(&t->node_pool, sizeof(struct Node), PGSIZE, HUGEPGSIZE);
+	RTreePoolInit(&t->list_pool, sizeof(struct ListNode), sizeof(void *),
+		      PGSIZE);
+	t->nodecard = MAXCARD;
+	t->leafcard = LEAFMAXCARD;
+	t->method = RTREE_LINEAR;
+	t->metric = RTREE_SPHERE_VOLUME;
+	t->leafref = NULL;
+	t->nleafref = 0;
+	t->lazy_node = t->lazy_tree = 0;
+	t->ndead = 0;
+	memset(&t->dstats, 0, sizeof(t->dstats));
+	t->update_slack = RTREE_UPDATE_SLACK_PCT;
+	memset(&t->ustats, 0, sizeof(t->ustats));
+	t->split.ReinsertCount = 0;
+	t->map = NULL;
+	t->map_size = 0;
+#ifdef RTREE_CONCURRENT
+	pthread_rwlock_init(&t->lock, NULL);
+	pthread_mutex_init(&t->split_lock, NULL);
+	t->nsn = 0;
+	t->epoch = 0;
+	t->readers[0] = t->readers[1] = 0;
+#endif
+	t->root = RTreeNewNode(t);
+	if (!t->root) {
+		RTreeFreeIndex(t);
+		return NULL;
+	}
+	t->root->level = 0; /* leaf */
+	return t;
+}
+
+/**
+ * @brief 트리와 트리가 가진 모든 노드를 해제합니다.
+ *
+ * @details 노드들은 모두 트리의 풀에서 할당되므로 트리를 순회하지 않고
+ * 풀을 한 번에 돌려줍니다. RTreeOpen으로 연 트리는 매핑도 해제합니다.
+ *
+ * @param t 해제할 트리
+ */
+void RTreeFreeIndex(struct RTree *t)
+{
+	if (!t)
+		return;
+	RTreePoolRelease(&t->node_pool);
+	RTreePoolRelease(&t->list_pool);
+	free(t->leafref);
+	if (t->map)
+		munmap(t->map, t->map_size);
+#ifdef RTREE_CONCURRENT
+	pthread_rwlock_destroy(&t->lock);
+	pthread_mutex_destroy(&t->split_lock);
+#endif
+	free(t);
+}
+
+/**
+ * @brief n을 루트로 하는 서브 트리의 모든 노드를 풀에 돌려줍니다.
+ */
+void RTreeFreeSubtree(struct RTree *t, struct Node *n)
+{
+	int i;
+
+	if (n->level > 0)
+		for (i = 0; i < n->count; i++)
+			RTreeFreeSubtree(t, n->branch[i].child);
+	RTreeFreeNode(t, n);
+}
+
+#if NUMDIMS != 2
+#error "RTreeCompareCenter needs one comparator per dimension"
+#endif
+
+/**
+ * @brief 브랜치 사각형의 중심을 dim 차원 기준으로 비교합니다.
+ *
+ * @details 중심값을 2로 나누지 않아도 대소 관계는 동일하므로
+ * xmin + xmax만 비교하도록 합니다.
+ */
+static int RTreeCompareCenter0(const void *A, const void *B)
+{
+	const struct Rect *a = &((const struct Branch *)A)->rect;
+	const struct Rect *b = &((const struct Branch *)B)->rect;
+	RectDist ca = (RectDist)a->boundary[0] + a->boundary[NUMDIMS];
+	RectDist cb = (RectDist)b->boundary[0] + b->boundary[NUMDIMS];
+	return (ca > cb) - (ca < cb);
+}
+
+static int RTreeCompareCenter1(const void *A, const void *B)
+{
+	const struct Rect *a = &((const struct Branch *)A)->rect;
+	const struct Rect *b = &((const struct Branch *)B)->rect;
+	RectDist ca = (RectDist)a->boundary[1] + a->boundary[NUMDIMS + 1];
+	RectDist cb = (RectDist)b->boundary[1] + b->boundary[NUMDIMS + 1];
+	return (ca > cb) - (ca < cb);
+}
+
+static int (*const RTreeCompareCenter[NUMDIMS])(const void *, const void *) = {
+	RTreeCompareCenter0,
+	RTreeCompareCenter1,
+};
+
+/**
+ * @brief STR(Sort-Tile-Recursive) 방식으로 브랜치들을 정렬합니다.
+ *
+ * @details dim 차원으로 정렬한 후에 전체를 slab으로 나누고,
+ * 각 slab을 다음 차원으로 다시 정렬합니다.
+ * slab의 크기는 card의 배수이므로 card 단위로 자르면 한 노드가
+ * 두 slab에 걸치지 않게 됩니다.
+ *
+ * @param b 정렬할 브랜치 배열
+ * @param n 브랜치의 수
+ * @param dim 현재 정렬 기준 차원
+ * @param card 노드 하나에 들어갈 브랜치의 수
+ */
+static void RTreeSortTile(struct Branch *b, int n, int dim, int card)
+{
+	int pages, slabs, slab_size, i;
+
+	qsort(b, n, sizeof(struct Branch), RTreeCompareCenter[dim]);
+	if (dim == NUMDIMS - 1)
+		return;
+
+	pages = (n + card - 1) / card;
+	slabs = (int)ceil(pow(pages, 1.0 / (NUMDIMS - dim)));
+	slab_size = card * ((pages + slabs - 1) / slabs);
+	for (i = 0; i < n; i += slab_size)
+		RTreeSortTile(b + i, (n - i < slab_size) ? n - i : slab_size,
+			      dim + 1, card);
+}
+
+/**
+ * @brief 한 level의 브랜치들을 꽉 찬 노드들로 묶습니다.
+ *
+ * @details 만들어진 노드들을 가리키는 브랜치는 b의 앞쪽에 다시 기록되므로
+ * 반환 값만큼의 b를 그대로 다음 level의 입력으로 사용할 수 있습니다.
+ * 마지막 노드가 MinFill보다 적게 채워지는 경우에는 마지막 두 노드에
+ * 브랜치를 반씩 나눠서 루트가 아닌 노드가 MinFill 아래로 내려가지 않도록
+ * 합니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param b 묶을 브랜치 배열
+ * @param n 브랜치의 수
+ * @param level 만들어질 노드들의 level
+ *
+ * @return 만들어진 노드의 수
+ */
+static int RTreePackLevel(struct RTree *t, struct Branch *b, int n, int level)
+{
+	struct Node *node;
+	int card = level > 0 ? NODECARD(t) : LEAFCARD(t);
+	int i, j, m, size;
+
+	RTreeSortTile(b, n, 0, card);
+	for (i = 0, m = 0; i < n; i += size, m++) {
+		size = n - i < card ? n - i : card;
+		if (n - i > card && n - i - card < MinFill(t, card))
+			size = (n - i + 1) / 2;
+		node = RTreeNewNode(t);
+		node->level = level;
+		for (j = i; j < i + size; j++)
+			RTreeAddBranch(t, &b[j], node, NULL);
+		/**
+		 * @brief m <= i 이므로 아직 읽지 않은 브랜치를 덮어쓰지 않습니다.
+		 */
+		b[m].child = node;
+		b[m].rect = RTreeNodeCover(node);
+	}
+	return m;
+}
+
+/**
+ * @brief n개의 브랜치를 RTreePackTree로 묶을 때 만들어지는 노드의 수입니다.
+ *
+ * @details level마다 ceil(m / card)개의 노드가 생깁니다.
+ */
+static long RTreePackNodes(struct RTree *t, int n)
+{
+	int level, card;
+	long nodes;
+
+	for (level = 0, nodes = 0; level == 0 || n > 1; level++) {
+		card = level > 0 ? NODECARD(t) : LEAFCARD(t);
+		n = (n + card - 1) / card;
+		nodes += n;
+	}
+	return nodes;
+}
+
+/**
+ * @brief 브랜치들을 루트 하나가 남을 때까지 level별로 묶습니다.
+ *
+ * @details RTreePackNodes만큼의 노드를 미리 확보해 둔 상태여야 합니다.
+ *
+ * @return 만들어진 트리의 루트
+ */
+static struct Node *RTreePackTree(struct RTree *t, struct Branch *b, int n)
+{
+	int level = 0;
+
+	assert(n > 0);
+	do {
+		n = RTreePackLevel(t, b, n, level++);
+	} while (n > 1);
+	return b[0].child;
+}
+
+/**
+ * @brief 점(사각형)들로부터 꽉 찬 트리를 아래에서 위로 한 번에 만듭니다.
+ *
+ * @details STR로 정렬한 후에 leaf는 LEAFCARD, 내장 노드는 NODECARD만큼
+ * 채워서 만들기 때문에 RTreeInsertRect를 반복하는 것보다 빠르고
+ * 노드의 채움률도 높습니다. 만들어진 트리는 기존의 탐색, 삽입, 삭제 함수에서
+ * 그대로 사용할 수 있습니다. 트리에 있던 기존의 데이터는 모두 버려집니다.
+ *
+ * @param t 데이터를 채울 트리
+ * @param points 삽입할 사각형 배열
+ * @param ids 각 사각형의 id 배열
+ * @param n 사각형의 수
+ *
+ * @return 성공 시 0, 메모리가 부족한 경우 트리를 바꾸지 않고 -1을 반환합니다.
+ */
+int RTreeBulkLoad(struct RTree *t, struct Rect *points, tid_t *ids, int n)
+{
+	struct Branch *b;
+	int i;
+
+	assert(t && n >= 0);
+	if (n == 0) {
+		if (RTreeReserveNodes(t, 1))
+			return -1;
+		RTreeFreeSubtree(t, t->root);
+		t->root = RTreeNewNode(t);
+		t->root->level = 0; /* leaf */
+		return 0;
+	}
+	assert(points && ids);
+
+	b = (struct Branch *)malloc(n * sizeof(struct Branch));
+	if (!b)
+		return -1;
+	for (i = 0; i < n; i++) {
+		b[i].rect = points[i];
+		b[i].rect.is_use = true;
+		b[i].child = (struct Node *)ids[i];
+		if (RTreeReserveId(t, ids[i])) {
+			free(b);
+			return -1;
+		}
+	}
+
+	/**
+	 * @brief 기존 트리를 버리기 전에 새로운 노드들을 모두 확보해 둡니다.
+	 */
+	if (RTreeReserveNodes(t, RTreePackNodes(t, n))) {
+		free(b);
+		return -1;
+	}
+
+	RTreeFreeSubtree(t, t->root);
+	memset(t->leafref, 0, t->nleafref * sizeof(struct RTreeLeafRef));
+	t->ndead = 0;
+	t->root = RTreePackTree(t, b, n);
+
+	free(b);
+	return 0;
+}
+
+/**
+ * @brief 서브트리의 살아있는 데이터들을 b[m]부터 모읍니다.
+ *
+ * @return 모은 후의 데이터 수
+ */
+static long RTreeCollectBranches(struct Node *n, struct Branch *b, long m)
+{
+	int i;
+
+	for (i = 0; i < n->count; i++) {
+		if (n->level > 0) {
+			m = RTreeCollectBranches(n->branch[i].child, b, m);
+		} else if (RTreeLeafLive(n, i)) {
+			RTreeGetBranch(n, i, &b[m]);
+			b[m++].rect.is_use = true;
+		}
+	}
+	return m;
+}
+
+/**
+ * @brief 트리의 살아있는 데이터들로 꽉 찬 트리를 새로운 노드들에 만듭니다.
+ *
+ * @details RTreeBulkLoad와 달리 기존의 노드들은 바꾸지 않고 그대로 두므로,
+ * 기존 트리를 읽고 있는 탐색이 모두 끝난 후에 RTreeFreeSubtree로 돌려줍니다.
+ * id로 데이터의 위치를 찾는 표는 새로운 노드들을 가리키게 됩니다.
+ *
+ * @param t 트리에 해당합니다.
+ *
+ * @return 새로운 트리의 루트, 메모리가 부족한 경우 NULL을 반환합니다.
+ */
+struct Node *RTreeRepack(struct RTree *t)
+{
+	struct Branch *b;
+	struct Node *root;
+	long n = RTreeNodeTotal(t->root), m;
+
+	assert(n <= INT32_MAX);
+	b = (struct Branch *)malloc((n > 0 ? n : 1) * sizeof(struct Branch));
+	if (!b)
+		return NULL;
+	m = RTreeCollectBranches(t->root, b, 0);
+	assert(m <= n);
+	if (RTreeReserveNodes(t, m > 0 ? RTreePackNodes(t, m) : 1)) {
+		free(b);
+		return NULL;
+	}
+	if (m > 0) {
+		root = RTreePackTree(t, b, m);
+	} else {
+		root = RTreeNewNode(t);
+		root->level = 0; /* leaf */
+	}
+	free(b);
+	return root;
+}
+
+/**
+ * @brief 커서의 스택에 노드를 넣습니다.
+ *
+ * @details RTREE_SOA로 빌드한 경우에는 넣을 때 겹치는 브랜치들의 마스크를
+ * 한 번에 구해둡니다.
+ *
+ * @param c 커서를 가리키는 포인터입니다.
+ * @param n 스택에 넣을 노드에 해당합니다.
+ */
+static void RTreeCursorPush(struct RTreeCursor *c, struct Node *n)
+{
+	struct RTreeCursorFrame *f;
+
+	assert(n);
+	assert(n->level >= 0);
+	assert(c->depth + 1 < RTREE_MAX_DEPTH);
+
+	f = &c->stack[++c->depth];
+	f->node = n;
+#ifdef RTREE_SOA
+	f->mask = RTreeOverlapMask(n, &c->rect, n->count);
+#else
+	f->i = 0;
+#endif
+}
+
+/**
+ * @brief 사각형과 겹치는 데이터를 하나씩 꺼내올 수 있는 커서를 엽니다.
+ *
+ * @details 커서는 재귀 호출 대신에 고정 크기의 스택으로 트리를 내려가므로
+ * 호출하는 쪽에서 원하는 만큼만 결과를 꺼내고 멈출 수 있습니다.
+ * 커서를 사용하는 동안 트리를 수정해서는 안 됩니다.
+ *
+ * @param c 커서를 가리키는 포인터입니다.
+ * @param t 탐색할 트리에 해당합니다.
+ * @param r 탐색 범위에 해당합니다.
  */
-struct Node *RTreeNewIndex()
+void RTreeCursorOpen(struct RTreeCursor *c, struct RTree *t, struct Rect *r)
 {
-	struct Node *x;
-	x = RTreeNewNode();
-	x->level = 0; /* leaf */
-	return x;
+	assert(c && t && r);
+
+	c->rect = *r;
+	c->depth = -1;
+	RTreeCursorPush(c, t->root);
+}
+
+/**
+ * @brief 커서에서 다음으로 겹치는 데이터를 꺼냅니다.
+ *
+ * @param c 커서를 가리키는 포인터입니다.
+ * @param id 찾은 데이터의 id가 들어갑니다.
+ * @param rect 찾은 데이터의 사각형이 들어갑니다. (NULL이면 무시합니다.)
+ *
+ * @return 데이터를 찾은 경우 1, 더 이상 없는 경우 0을 반환합니다.
+ */
+int RTreeCursorNext(struct RTreeCursor *c, tid_t *id, struct Rect *rect)
+{
+	register struct RTreeCursorFrame *f;
+	register struct Node *n;
+	register int i;
+
+	assert(c && id);
+
+	while (c->depth >= 0) {
+		f = &c->stack[c->depth];
+		n = f->node;
+#ifdef RTREE_SOA
+		if (!f->mask) { /**< 노드의 겹치는 브랜치를 모두 본 경우 */
+			c->depth--;
+			continue;
+		}
+		i = __builtin_ctzll(f->mask);
+		f->mask &= f->mask - 1;
+#else
+		for (i = f->i; i < n->count; i++)
+			if (RTreeEntryOverlap(n, i, &c->rect))
+				break;
+		if (i == n->count) { /**< 노드의 브랜치를 모두 본 경우 */
+			c->depth--;
+			continue;
+		}
+		f->i = i + 1;
+#endif
+		if (n->level > 0) { /**< 트리의 내장 노드의 경우 */
+			if (n->level > 1 ||
+			    RTreeLeafValid(n->branch[i].child))
+				RTreeCursorPush(c, n->branch[i].child);
+		} else if (RTreeLeafLive(n, i)) { /**< 트리의 leaf 노드의 경우 */
+			*id = RTreeLeafId(n, i);
+			if (rect)
+				*rect = *RTreeEntryRect(n, i, rect);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief 커서를 닫습니다. 이후에 RTreeCursorNext는 항상 0을 반환합니다.
+ *
+ * @param c 커서를 가리키는 포인터입니다.
+ */
+void RTreeCursorClose(struct RTreeCursor *c)
+{
+	assert(c);
+	c->depth = -1;
 }
 
 /**
  * @brief 매개 변수로 준 사각형에 겹쳐지는 모든 사각형을 반환합니다.
  *
- * @param N root에 해당합니다.
+ * @details 커서를 사용해서 재귀 호출 없이 트리를 탐색합니다.
+ * RTREE_CONCURRENT로 빌드한 경우에는 삽입, 삭제와 동시에 호출할 수 있도록
+ * 잠금 없이 오른쪽 링크를 따라가는 탐색을 사용합니다.
+ *
+ * @param T 탐색할 트리에 해당합니다.
  * @param R 겹쳐지는 범위(탐색 범위)에 해당합니다.
  * @param shcb 데이터를 찾았을 때의 callback 함수에 해당합니다.
  * @param cbarg 추가적인 매개 변수 값입니다.
  *
  * @return 만난 사각형의 갯수를 반환합니다.
  */
-int RTreeSearch(struct Node *N, struct Rect *R, SearchHitCallback shcb,
+int RTreeSearch(struct RTree *T, struct Rect *R, SearchHitCallback shcb,
 		void *cbarg)
 {
-	register struct Node *n = N;
-	register struct Rect *r = R;
+	struct RTreeCursor c;
 	register int hitCount = 0;
-	register int i;
+	tid_t id;
 
-	assert(n);
-	assert(n->level >= 0);
-	assert(r);
-
-	if (n->level > 0) { /**< 트리의 내장 노드의 경우 */
-		for (i = 0; i < NODECARD; i++)
-			if (n->branch[i].child &&
-			    RTreeOverlap(r, &n->branch[i].rect)) {
-				hitCount += RTreeSearch(n->branch[i].child, R,
-							shcb, cbarg);
-			}
-	} else { /**< 트리의 leaf 노드의 경우 */
-		for (i = 0; i < LEAFCARD; i++)
-			if (n->branch[i].child &&
-			    RTreeOverlap(r, &n->branch[i].rect)) {
-				hitCount++;
-				if (shcb) /**< callback 함수 부여 여부 확인 */
-					if (!shcb((tid_t)n->branch[i].child,
-						  cbarg))
-						return hitCount; /**< callback 함수에서 에러가 발생한 경우 */
-			}
+	assert(T);
+	assert(R);
+
+#ifdef RTREE_CONCURRENT
+	return RTreeLatchedSearch(T, R, shcb, cbarg);
+#endif
+	RTreeCursorOpen(&c, T, R);
+	while (RTreeCursorNext(&c, &id, NULL)) {
+		hitCount++;
+		if (shcb) /**< callback 함수 부여 여부 확인 */
+			if (!shcb(id, cbarg))
+				break; /**< callback 함수에서 에러가 발생한 경우 */
 	}
+	RTreeCursorClose(&c);
 	return hitCount;
 }
 
+/**
+ * @brief 삽입 경로의 노드에 브랜치를 추가합니다.
+ *
+ * @details 노드가 꽉 찬 경우 R*-tree에서는 분할하기 전에 먼저 일부 브랜치를
+ * 재삽입하도록 합니다. 루트는 재삽입하지 않고 바로 분할합니다.
+ *
+ * @return 노드가 split 되지 않은 경우에는 0, split된 경우에는 1을 반환합니다.
+ */
+static int RTreeInsertBranch(struct RTree *t, struct Branch *b, struct Node *n,
+			     struct Node **new_node)
+{
+	if (n->count >= MAXKIDS(t, n) && n != t->root &&
+	    RTreeReinsertOverflow(t, n, b))
+		return 0;
+	return RTreeAddBranch(t, b, n, new_node);
+}
+
 /**
  * @brief 인덱스 구조에 새로운 사각형 데이터를 넣어주도록 합니다.
  *
@@ -69,6 +523,7 @@ int RTreeSearch(struct Node *N, struct Rect *R, SearchHitCallback shcb,
  * 1이 반환되는 경우에는 분할이 발생을 하여 새로운 노드로 포인터를 설정해주도록 합니다.
  * 이전 노드는 2개 중 하나로 갱신되게 됩니다.
  *
+ * @param t 트리에 해당합니다.
  * @param r 사각형을 가리킵니다.
  * @param tid 사각형의 id에 해당합니다.
  * @param n 새로운 노드에 해당합니다.
@@ -77,8 +532,8 @@ int RTreeSearch(struct Node *N, struct Rect *R, SearchHitCallback shcb,
  *
  * @return 노드가 split이 된 경우 0을 안된 경우에는 1을 반환
  */
-static int RTreeInsertRect2(struct Rect *r, tid_t tid, struct Node *n,
-			    struct Node **new_node, int level)
+static int RTreeInsertRect2(struct RTree *t, struct Rect *r, tid_t tid,
+			    struct Node *n, struct Node **new_node, int level)
 {
 	register int i;
 	struct Branch b;
@@ -92,16 +547,27 @@ static int RTreeInsertRect2(struct Rect *r, tid_t tid, struct Node *n,
 	 *
 	 */
 	if (n->level > level) {
-		i = RTreePickBranch(r, n);
-		if (!RTreeInsertRect2(r, tid, n->branch[i].child, &n2, level)) {
-			n->branch[i].rect =
-				RTreeCombineRect(r, &(n->branch[i].rect));
+		i = RTreePickBranch(t, r, n);
+		if (!RTreeInsertRect2(t, r, tid, n->branch[i].child, &n2,
+				      level)) {
+			/**
+			 * @brief R*-tree에서는 재삽입으로 자식이 줄어들 수 있습니다.
+			 */
+			if (t->method == RTREE_RSTAR)
+				b.rect = RTreeNodeCover(n->branch[i].child);
+			else
+				b.rect = RTreeCombineRect(
+					r, &(n->branch[i].rect));
+			RTreeSetBranchRect(n, i, &b.rect);
+			RTreeUpdateAggregate(n, i);
 			return 0;
 		} else { /**< child가 분할된 경우에 해당합니다. */
-			n->branch[i].rect = RTreeNodeCover(n->branch[i].child);
+			b.rect = RTreeNodeCover(n->branch[i].child);
+			RTreeSetBranchRect(n, i, &b.rect);
+			RTreeUpdateAggregate(n, i);
 			b.child = n2;
 			b.rect = RTreeNodeCover(n2);
-			return RTreeAddBranch(&b, n, new_node);
+			return RTreeInsertBranch(t, &b, n, new_node);
 		}
 	} else if (n->level == level) {
 		/**
@@ -109,7 +575,7 @@ static int RTreeInsertRect2(struct Rect *r, tid_t tid, struct Node *n,
 		 */
 		b.rect = *r;
 		b.child = (struct Node *)tid;
-		return RTreeAddBranch(&b, n, new_node);
+		return RTreeInsertBranch(t, &b, n, new_node);
 	} else {
 		assert(FALSE);
 		return 0;
@@ -117,42 +583,29 @@ static int RTreeInsertRect2(struct Rect *r, tid_t tid, struct Node *n,
 }
 
 /**
- * @brief index 구조에 사각형 데이터를 삽입합니다.
- *
- * @param R 삽입되는 사각형에 해당합니다.
- * @param Tid 삽입되는 사각형의 ID에 해당합니다.
- * @param Root R-Tree의 루트에 해당합니다.
- * @param Level leaf level에서 삽입까지 얼만큼 왔는 지를 확인하는 변수입니다.
+ * @brief 루트에서부터 사각형을 삽입하고, 루트가 분할되면 새로운 루트를 만듭니다.
  *
  * @return split이 발생한 경우 1을 반환, 그렇지 않은 경우 0을 반환합니다.
  */
-int RTreeInsertRect(struct Rect *R, tid_t Tid, struct Node **Root, int Level)
+static int RTreeInsertRoot(struct RTree *t, struct Rect *r, tid_t tid,
+			   int level)
 {
-	register struct Rect *r = R;
-	register tid_t tid = Tid;
-	register struct Node **root = Root;
-	register int level = Level;
-	register int i;
+	register struct Node **root = &t->root;
 	register struct Node *newroot;
 	struct Node *newnode;
 	struct Branch b;
 	int result;
 
-	assert(r && root);
-	assert(level >= 0 && level <= (*root)->level);
-	for (i = 0; i < NUMDIMS; i++)
-		assert(r->boundary[i] <= r->boundary[NUMDIMS + i]);
-
-	if (RTreeInsertRect2(r, tid, *root, &newnode,
+	if (RTreeInsertRect2(t, r, tid, *root, &newnode,
 			     level)) { /**< 루트에 대해 split을 진행합니다.*/
-		newroot = RTreeNewNode(); /**< 새로운 루트를 만들어 냅니다. */
+		newroot = RTreeNewNode(t); /**< 새로운 루트를 만들어 냅니다. */
 		newroot->level = (*root)->level + 1;
 		b.rect = RTreeNodeCover(*root);
 		b.child = *root;
-		RTreeAddBranch(&b, newroot, NULL);
+		RTreeAddBranch(t, &b, newroot, NULL);
 		b.rect = RTreeNodeCover(newnode);
 		b.child = newnode;
-		RTreeAddBranch(&b, newroot, NULL);
+		RTreeAddBranch(t, &b, newroot, NULL);
 		*root = newroot;
 		result = 1;
 	} else {
@@ -162,18 +615,77 @@ int RTreeInsertRect(struct Rect *R, tid_t Tid, struct Node **Root, int Level)
 	return result;
 }
 
+/**
+ * @brief index 구조에 사각형 데이터를 삽입합니다.
+ *
+ * @details R*-tree에서는 삽입 중에 재삽입 버퍼로 옮겨진 브랜치들을
+ * 가까운 것부터 다시 삽입합니다. 삽입한 데이터는 R의 is_use와 관계없이
+ * 살아있는 데이터가 됩니다.
+ *
+ * @param T 삽입할 트리에 해당합니다. 루트가 분할되면 트리의 루트가 바뀝니다.
+ * @param R 삽입되는 사각형에 해당합니다.
+ * @param Tid 삽입되는 사각형의 ID에 해당합니다.
+ * @param Level leaf level에서 삽입까지 얼만큼 왔는 지를 확인하는 변수입니다.
+ *
+ * @return split이 발생한 경우 1을 반환, 그렇지 않은 경우 0을 반환합니다.
+ * id의 위치를 기록할 메모리나 노드가 부족한 경우에는 트리를 바꾸지 않고
+ * -1을 반환합니다.
+ */
+int RTreeInsertRect(struct RTree *T, struct Rect *R, tid_t Tid, int Level)
+{
+	register struct RTree *t = T;
+	register struct Rect *r = R;
+	register tid_t tid = Tid;
+	register int level = Level;
+	register struct SplitVars *s = &t->split;
+	register int i;
+	struct Branch b;
+	struct Rect live;
+	int result;
+
+	assert(r && t->root);
+	assert(level >= 0 && level <= t->root->level);
+	for (i = 0; i < NUMDIMS; i++)
+		assert(r->boundary[i] <= r->boundary[NUMDIMS + i]);
+	if (level == 0 && !r->is_use) { /**< tombstone으로 들어가지 않도록 */
+		live = *r;
+		live.is_use = true;
+		r = &live;
+	}
+
+#ifdef RTREE_CONCURRENT
+	return RTreeLatchedInsert(t, r, tid, level);
+#endif
+	if (level == 0 && RTreeReserveId(t, tid))
+		return -1;
+	if (RTreeReserveInsert(t))
+		return -1;
+#ifdef RTREE_HILBERT
+	if (t->method == RTREE_HILBERT_TREE)
+		return RTreeHilbertInsert(t, r, tid, level);
+#endif
+	s->OverflowLevels = 0;
+	result = RTreeInsertRoot(t, r, tid, level);
+	while (s->ReinsertCount > 0) {
+		i = --s->ReinsertCount;
+		b = s->ReinsertBuf[i];
+		result |= RTreeInsertRoot(t, &b.rect, (tid_t)b.child,
+					  s->ReinsertLevel[i]);
+	}
+	return result;
+}
+
 // Allocate space for a node in the list used in DeletRect to
 // store Nodes that are too empty.
 //
-static struct ListNode *RTreeNewListNode()
+static struct ListNode *RTreeNewListNode(struct RTree *t)
 {
-	return (struct ListNode *)malloc(sizeof(struct ListNode));
-	// return new ListNode;
+	return (struct ListNode *)RTreePoolAlloc(&t->list_pool);
 }
 
-static void RTreeFreeListNode(struct ListNode *p)
+static void RTreeFreeListNode(struct RTree *t, struct ListNode *p)
 {
-	free(p);
+	RTreePoolFree(&t->list_pool, p);
 }
 
 // Add a node to the reinsertion list.  All its branches will later
@@ -183,64 +695,438 @@ static void RTreeFreeListNode(struct ListNode *p)
  * @brief 노드를 재삽입 리스트에 넣어줍니다.
  * 향후 모든 브랜치들은 인덱스 구조체에 재삽입됩니다.
  *
+ * @param t 트리에 해당합니다.
  * @param n 재삽입 리스트에 들어갈 노드
  * @param ee 히스트 노드의 head
  */
-static void RTreeReInsert(struct Node *n, struct ListNode **ee)
+static void RTreeReInsert(struct RTree *t, struct Node *n,
+			  struct ListNode **ee)
 {
 	register struct ListNode *l;
 
-	l = RTreeNewListNode();
+	l = RTreeNewListNode(t);
 	l->node = n;
 	l->next = *ee;
 	*ee = l;
 }
 
+/**
+ * @brief 모자라게 된 자식 노드를 부모에서 떼어냅니다.
+ *
+ * @details 빈 노드는 재삽입할 브랜치가 없으므로 리스트에 넣지 않고 바로
+ * 해제합니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param p 부모 노드
+ * @param i 떼어낼 자식의 브랜치 번호
+ * @param ee 재삽입 리스트의 head
+ */
+static void RTreeDetachChild(struct RTree *t, struct Node *p, int i,
+			     struct ListNode **ee)
+{
+	struct Node *c = p->branch[i].child;
+
+	if (c->count > 0)
+		RTreeReInsert(t, c, ee);
+	RTreeDisconnectBranch(t, p, i);
+	if (c->count == 0)
+		RTreeFreeNode(t, c);
+}
+
+/**
+ * @brief 떼어낼 노드들의 브랜치를 재삽입하는 데 필요한 노드를 확보합니다.
+ *
+ * @details 재삽입은 브랜치를 떼어낸 후에 하므로 실패하면 데이터를 잃게
+ * 됩니다. 따라서 트리를 고치기 전에 재삽입 k번에 필요한 노드를 확보하고,
+ * 확보하지 못한 경우에는 모자란 노드를 그대로 두고 빈 노드만 떼어냅니다.
+ * 재삽입하는 동안 루트가 나눠져서 트리가 한 level 높아질 수 있으므로
+ * 재삽입마다 하나씩 더 확보합니다. R*-tree의 재삽입에 필요한 노드는
+ * RTreeCondenseInsert가 따로 확보합니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param k 재삽입할 브랜치의 수
+ * @param m 재삽입 리스트에 들어갈 노드의 수
+ *
+ * @return 이보다 브랜치가 적은 노드를 떼어내도록 하는 최소 브랜치 수
+ */
+static int RTreeReserveCondense(struct RTree *t, long k, long m)
+{
+	if (k > 0 && (RTreeReserveNodes(t, k * (RTreeInsertNodes(t, 0) + 1)) ||
+		      RTreePoolReserve(&t->list_pool, m)))
+		return 1;
+	return MinNodeFill(t);
+}
+
+/**
+ * @brief 브랜치가 빠진 노드에서부터 루트까지 떼어내게 될 노드들을 세고
+ * 재삽입에 필요한 노드를 확보합니다.
+ *
+ * @details 이전에 확보하지 못해서 모자란 채로 남은 노드도 떼어내므로
+ * 루트까지 모두 봅니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param n 브랜치가 빠진 노드
+ *
+ * @return RTreeReserveCondense와 같습니다.
+ */
+static int RTreeCondenseFill(struct RTree *t, struct Node *n)
+{
+	long k = 0, m = 0;
+	int count = n->count, gone;
+
+	for (; n != t->root; n = n->parent) {
+		gone = count < MinNodeFill(t);
+		if (gone && count > 0) {
+			k += count;
+			m++;
+		}
+		count = n->parent->count - gone;
+	}
+	return RTreeReserveCondense(t, k, m);
+}
+
+/**
+ * @brief 떼어낸 노드의 브랜치 하나를 다시 넣습니다.
+ *
+ * @details RTreeReserveCondense가 분할만 하는 삽입 left번에 필요한 노드를
+ * 확보해두었습니다. R*-tree는 재삽입을 하는 삽입에 필요한 노드와 남은
+ * left - 1번에 필요한 노드를 확보할 수 있을 때만 재삽입을 하고, 그렇지
+ * 않으면 재삽입 없이 분할만 하므로 실패하지 않습니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param b 다시 넣을 브랜치
+ * @param level 브랜치를 넣을 level
+ * @param left 이 브랜치를 포함해서 남은 재삽입의 수
+ */
+static void RTreeCondenseInsert(struct RTree *t, struct Branch *b, int level,
+				long left)
+{
+	long rest = (left - 1) * (RTreeInsertNodes(t, 0) + 1);
+
+	if (t->method != RTREE_RSTAR ||
+	    !RTreeReserveNodes(t, RTreeInsertNodes(t, 1) + rest)) {
+		RTreeInsertRect(t, &b->rect, (tid_t)b->child, level);
+		return;
+	}
+	t->split.OverflowLevels = ~0u; /**< 모든 level에서 재삽입 대신 분할 */
+	RTreeInsertRoot(t, &b->rect, (tid_t)b->child, level);
+}
+
+/**
+ * @brief 삭제 후에 떼어낸 노드들의 브랜치를 재삽입하고 루트를 정리합니다.
+ *
+ * @details leaf에 남아있던 tombstone은 재삽입하지 않고 버립니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param reInsertList 떼어낸 노드들의 리스트
+ */
+static void RTreeCondenseRoot(struct RTree *t, struct ListNode *reInsertList)
+{
+	register struct Node **nn = &t->root;
+	register struct Node *tmp_nptr;
+	register struct ListNode *e;
+	register int i;
+	struct Branch b;
+	long left = 0;
+
+	for (e = reInsertList; e; e = e->next)
+		left += e->node->count;
+
+	/**
+	 * @brief 삭제할 데이터를 찾은 경우에 브랜치들로부터
+	 * 제거되어진 노드들을 가져와서 재삽입을 진행합니다.
+	 *
+	 */
+	while (reInsertList) {
+		tmp_nptr = reInsertList->node;
+		for (i = 0; i < tmp_nptr->count; i++, left--) {
+			if (tmp_nptr->level == 0 &&
+			    !RTreeLeafLive(tmp_nptr, i)) { /**< 버립니다. */
+				t->ndead--;
+				t->dstats.purged++;
+				continue;
+			}
+			RTreeGetBranch(tmp_nptr, i, &b);
+			RTreeCondenseInsert(t, &b, tmp_nptr->level, left);
+			t->dstats.reinserted++;
+		}
+		/**
+		 * @brief: 마지막으로 재삽입 리스트에 들어간 노드가
+		 * leaf 노드이자 삭제 대상이므로 삭제해줍니다.
+		 */
+		e = reInsertList;
+		reInsertList = reInsertList->next;
+		RTreeFreeNode(t, e->node);
+		RTreeFreeListNode(t, e);
+	}
+
+	/**
+	 * @brief: leaf가 아니면서 1개의 child를 가지는
+	 * 중복된 루트를 확인해서 제거합니다.
+	 */
+	while ((*nn)->count == 1 && (*nn)->level > 0) {
+		tmp_nptr = (*nn)->branch[0].child;
+		assert(tmp_nptr);
+		RTreeFreeNode(t, *nn);
+		tmp_nptr->parent = NULL;
+		*nn = tmp_nptr;
+	}
+}
+
+/**
+ * @brief 노드에서 자식 노드를 가리키는 브랜치 번호를 찾습니다.
+ */
+static int RTreeChildSlot(struct Node *p, struct Node *n)
+{
+	register int i;
+
+	for (i = 0; p->branch[i].child != n; i++)
+		assert(i + 1 < p->count);
+	return i;
+}
+
+/**
+ * @brief 브랜치가 빠진 노드에서부터 부모 포인터를 따라 루트까지 올라가면서
+ * 사각형과 데이터 수를 고칩니다.
+ *
+ * @details 너무 비게 된 노드는 RTreeDeleteRect2와 같이 떼어내서
+ * 재삽입 리스트에 넣습니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param n 브랜치가 빠진 노드
+ * @param fill RTreeCondenseFill이 반환한 최소 브랜치 수
+ * @param ee 재삽입 리스트의 head
+ */
+static void RTreeCondenseUp(struct RTree *t, struct Node *n, int fill,
+			    struct ListNode **ee)
+{
+	register struct Node *p;
+	struct Rect cover;
+	register int i;
+
+	for (; n != t->root; n = p) {
+		p = n->parent;
+		i = RTreeChildSlot(p, n);
+		if (n->count >= fill) {
+			cover = RTreeNodeCover(n);
+			RTreeSetBranchRect(p, i, &cover);
+			RTreeUpdateAggregate(p, i);
+		} else {
+			RTreeDetachChild(t, p, i, ee);
+		}
+	}
+}
+
+/**
+ * @brief leaf의 tombstone들을 모두 빼고 모자라게 된 노드들을 정리합니다.
+ */
+static void RTreePurgeLeaf(struct RTree *t, struct Node *n)
+{
+	struct ListNode *reInsertList = NULL;
+	register int i;
+
+	for (i = n->count - 1; i >= 0; i--) {
+		if (RTreeLeafLive(n, i))
+			continue;
+		RTreeDisconnectBranch(t, n, i);
+		t->ndead--;
+		t->dstats.purged++;
+	}
+	t->dstats.leaf_purges++;
+	RTreeCondenseUp(t, n, RTreeCondenseFill(t, n), &reInsertList);
+	RTreeCondenseRoot(t, reInsertList);
+}
+
+/**
+ * @brief 서브트리의 tombstone들을 모두 빼고 모자라게 된 노드들을 떼어냅니다.
+ *
+ * @details 자식부터 정리하고 올라오므로 한 번의 순회로 끝납니다. 브랜치를
+ * 뒤에서부터 보므로 RTreeDisconnectBranch가 옮기는 마지막 브랜치는 이미 본
+ * 브랜치입니다. 루트는 비게 되지 않도록 마지막 자식을 남겨둡니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param n 정리할 서브트리의 루트
+ * @param fill RTreeReserveCondense가 반환한 최소 브랜치 수
+ * @param ee 재삽입 리스트의 head
+ */
+static void RTreePurge2(struct RTree *t, struct Node *n, int fill,
+			struct ListNode **ee)
+{
+	register struct Node *c;
+	register int i;
+	struct Rect cover;
+
+	t->dstats.visited++;
+	if (n->level == 0) {
+		for (i = n->count - 1; i >= 0; i--) {
+			if (RTreeLeafLive(n, i))
+				continue;
+			RTreeDisconnectBranch(t, n, i);
+			t->ndead--;
+			t->dstats.purged++;
+		}
+		return;
+	}
+	for (i = n->count - 1; i >= 0; i--) {
+		c = n->branch[i].child;
+		RTreePurge2(t, c, fill, ee);
+		if (c->count >= fill || (n == t->root && n->count == 1)) {
+			cover = RTreeNodeCover(c);
+			RTreeSetBranchRect(n, i, &cover);
+			RTreeUpdateAggregate(n, i);
+		} else {
+			RTreeDetachChild(t, n, i, ee);
+		}
+	}
+}
+
+/**
+ * @brief RTreePurge2가 떼어내게 될 노드들과 재삽입할 브랜치들을 셉니다.
+ *
+ * @details RTreePurge2와 같은 순서로 보면서 트리는 고치지 않습니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param n 정리할 서브트리의 루트
+ * @param k 재삽입할 브랜치의 수가 더해집니다.
+ * @param m 재삽입 리스트에 들어갈 노드의 수가 더해집니다.
+ *
+ * @return 정리한 후의 n의 브랜치 수
+ */
+static int RTreePurgeCount(struct RTree *t, struct Node *n, long *k, long *m)
+{
+	register int i, count, left = n->count;
+
+	if (n->level == 0)
+		return (int)RTreeNodeTotal(n);
+	for (i = n->count - 1; i >= 0; i--) {
+		count = RTreePurgeCount(t, n->branch[i].child, k, m);
+		if (count >= MinNodeFill(t) || (n == t->root && left == 1))
+			continue;
+		if (count > 0) {
+			*k += count;
+			(*m)++;
+		}
+		left--;
+	}
+	return left;
+}
+
+/**
+ * @brief 트리에 남아있는 tombstone들을 한 번에 정리합니다.
+ *
+ * @details 모든 노드를 한 번씩 방문하고, 모자라게 된 노드들은 모아서
+ * 재삽입합니다. tombstone이 트리의 일정 비율 이상일 때에만 부르므로
+ * 순회의 비용은 그 사이의 삭제들에 나눠집니다.
+ *
+ * @param t 트리에 해당합니다.
+ */
+void RTreePurge(struct RTree *t)
+{
+	struct ListNode *reInsertList = NULL;
+	long k = 0, m = 0;
+
+	assert(t && t->root);
+
+	if (t->ndead == 0)
+		return;
+	t->dstats.tree_purges++;
+	RTreePurgeCount(t, t->root, &k, &m);
+	RTreePurge2(t, t->root, RTreeReserveCondense(t, k, m), &reInsertList);
+	RTreeCondenseRoot(t, reInsertList);
+	assert(t->ndead == 0);
+}
+
+/**
+ * @brief lazy 삭제에서 데이터를 tombstone으로 표시합니다.
+ *
+ * @details 데이터는 leaf에 그대로 두고 조상들의 데이터 수만 줄이므로 트리의
+ * 모양은 바뀌지 않습니다. leaf 안의 tombstone 비율이 lazy_node에 이르면
+ * 그 leaf를, 트리 전체의 비율이 lazy_tree에 이르면 트리 전체를 정리합니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param tid 레코드의 id에 해당합니다.
+ *
+ * @return 레코드를 찾은 경우 0, 못 찾은 경우 1을 반환합니다.
+ */
+static int RTreeTombstone(struct RTree *t, tid_t tid)
+{
+	register struct Node *n, *c, *p;
+	register int i;
+	long live;
+
+	if (tid >= t->nleafref || !t->leafref[tid].leaf)
+		return 1;
+	n = t->leafref[tid].leaf;
+	i = t->leafref[tid].slot;
+	assert(n->level == 0 && RTreeLeafId(n, i) == tid);
+	n->branch[i].rect.is_use = false;
+	n->subcount[i] = 0;
+	t->leafref[tid].leaf = NULL;
+	for (c = n, p = n->parent; p; c = p, p = p->parent)
+		p->subcount[RTreeChildSlot(p, c)]--;
+	t->ndead++;
+	t->dstats.deletes++;
+
+	live = RTreeNodeTotal(n);
+	if (t->lazy_node &&
+	    (n->count - live) * 100 >= (long)t->lazy_node * n->count)
+		RTreePurgeLeaf(t, n);
+	live = RTreeNodeTotal(t->root);
+	if (t->lazy_tree &&
+	    t->ndead * 100 >= (long)t->lazy_tree * (live + t->ndead))
+		RTreePurge(t);
+	return 0;
+}
+
 /**
  * @brief index 구조체의 일부분에서 루트가 아닌 사각형을 제거합니다.
  *
  * @details 재귀적으로 트리를 들어가서 루트로 올라가면서 merge를 진행합니다.
  *
+ * @param t 트리에 해당합니다.
  * @param R 지우고자 하는 사각형 정보
  * @param Tid 지우고자 하는 사각형의 id
  * @param N 노드를 가리키는 포인터
+ * @param fill 데이터를 지운 leaf에서 RTreeCondenseFill이 반환한 최소 브랜치
+ * 수가 들어갑니다.
  * @param Ee node들의 리스트 head에 해당합니다.
  *
  * @return 레코드를 찾은 경우 0, 못 찾은 경우 1을 반환합니다.
  */
-static int RTreeDeleteRect2(struct Rect *R, tid_t Tid, struct Node *N,
-			    struct ListNode **Ee)
+static int RTreeDeleteRect2(struct RTree *t, struct Rect *R, tid_t Tid,
+			    struct Node *N, int *fill, struct ListNode **Ee)
 {
 	register struct Rect *r = R;
 	register tid_t tid = Tid;
 	register struct Node *n = N;
 	register struct ListNode **ee = Ee;
 	register int i;
+	struct Rect cover;
 
 	assert(r && n && ee);
 	assert(tid >= 0);
 	assert(n->level >= 0);
 
 	if (n->level > 0) { /**< 리프 노드가 아닌 경우*/
-		for (i = 0; i < NODECARD; i++) {
-			if (n->branch[i].child &&
-			    RTreeOverlap(r, &(n->branch[i].rect))) {
-				if (!RTreeDeleteRect2(r, tid,
-						      n->branch[i].child, ee)) {
+		for (i = 0; i < n->count; i++) {
+			if (RTreeOverlap(r, &(n->branch[i].rect))) {
+				if (!RTreeDeleteRect2(t, r, tid,
+						      n->branch[i].child, fill,
+						      ee)) {
 					if (n->branch[i].child->count >=
-					    MinNodeFill)
-						n->branch[i]
-							.rect = RTreeNodeCover(
+					    *fill) {
+						cover = RTreeNodeCover(
 							n->branch[i].child);
-					else {
+						RTreeSetBranchRect(n, i,
+								   &cover);
+						RTreeUpdateAggregate(n, i);
+					} else {
 						/**
 						 * @brief 자식(child) 노드에 충분하지 않은 엔트리가 있는 경우에
 						 * 자식 노드를 제거합니다.
 						 *
 						 */
-						RTreeReInsert(
-							n->branch[i].child, ee);
-						RTreeDisconnectBranch(n, i);
+						RTreeDetachChild(t, n, i, ee);
 					}
 					return 0;
 				}
@@ -248,10 +1134,10 @@ static int RTreeDeleteRect2(struct Rect *R, tid_t Tid, struct Node *N,
 		}
 		return 1;
 	} else { /**< 리프 노드인 경우 */
-		for (i = 0; i < LEAFCARD; i++) {
-			if (n->branch[i].child &&
-			    n->branch[i].child == (struct Node *)tid) {
-				RTreeDisconnectBranch(n, i);
+		for (i = 0; i < n->count; i++) {
+			if (RTreeLeafId(n, i) == tid) {
+				RTreeDisconnectBranch(t, n, i);
+				*fill = RTreeCondenseFill(t, n);
 				return 0;
 			}
 		}
@@ -262,69 +1148,211 @@ static int RTreeDeleteRect2(struct Rect *R, tid_t Tid, struct Node *N,
 /**
  * @brief index 구조로부터 사각형 데이터를 제거하도록 합니다.
  *
+ * @param T 트리에 해당합니다.
  * @param R 사각형을 가리키는 포인터
  * @param Tid 레코드의 id에 해당합니다.
- * @param Nn root node 포인터의 포인터에 해당합니다.
  *
  * @return 1은 레코드를 찾은 것이고, 0은 찾지 못한 것입니다.
  * @note root의 제거가 발생할 수 있습니다. 
+ * RTREE_CONCURRENT로 빌드한 경우에는 노드를 합치지 않고, 트리가 너무 비게
+ * 되면 RTreeRepack으로 다시 채웁니다.
+ * lazy 삭제에서는 RTreeDeleteId와 같이 id로 찾아서 tombstone으로 만듭니다.
  */
-int RTreeDeleteRect(struct Rect *R, tid_t Tid, struct Node **Nn)
+int RTreeDeleteRect(struct RTree *T, struct Rect *R, tid_t Tid)
 {
+	register struct RTree *t = T;
 	register struct Rect *r = R;
 	register tid_t tid = Tid;
-	register struct Node **nn = Nn;
-	register int i;
-	register struct Node *tmp_nptr;
+	register struct Node **nn = &t->root;
 	struct ListNode *reInsertList = NULL;
-	register struct ListNode *e;
+	int fill;
 
 	assert(r && nn);
 	assert(*nn);
 	assert(tid >= 0);
 
-	if (!RTreeDeleteRect2(r, tid, *nn, &reInsertList)) {
-		/**
-		 * @brief 삭제할 데이터를 찾은 경우에 브랜치들로부터
-		 * 제거되어진 노드들을 가져와서 재삽입을 진행합니다.
-		 *
-		 */
-		while (reInsertList) {
-			tmp_nptr = reInsertList->node;
-			for (i = 0; i < MAXKIDS(tmp_nptr); i++) {
-				if (tmp_nptr->branch[i].child) {
-					RTreeInsertRect(
-						&(tmp_nptr->branch[i].rect),
-						(tid_t)tmp_nptr->branch[i].child,
-						nn, tmp_nptr->level);
-				}
-			}
-			/**
-			 * @brief: 마지막으로 재삽입 리스트에 들어간 노드가
-			 * leaf 노드이자 삭제 대상이므로 삭제해줍니다.
-			 */
-			e = reInsertList;
-			reInsertList = reInsertList->next;
-			RTreeFreeNode(e->node);
-			RTreeFreeListNode(e);
-		}
-
-		/**
-		 * @brief: leaf가 아니면서 1개의 child를 가지는
-		 * 중복된 루트를 확인해서 제거합니다.
-		 */
-		if ((*nn)->count == 1 && (*nn)->level > 0) {
-			for (i = 0; i < NODECARD; i++) {
-				tmp_nptr = (*nn)->branch[i].child;
-				if (tmp_nptr)
-					break;
-			}
-			assert(tmp_nptr);
-			RTreeFreeNode(*nn);
-			*nn = tmp_nptr;
-		}
+#ifdef RTREE_CONCURRENT
+	return RTreeLatchedDelete(t, r, tid);
+#endif
+	if (LazyDelete(t))
+		return RTreeTombstone(t, tid);
+	if (!RTreeDeleteRect2(t, r, tid, *nn, &fill, &reInsertList)) {
+		t->dstats.deletes++;
+		RTreeCondenseRoot(t, reInsertList);
 		return 0;
 	} else {
 		return 1;
 	}
 }
+
+/**
+ * @brief id만으로 index 구조로부터 데이터를 제거하도록 합니다.
+ *
+ * @details id로 데이터가 들어있는 leaf와 브랜치 번호를 바로 찾은 후에
+ * 부모 포인터를 따라 루트까지 올라가면서 사각형과 데이터 수를 고칩니다.
+ * 너무 비게 된 노드는 RTreeDeleteRect와 같이 떼어내서 재삽입합니다.
+ * 따라서 사각형이 겹치는 다른 경로들을 내려가 보지 않습니다.
+ * lazy 삭제에서는 데이터를 tombstone으로 표시만 합니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param tid 레코드의 id에 해당합니다.
+ *
+ * @return 레코드를 찾은 경우 0, 못 찾은 경우 1을 반환합니다.
+ * @note RTREE_CONCURRENT로 빌드한 경우에는 RTreeDeleteRect와 같이
+ * 찾은 leaf만 잠가서 제거하고 노드를 합치지 않습니다.
+ */
+int RTreeDeleteId(struct RTree *t, tid_t tid)
+{
+	struct ListNode *reInsertList = NULL;
+	register struct Node *n;
+	register int i;
+
+	assert(t && t->root);
+
+#ifdef RTREE_CONCURRENT
+	return RTreeLatchedDelete(t, NULL, tid);
+#endif
+	if (LazyDelete(t))
+		return RTreeTombstone(t, tid);
+	if (tid >= t->nleafref || !t->leafref[tid].leaf)
+		return 1;
+	n = t->leafref[tid].leaf;
+	i = t->leafref[tid].slot;
+	assert(n->level == 0 && RTreeLeafId(n, i) == tid);
+	RTreeDisconnectBranch(t, n, i);
+	t->dstats.deletes++;
+	RTreeCondenseUp(t, n, RTreeCondenseFill(t, n), &reInsertList);
+	RTreeCondenseRoot(t, reInsertList);
+	return 0;
+}
+
+/**
+ * @brief 삭제에 든 비용의 통계를 가져옵니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param s 통계가 들어갑니다.
+ */
+void RTreeGetDeleteStats(struct RTree *t, struct RTreeDeleteStats *s)
+{
+	assert(t && s);
+	*s = t->dstats;
+}
+
+/**
+ * @brief leaf의 i번째 데이터를 그 자리에서 옮길 수 있으면 옮깁니다.
+ *
+ * @details 새로운 사각형이 leaf의 사각형 안에 들어가거나, leaf의 사각형을
+ * 허용 범위 안에서만 늘리면 되는 경우에 데이터의 사각형을 바꾸고
+ * 부모 포인터를 따라 올라가면서 사각형이 더 이상 바뀌지 않을 때까지
+ * 조상들의 사각형을 고칩니다.
+ *
+ * @return 옮긴 경우 1, 다시 삽입해야 하는 경우 0
+ */
+static int RTreeUpdateInPlace(struct RTree *t, struct Node *n, int i,
+			      struct Rect *r)
+{
+	register struct Node *c, *p;
+	struct Rect cover, *leafrect;
+	register int k;
+
+#ifdef RTREE_HILBERT
+	if (t->method == RTREE_HILBERT_TREE)
+		return 0; /**< Hilbert 순서가 바뀌므로 다시 삽입합니다. */
+#endif
+	if (n->parent) {
+		k = RTreeChildSlot(n->parent, n);
+		leafrect = &n->parent->branch[k].rect;
+		if (RTreeContained(r, leafrect)) {
+			t->ustats.inplace++;
+		} else {
+			cover = RTreeCombineRect(leafrect, r);
+			if (RTreeRectMargin(&cover) * 100 >
+			    RTreeRectMargin(leafrect) * (100 + t->update_slack))
+				return 0;
+			t->ustats.enlarged++;
+		}
+	} else {
+		t->ustats.inplace++;
+	}
+
+#ifdef RTREE_POINTLEAF
+	assert(r->boundary[0] == r->boundary[NUMDIMS]);
+	memcpy(n->point[i].p, r->boundary, sizeof(n->point[i].p));
+#else
+	cover = *r;
+	cover.is_use = true;
+	RTreeSetBranchRect(n, i, &cover);
+#endif
+#ifdef RTREE_HILBERT
+	n->lhv[i] = RTreeHilbertKey(r);
+#endif
+	for (c = n, p = n->parent; p; c = p, p = p->parent) {
+		k = RTreeChildSlot(p, c);
+		cover = RTreeNodeCover(c);
+		if (!memcmp(cover.boundary, p->branch[k].rect.boundary,
+			    sizeof(cover.boundary)))
+			break; /**< 위쪽의 사각형은 바뀌지 않습니다. */
+		RTreeSetBranchRect(p, k, &cover);
+		RTreeUpdateAggregate(p, k);
+	}
+	return 1;
+}
+
+/**
+ * @brief 데이터를 새로운 사각형으로 옮깁니다.
+ *
+ * @details id로 leaf를 바로 찾아서 제자리에서 옮길 수 있으면 leaf와 조상들의
+ * 사각형만 고칩니다. leaf의 사각형을 RTreeSetUpdateSlack의 허용 범위보다
+ * 더 늘려야 하는 경우나 Hilbert R-tree인 경우에는 지운 후에 루트부터
+ * 다시 삽입합니다.
+ *
+ * @param T 트리에 해당합니다.
+ * @param Tid 레코드의 id에 해당합니다.
+ * @param Old 데이터의 지금 사각형
+ * @param New 데이터의 새로운 사각형
+ *
+ * @return 옮긴 경우 0, 레코드를 못 찾은 경우 1, 다시 삽입할 때
+ * 메모리가 부족한 경우 -1을 반환합니다.
+ * @note RTREE_CONCURRENT로 빌드한 경우에는 항상 Old로 지운 후에 다시
+ * 삽입하며, 횟수를 세지 않습니다.
+ */
+int RTreeUpdateRect(struct RTree *T, tid_t Tid, struct Rect *Old,
+		    struct Rect *New)
+{
+	register struct RTree *t = T;
+	register tid_t tid = Tid;
+	register struct Rect *r = New;
+	register struct Node *n;
+	register int i;
+
+	assert(t && Old && r && t->root);
+
+#ifdef RTREE_CONCURRENT
+	if (RTreeDeleteRect(t, Old, tid))
+		return 1;
+	return RTreeInsertRect(t, r, tid, 0) < 0 ? -1 : 0;
+#endif
+	if (tid >= t->nleafref || !t->leafref[tid].leaf)
+		return 1;
+	n = t->leafref[tid].leaf;
+	i = t->leafref[tid].slot;
+	assert(n->level == 0 && RTreeLeafId(n, i) == tid);
+	t->ustats.updates++;
+	if (RTreeUpdateInPlace(t, n, i, r))
+		return 0;
+	t->ustats.reinserted++;
+	RTreeDeleteId(t, tid);
+	return RTreeInsertRect(t, r, tid, 0) < 0 ? -1 : 0;
+}
+
+/**
+ * @brief RTreeUpdateRect가 데이터를 옮긴 방법별 횟수를 가져옵니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param s 통계가 들어갑니다.
+ */
+void RTreeGetUpdateStats(struct RTree *t, struct RTreeUpdateStats *s)
+{
+	assert(t && s);
+	*s = t->ustats;
+}
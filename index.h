@@ -2,6 +2,8 @@
 #define _INDEX_
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #define PGSIZE 4096
 #define NUMDIMS 2 /* 차원의 수 */
@@ -13,7 +15,23 @@
 typedef size_t tid_t;
 #endif
 
+/**
+ * @brief 좌표, 거리의 제곱, 부피의 타입입니다.
+ *
+ * @details RTREE_INTCOORD로 빌드하면 좌표는 int32_t, 거리의 제곱은 int64_t로
+ * 계산하므로 겹침과 거리의 비교가 오차 없이 정확합니다. 부피와 둘레는
+ * 분할의 기준으로만 쓰이므로 넘치지 않도록 항상 double로 계산합니다.
+ */
+#ifdef RTREE_INTCOORD
+typedef int32_t RectReal;
+typedef int64_t RectDist;
+#define RECTREAL_MAX INT32_MAX
+#else
 typedef double RectReal;
+typedef double RectDist;
+#define RECTREAL_MAX DBL_MAX
+#endif
+typedef double RectArea;
 
 #ifndef TRUE
 #define TRUE 1
@@ -36,15 +54,131 @@ struct Branch {
 	struct Node *child;
 };
 
+#ifdef RTREE_POINTLEAF
+/**
+ * @brief RTREE_POINTLEAF로 빌드한 경우에 leaf 노드가 가지는 점 하나입니다.
+ */
+struct PointEntry {
+	RectReal p[NUMDIMS];
+	tid_t id;
+};
+
+#if defined(RTREE_SOA) || defined(RTREE_HILBERT) || defined(RTREE_CONCURRENT)
+#error "RTREE_POINTLEAF cannot be combined with SOA, HILBERT or CONCURRENT"
+#endif
+#endif
+
+/**
+ * @brief 노드에서 브랜치를 제외한 부분의 크기입니다.
+ *
+ * @details 노드마다 부모 포인터를 두고, RTREE_CONCURRENT로 빌드하면 버전과
+ * 오른쪽 링크도 둡니다.
+ */
+#ifdef RTREE_CONCURRENT
+#define NODEHDR                                                                \
+	(2 * sizeof(int) + 3 * sizeof(uint64_t) + 2 * sizeof(struct Node *))
+#else
+#define NODEHDR (2 * sizeof(int) + sizeof(struct Node *))
+#endif
+
 /**
  * @brief 노드가 할 수 있는 최대 브랜칭의 수입니다.
+ *
+ * @details 브랜치마다 서브트리의 데이터 수와 사각형의 부피를 함께 저장하므로
+ * 그만큼 브랜칭 수가 줄어들게 됩니다. RTREE_HILBERT로 빌드하면 서브트리의 가장 큰 Hilbert 값도
+ * 함께 저장합니다. RTREE_SOA로 빌드하면 각 브랜치의 경계값이 차원별 배열에
+ * 한 번 더 저장되므로 브랜칭 수가 더 줄어들게 됩니다.
+ * 이때, SIMD로 4개씩 검사할 수 있도록 4의 배수로 맞추고, 겹침 마스크가
+ * 64비트이므로 64를 넘지 않도록 합니다. (RTREE_INTCOORD)
+ */
+#ifdef RTREE_HILBERT
+#define BRANCHAGG (sizeof(RectArea) + sizeof(uint32_t) + sizeof(uint64_t))
+#else
+#define BRANCHAGG (sizeof(RectArea) + sizeof(uint32_t))
+#endif
+#ifdef RTREE_SOA
+#define SOACARD                                                                \
+	(((PGSIZE - NODEHDR) / (sizeof(struct Branch) + BRANCHAGG +            \
+				NUMSIDES * sizeof(RectReal))) &                \
+	 ~3)
+#define MAXCARD (int)(SOACARD > 64 ? 64 : SOACARD)
+#else
+#define MAXCARD (int)((PGSIZE - NODEHDR) / (sizeof(struct Branch) + BRANCHAGG))
+#endif
+
+/**
+ * @brief leaf 노드가 할 수 있는 최대 데이터의 수입니다.
+ *
+ * @details RTREE_POINTLEAF로 빌드하면 leaf 노드는 사각형 대신 점과 id만
+ * 가지므로 내장 노드보다 더 많은 데이터를 가질 수 있습니다.
  */
-#define MAXCARD (int)((PGSIZE - (2 * sizeof(int))) / sizeof(struct Branch))
+#ifdef RTREE_POINTLEAF
+#define LEAFMAXCARD (int)((PGSIZE - NODEHDR) / sizeof(struct PointEntry))
+#else
+#define LEAFMAXCARD MAXCARD
+#endif
+
+/**
+ * @brief 내장 노드와 leaf 노드 중 더 큰 최대 브랜칭의 수입니다.
+ */
+#define ANYMAXCARD (LEAFMAXCARD > MAXCARD ? LEAFMAXCARD : MAXCARD)
 
 struct Node {
 	int count;
 	int level; /* 0 is leaf, others positive */
-	struct Branch branch[MAXCARD];
+	struct Node *parent; /* 루트는 NULL */
+#ifdef RTREE_CONCURRENT
+	/**
+	 * @brief R-link 트리를 위한 필드들입니다.
+	 *
+	 * @details version은 노드를 고치는 동안 홀수가 되는 seqlock이며,
+	 * 노드가 분할되면 right는 새로 생긴 오른쪽 노드를, nsn은 분할 시점의
+	 * 트리 카운터 값을 가집니다. lsn은 이 노드에 마지막으로 자식을 추가한
+	 * 시점의 카운터 값입니다.
+	 */
+	uint64_t version;
+	uint64_t nsn;
+	uint64_t lsn;
+	struct Node *right;
+#endif
+#ifdef RTREE_POINTLEAF
+	union {
+		struct {
+#endif
+	struct Branch branch[MAXCARD]; /* [0, count)에만 빈틈 없이 채워집니다 */
+	/**
+	 * @brief 트리의 부피 척도로 구한 branch[i]의 사각형의 부피입니다.
+	 *
+	 * @details 사각형이 바뀌면 음수로 지워지고, RTreePickBranch에서 필요할 때
+	 * 다시 구합니다. 따라서 바뀌지 않은 브랜치의 부피는 한 번만 구합니다.
+	 */
+	RectArea vol[MAXCARD];
+	/**
+	 * @brief branch[i] 아래에 있는 tombstone이 아닌 데이터의 수입니다.
+	 * (leaf 노드에서는 1 또는 tombstone인 경우 0이며,
+	 * RTREE_POINTLEAF에서는 두지 않습니다.)
+	 */
+	uint32_t subcount[MAXCARD];
+#ifdef RTREE_POINTLEAF
+		};
+		struct PointEntry point[LEAFMAXCARD]; /* leaf 노드의 데이터 */
+	};
+#endif
+#ifdef RTREE_HILBERT
+	/**
+	 * @brief branch[i] 아래에 있는 데이터 중에서 가장 큰 Hilbert 값입니다.
+	 * (leaf 노드에서는 데이터의 Hilbert 값입니다.)
+	 */
+	uint64_t lhv[MAXCARD];
+#endif
+#ifdef RTREE_SOA
+	/**
+	 * @brief branch[i].rect의 경계값을 차원별로 모아둔 배열입니다.
+	 * (bound[0]은 xmin들, bound[1]은 ymin들, ...)
+	 * 비어있는 브랜치는 어떤 사각형과도 겹치지 않는 값을 가집니다.
+	 */
+	RectReal bound[NUMSIDES][MAXCARD];
+#endif
 };
 
 struct ListNode {
@@ -52,33 +186,448 @@ struct ListNode {
 	struct Node *node;
 };
 
+/**
+ * @brief 데이터가 들어있는 leaf 노드와 브랜치 번호입니다.
+ *
+ * @details 트리는 id를 인덱스로 하는 표로 가지고 있으며, RTreeAddBranch와
+ * RTreeDisconnectBranch가 leaf의 브랜치를 옮길 때마다 갱신합니다.
+ */
+struct RTreeLeafRef {
+	struct Node *leaf; /* 트리에 없는 id는 NULL */
+	int slot;
+};
+
+/**
+ * @brief 브랜치를 고르고 분할할 때 사각형의 크기를 재는 척도입니다.
+ *
+ * @details Guttman의 방법(linear, quadratic)과 Ang-Tan의 브랜치 선택에서
+ * 사용합니다. R*-tree와 Hilbert R-tree는 자신의 기준을 그대로 사용합니다.
+ */
+enum RTreeAreaMetric {
+	RTREE_SPHERE_VOLUME = 0, /* 외접하는 구의 부피 (기본값) */
+	RTREE_BOX_VOLUME, /* 사각형의 부피 */
+	RTREE_SURFACE_AREA, /* 사각형의 겉넓이 */
+	RTREE_FAST_SPHERE_VOLUME, /* 가장 긴 변을 지름으로 하는 구의 부피 */
+};
+#define METRICS 4
+
+/**
+ * @brief 삭제에 든 비용을 모아둔 통계입니다.
+ *
+ * @details lazy 삭제에서는 재삽입과 노드 방문이 여러 삭제에 한 번씩 몰아서
+ * 일어나므로 deletes로 나눈 값이 삭제 하나에 분할 상환된 비용이 됩니다.
+ */
+struct RTreeDeleteStats {
+	long deletes; /* 지운 데이터의 수 */
+	long reinserted; /* 모자란 노드를 정리하면서 재삽입한 브랜치의 수 */
+	long leaf_purges; /* leaf 하나의 tombstone들을 정리한 횟수 */
+	long tree_purges; /* 트리 전체의 tombstone들을 정리한 횟수 */
+	long purged; /* 정리한 tombstone의 수 */
+	long visited; /* 트리 전체를 정리하면서 방문한 노드의 수 */
+	long repacked; /* RTREE_CONCURRENT에서 트리를 다시 채운 횟수 */
+};
+
+/**
+ * @brief RTreeUpdateRect가 데이터를 옮긴 방법별 횟수입니다.
+ */
+struct RTreeUpdateStats {
+	long updates; /* 옮긴 데이터의 수 */
+	long inplace; /* leaf의 사각형 안에서 옮긴 수 */
+	long enlarged; /* leaf의 사각형을 허용 범위 안에서 늘려서 옮긴 수 */
+	long reinserted; /* 지운 후에 다시 삽입한 수 */
+};
+
+/**
+ * @brief RTreeUpdateRect가 leaf의 사각형을 늘려도 되는 둘레의 기본 비율(%)입니다.
+ */
+#define RTREE_UPDATE_SLACK_PCT 10
+
+/**
+ * @brief lazy 삭제에서 tombstone을 정리하는 기본 비율(%)입니다.
+ */
+#define RTREE_LAZY_NODE_PCT 50 /* leaf 안의 tombstone 비율 */
+#define RTREE_LAZY_TREE_PCT 25 /* 트리 전체의 tombstone 비율 */
+
+/**
+ * @brief RTREE_CONCURRENT에서 살아있는 데이터가 leaf 용량의 이 비율(%)보다
+ * 적어지면 트리를 다시 채웁니다.
+ */
+#define RTREE_REPACK_PCT 25
+
+/**
+ * @brief LSM 방식의 forest(forest.c)가 가질 수 있는 level의 수와
+ * 버퍼를 얼리는 기본 데이터 수입니다.
+ */
+#define RTREE_FOREST_LEVELS 32
+#define RTREE_FOREST_BUFFER 4096
+
+/**
+ * @brief forest에 든 비용과 forest의 모양입니다.
+ */
+struct RTreeForestStats {
+	long inserts; /* 넣은 데이터의 수 */
+	long deletes; /* 지운 데이터의 수 */
+	long tombstones; /* level의 트리에 남긴 tombstone의 수 */
+	long merges; /* 병합한 횟수 */
+	long merged; /* 병합하면서 다시 쓴 데이터의 수 */
+	long dropped; /* 병합하면서 버린 tombstone의 수 */
+	long stalls; /* 버퍼를 얼리려고 이전 병합을 기다린 횟수 */
+	int trees; /* 지금 탐색하는 트리의 수 */
+};
+
+struct RTreeForest;
+
+/**
+ * @brief write-ahead log(wal.c)의 버퍼 크기(bytes)와 group commit 간격(us)
+ * 입니다.
+ *
+ * @details 간격 안에 들어온 갱신들은 fsync 한 번으로 함께 디스크에 씁니다.
+ */
+#define RTREE_WAL_BUFFER (1 << 20)
+#define RTREE_WAL_INTERVAL 2000
+
+/**
+ * @brief write-ahead log에 든 비용입니다.
+ */
+struct RTreeWalStats {
+	long appends; /* 로그에 쓴 갱신의 수 */
+	long commits; /* 로그를 fsync 한 횟수 */
+	long stalls; /* 버퍼가 가득 차서 기다린 횟수 */
+	long checkpoints; /* 끝낸 checkpoint의 수 */
+	long skipped; /* 이전 checkpoint가 끝나지 않아서 건너뛴 횟수 */
+	long failed; /* 만들지 못한 checkpoint의 수 */
+	long recovered; /* 복구할 때 checkpoint에서 읽은 데이터의 수 */
+	long replayed; /* 복구할 때 로그에서 다시 적용한 갱신의 수 */
+};
+
+struct RTreeWal;
+
+/**
+ * @brief 커서가 내려갈 수 있는 트리의 최대 높이입니다.
+ */
+#define RTREE_MAX_DEPTH 32
+
+#include "pool.h"
+#include "split_l.h"
+#ifdef RTREE_CONCURRENT
+#include <pthread.h>
+#endif
+
+/**
+ * @brief R-Tree 하나에 해당합니다.
+ *
+ * @details 루트와 노드의 최대 브랜칭 수, 분할에 사용하는 작업 공간,
+ * 노드를 할당하는 풀을 모두 트리가 가지고 있으므로 서로 다른 트리는
+ * 서로 다른 스레드에서 동시에 사용할 수 있습니다.
+ */
+struct RTree {
+	struct Node *root;
+	int nodecard; /* 내장 노드의 최대 브랜칭 수 */
+	int leafcard; /* leaf 노드의 최대 브랜칭 수 */
+	struct RTreePool node_pool; /* 노드를 할당하는 풀 */
+	struct RTreePool list_pool; /* 재삽입 리스트의 노드를 할당하는 풀 */
+	int method; /* 삽입과 분할의 방법 (enum RTreeSplitMethod) */
+	int metric; /* 브랜치를 고르고 분할할 때의 부피 척도 (enum RTreeAreaMetric) */
+	struct RTreeLeafRef *leafref; /* id가 인덱스인 데이터의 위치 */
+	size_t nleafref; /* leafref의 크기 */
+	int lazy_node; /* leaf를 정리하는 tombstone 비율(%), 0이면 보지 않음 */
+	int lazy_tree; /* 트리 전체를 정리하는 tombstone 비율(%), 0이면 보지 않음 */
+	long ndead; /* 트리에 남아있는 tombstone의 수 */
+	struct RTreeDeleteStats dstats; /* 삭제에 든 비용 */
+	int update_slack; /* 옮길 때 leaf의 둘레를 늘려도 되는 비율(%) */
+	struct RTreeUpdateStats ustats; /* 옮긴 방법별 횟수 */
+	struct SplitVars split; /* 분할에 사용하는 작업 공간 */
+	void *map; /* RTreeOpen으로 매핑한 파일, 없으면 NULL */
+	size_t map_size; /* 매핑한 파일의 크기 */
+#ifdef RTREE_CONCURRENT
+	pthread_rwlock_t lock; /* 쓰기는 공유로, 트리를 통째로 바꿀 때는 독점 */
+	pthread_mutex_t split_lock; /* 분할을 직렬화 합니다 */
+	uint64_t nsn; /* 분할마다 증가하는 카운터 */
+	uint64_t epoch; /* 루트를 바꿔서 노드를 돌려줄 때마다 증가합니다 */
+	long readers[2]; /* epoch의 홀짝별로 탐색 중인 스레드의 수 */
+#endif
+};
+
 /**
  * @brief 탐색 시에 호출되는 callback 함수의 원형에 해당한다.
  */
 typedef int (*SearchHitCallback)(int id, void *arg);
 
-extern int RTreeSearch(struct Node *, struct Rect *, SearchHitCallback, void *);
-extern int RTreeInsertRect(struct Rect *, tid_t, struct Node **, int depth);
-extern int RTreeDeleteRect(struct Rect *, tid_t, struct Node **);
-extern struct Node *RTreeNewIndex();
-extern struct Node *RTreeNewNode();
+/**
+ * @brief 커서의 스택에서 노드 하나에 해당합니다.
+ */
+struct RTreeCursorFrame {
+	struct Node *node;
+#ifdef RTREE_SOA
+	uint64_t mask; /* 아직 보지 않은 겹치는 브랜치들 */
+#else
+	int i; /* 다음에 볼 브랜치 번호 */
+#endif
+};
+
+/**
+ * @brief 탐색 결과를 하나씩 꺼내오기 위한 커서입니다.
+ */
+struct RTreeCursor {
+	struct Rect rect; /* 탐색 범위 */
+	int depth; /* 스택의 top, -1이면 탐색이 끝난 상태 */
+	struct RTreeCursorFrame stack[RTREE_MAX_DEPTH];
+};
+
+/**
+ * @brief 원 탐색의 입력에 해당합니다.
+ *
+ * @details 중심까지의 거리의 제곱 d2가 d2 - r * r < eps를 만족하는 점을
+ * 원 안의 점으로 봅니다.
+ */
+struct RTreeCircle {
+	RectReal cx, cy; /* 원의 중심 */
+	RectReal r; /* 원의 반지름 */
+	RectDist eps; /* 경계와 거리 비교에서 같다고 보는 오차 */
+};
+
+/**
+ * @brief 최근접 탐색의 우선순위 큐에 들어가는 브랜치 하나입니다.
+ */
+struct RTreeNearestEntry {
+	RectDist d2; /* 기준점에서 브랜치 사각형까지의 MINDIST의 제곱 */
+	struct Node *child; /* 브랜치의 자식, level이 0이면 데이터의 id */
+	int level; /* 브랜치가 들어있는 노드의 level, 0이면 데이터 */
+};
+
+/**
+ * @brief 기준점에서 가까운 데이터부터 하나씩 꺼내오기 위한 커서입니다.
+ */
+struct RTreeNearestCursor {
+	RectReal point[NUMDIMS]; /* 기준점 */
+	struct RTreeNearestEntry *heap; /* d2에 대한 min-heap */
+	int size, cap;
+};
+
+extern int RTreeSearch(struct RTree *, struct Rect *, SearchHitCallback,
+		       void *);
+extern int RTreeNearestOpen(struct RTreeNearestCursor *, struct RTree *,
+			    RectReal *);
+extern int RTreeNearestNext(struct RTreeNearestCursor *, tid_t *,
+			    RectDist *);
+extern void RTreeNearestClose(struct RTreeNearestCursor *);
+extern int RTreeNearest(struct RTree *, RectReal *, int, tid_t *,
+			RectDist *);
+extern long RTreeCircleCount(struct RTree *, struct RTreeCircle *);
+extern int RTreeCircleFarthest(struct RTree *, struct RTreeCircle *, tid_t *,
+			       RectDist *);
+extern void RTreeCursorOpen(struct RTreeCursor *, struct RTree *,
+			    struct Rect *);
+extern int RTreeCursorNext(struct RTreeCursor *, tid_t *, struct Rect *);
+extern void RTreeCursorClose(struct RTreeCursor *);
+extern int RTreeInsertRect(struct RTree *, struct Rect *, tid_t, int depth);
+extern int RTreeDeleteRect(struct RTree *, struct Rect *, tid_t);
+extern int RTreeDeleteId(struct RTree *, tid_t);
+extern void RTreePurge(struct RTree *);
+extern void RTreeGetDeleteStats(struct RTree *, struct RTreeDeleteStats *);
+extern int RTreeUpdateRect(struct RTree *, tid_t, struct Rect *,
+			   struct Rect *);
+extern void RTreeGetUpdateStats(struct RTree *, struct RTreeUpdateStats *);
+extern struct RTreeForest *RTreeNewForest(long);
+extern void RTreeFreeForest(struct RTreeForest *);
+extern int RTreeForestInsert(struct RTreeForest *, struct Rect *, tid_t);
+extern int RTreeForestDelete(struct RTreeForest *, tid_t);
+extern int RTreeForestSearch(struct RTreeForest *, struct Rect *,
+			     SearchHitCallback, void *);
+extern long RTreeForestCircleCount(struct RTreeForest *, struct RTreeCircle *);
+extern int RTreeForestCircleFarthest(struct RTreeForest *, struct RTreeCircle *,
+				     tid_t *, RectDist *);
+extern int RTreeForestNearest(struct RTreeForest *, RectReal *, int, tid_t *,
+			      RectDist *);
+extern int RTreeForestSync(struct RTreeForest *);
+extern void RTreeGetForestStats(struct RTreeForest *,
+				struct RTreeForestStats *);
+extern struct RTree *RTreeNewIndex();
+extern void RTreeFreeIndex(struct RTree *);
+extern int RTreeBulkLoad(struct RTree *, struct Rect *, tid_t *, int);
+extern struct Node *RTreeRepack(struct RTree *);
+extern void RTreeFreeSubtree(struct RTree *, struct Node *);
+extern int RTreeInsertBatch(struct RTree *, struct Rect *, tid_t *, int);
+extern int RTreeSave(struct RTree *, const char *);
+extern struct RTree *RTreeOpen(const char *);
+extern struct RTreeWal *RTreeWalOpen(const char *, struct RTree *);
+extern int RTreeWalClose(struct RTreeWal *);
+extern int RTreeWalInsert(struct RTreeWal *, struct Rect *, tid_t);
+extern int RTreeWalDelete(struct RTreeWal *, tid_t);
+extern int RTreeWalSync(struct RTreeWal *);
+extern int RTreeWalCheckpoint(struct RTreeWal *, struct RTree *);
+extern void RTreeGetWalStats(struct RTreeWal *, struct RTreeWalStats *);
+extern struct Node *RTreeNewNode(struct RTree *);
 extern void RTreeInitNode(struct Node *);
-extern void RTreeFreeNode(struct Node *);
+extern void RTreeFreeNode(struct RTree *, struct Node *);
+extern int RTreeReserveNodes(struct RTree *, long);
+extern long RTreeInsertNodes(struct RTree *, int);
+extern int RTreeReserveInsert(struct RTree *);
+extern void RTreeSetHugePage(struct RTree *, int);
+extern void RTreeMemoryStats(struct RTree *, size_t *, size_t *);
 extern void RTreeTabIn(int);
 extern struct Rect RTreeNodeCover(struct Node *);
+extern long RTreeNodeTotal(struct Node *);
+extern uint32_t RTreeBuildFlags(void);
+extern int RTreeSyncDir(const char *);
+extern void RTreeUpdateAggregate(struct Node *, int);
 extern void RTreeInitRect(struct Rect *);
-extern RectReal RTreeRectArea(struct Rect *);
-extern RectReal RTreeRectSphericalVolume(struct Rect *R);
+extern RectArea RTreeRectArea(struct Rect *);
+extern RectArea RTreeRectMargin(struct Rect *);
+extern RectArea RTreeOverlapArea(struct Rect *, struct Rect *);
+extern RectArea RTreeRectSphericalVolume(struct Rect *R);
+extern RectArea RTreeRectSurfaceArea(struct Rect *);
+extern RectArea RTreeRectFastSphericalVolume(struct Rect *);
+extern RectArea (*const RTreeMetrics[METRICS])(struct Rect *);
+
+/**
+ * @brief 트리에 설정된 척도로 사각형의 부피를 구합니다.
+ */
+#define RTreeVolume(t, r) (RTreeMetrics[(t)->metric](r))
 extern struct Rect RTreeCombineRect(struct Rect *, struct Rect *);
 extern int RTreeOverlap(struct Rect *, struct Rect *);
-extern int RTreeAddBranch(struct Branch *, struct Node *, struct Node **);
-extern int RTreePickBranch(struct Rect *, struct Node *);
-extern void RTreeDisconnectBranch(struct Node *, int);
-extern void RTreeSplitNode(struct Node *, struct Branch *, struct Node **);
-
-extern int RTreeSetNodeMax(int);
-extern int RTreeSetLeafMax(int);
-extern int RTreeGetNodeMax();
-extern int RTreeGetLeafMax();
+extern int RTreeContained(struct Rect *, struct Rect *);
+extern RectDist RTreeMinDist2(struct Rect *, RectReal *);
+extern RectDist RTreeMaxDist2(struct Rect *, RectReal *);
+#ifdef RTREE_SOA
+extern uint64_t RTreeOverlapMask(struct Node *, struct Rect *, int);
+#endif
+extern void RTreeSetBranchRect(struct Node *, int, struct Rect *);
+extern int RTreeAddBranch(struct RTree *, struct Branch *, struct Node *,
+			  struct Node **);
+extern int RTreePickBranch(struct RTree *, struct Rect *, struct Node *);
+extern void RTreeDisconnectBranch(struct RTree *, struct Node *, int);
+extern int RTreeReserveId(struct RTree *, tid_t);
+extern void RTreeSplitNode(struct RTree *, struct Node *, struct Branch *,
+			   struct Node **);
+extern int RTreeReinsertOverflow(struct RTree *, struct Node *,
+				 struct Branch *);
+
+extern int RTreeSetNodeMax(struct RTree *, int);
+extern int RTreeSetLeafMax(struct RTree *, int);
+extern int RTreeGetNodeMax(struct RTree *);
+extern int RTreeGetLeafMax(struct RTree *);
+extern int RTreeSetSplitMethod(struct RTree *, int);
+extern int RTreeGetSplitMethod(struct RTree *);
+extern int RTreeSetAreaMetric(struct RTree *, int);
+extern int RTreeGetAreaMetric(struct RTree *);
+extern int RTreeSetLazyDelete(struct RTree *, int, int);
+extern int RTreeSetUpdateSlack(struct RTree *, int);
+
+extern uint64_t RTreeHilbertKey(struct Rect *);
+#ifdef RTREE_HILBERT
+extern uint64_t RTreeNodeLhv(struct Node *);
+extern int RTreeHilbertPick(struct Node *, uint64_t);
+extern int RTreeHilbertInsert(struct RTree *, struct Rect *, tid_t, int);
+#endif
+
+#ifdef RTREE_CONCURRENT
+extern int RTreeLatchedSearch(struct RTree *, struct Rect *, SearchHitCallback,
+			      void *);
+extern int RTreeLatchedInsert(struct RTree *, struct Rect *, tid_t, int);
+extern int RTreeLatchedDelete(struct RTree *, struct Rect *, tid_t);
+#endif
+
+/**
+ * @brief leaf 노드의 i번째 데이터의 id를 반환합니다.
+ *
+ * @details RTREE_POINTLEAF로 빌드하면 leaf 노드는 브랜치 대신 점을 가지므로
+ * leaf의 데이터는 이 함수들로 읽도록 합니다.
+ */
+static inline tid_t RTreeLeafId(struct Node *n, int i)
+{
+#ifdef RTREE_POINTLEAF
+	return n->point[i].id;
+#else
+	return (tid_t)n->branch[i].child;
+#endif
+}
+
+/**
+ * @brief leaf 노드의 i번째 데이터가 tombstone이 아닌 지를 확인합니다.
+ *
+ * @details lazy 삭제는 데이터를 바로 빼지 않고 사각형의 is_use를 false로
+ * 바꿔두므로, 탐색은 leaf에서 이 함수로 지워진 데이터를 걸러냅니다.
+ */
+static inline int RTreeLeafLive(struct Node *n, int i)
+{
+#ifdef RTREE_POINTLEAF
+	(void)n;
+	(void)i;
+	return TRUE;
+#else
+	return n->branch[i].rect.is_use;
+#endif
+}
+
+/**
+ * @brief leaf 노드의 level과 데이터 수가 올바른 지를 확인합니다.
+ *
+ * @details RTreeOpen은 leaf 페이지를 미리 읽지 않으므로, 탐색은 level이 1인
+ * 노드의 자식을 처음 읽을 때 이 함수로 확인하고 잘못된 leaf는 건너뜁니다.
+ * 메모리에서 만든 트리의 leaf는 항상 올바릅니다.
+ */
+static inline int RTreeLeafValid(struct Node *n)
+{
+	return n->level == 0 && n->count >= 0 && n->count <= LEAFMAXCARD;
+}
+
+/**
+ * @brief 노드의 i번째 브랜치가 사각형과 겹치는 지를 확인합니다.
+ */
+static inline int RTreeEntryOverlap(struct Node *n, int i, struct Rect *r)
+{
+#ifdef RTREE_POINTLEAF
+	register int j;
+	if (n->level > 0)
+		return RTreeOverlap(r, &n->branch[i].rect);
+	for (j = 0; j < NUMDIMS; j++)
+		if (n->point[i].p[j] < r->boundary[j] ||
+		    n->point[i].p[j] > r->boundary[j + NUMDIMS])
+			return FALSE;
+	return TRUE;
+#else
+	return RTreeOverlap(r, &n->branch[i].rect);
+#endif
+}
+
+/**
+ * @brief 노드의 i번째 브랜치의 사각형을 가리키는 포인터를 반환합니다.
+ *
+ * @details leaf 노드의 점은 tmp에 크기가 0인 사각형으로 만들어서 반환합니다.
+ */
+static inline struct Rect *RTreeEntryRect(struct Node *n, int i,
+					  struct Rect *tmp)
+{
+#ifdef RTREE_POINTLEAF
+	register int j;
+	if (n->level == 0) {
+		tmp->is_use = true;
+		for (j = 0; j < NUMDIMS; j++)
+			tmp->boundary[j] = tmp->boundary[j + NUMDIMS] =
+				n->point[i].p[j];
+		return tmp;
+	}
+#endif
+	(void)tmp;
+	return &n->branch[i].rect;
+}
+
+/**
+ * @brief 노드의 i번째 브랜치를 가져옵니다.
+ *
+ * @details leaf 노드의 점은 크기가 0인 사각형과 id를 가진 브랜치로 만듭니다.
+ */
+static inline void RTreeGetBranch(struct Node *n, int i, struct Branch *b)
+{
+#ifdef RTREE_POINTLEAF
+	if (n->level == 0) {
+		RTreeEntryRect(n, i, &b->rect);
+		b->child = (struct Node *)n->point[i].id;
+		return;
+	}
+#endif
+	*b = n->branch[i];
+}
 
 #endif /* _INDEX_ */
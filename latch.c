@@ -0,0 +1,577 @@
+#include "index.h"
+#include "assert.h"
+#include "card.h"
+#include <sched.h>
+
+/**
+ * @file latch.c
+ * @brief RTREE_CONCURRENT로 빌드한 경우에 사용하는 R-link 방식의 동시성 제어입니다.
+ *
+ * @details 탐색은 잠금 없이 진행하고, 삽입과 삭제는 고치는 노드만 잠급니다.
+ * 노드의 버전(seqlock)을 홀수로 만드는 것이 곧 노드의 잠금이므로, 탐색은
+ * 잠긴 노드를 고치는 중인 노드로 보고 풀릴 때까지 기다립니다.
+ *
+ * - 탐색은 노드를 읽기 전과 후의 버전이 같을 때만 읽은 내용을 사용합니다.
+ * - 쓰기는 잠금 없이 내려가서 고칠 노드를 잠근 후에, 부모를 잠그고 나서
+ *   자식을 풀어주면서(latch coupling) 루트까지 브랜치의 사각형과 집계를
+ *   고칩니다. 잠금은 항상 아래에서 위로, 같은 level에서는 왼쪽에서
+ *   오른쪽으로 잡으므로 쓰기끼리 교착 상태가 생기지 않습니다.
+ * - 분할은 작업 공간(t->split)과 노드 할당을 함께 쓰므로 트리의
+ *   split_lock으로 한 번에 하나씩만 진행합니다. 분할하지 않는 삽입과
+ *   삭제는 분할과 동시에 진행합니다.
+ * - 노드가 분할되면 원래 노드는 새로운 노드를 오른쪽 링크로 가리키고,
+ *   분할 시점의 카운터 값을 nsn에 기록합니다. 부모를 읽은 시점(부모의 lsn)
+ *   보다 nsn이 크면 부모에 아직 새로운 노드가 없으므로 오른쪽 링크를
+ *   따라갑니다. (Lehman-Yao, Kornacker-Banks)
+ * - 데이터가 다른 노드로 옮겨지는 경우는 분할뿐이어야 하므로 삭제는
+ *   노드를 합치거나 재삽입하지 않습니다.
+ * - 대신 트리가 너무 비게 되면 새로운 노드들에 트리를 다시 채워서 루트를
+ *   바꾸고, 기존 노드들은 그 트리를 읽던 탐색이 모두 끝난 후에
+ *   돌려줍니다. (quiescent-state reclamation)
+ * - 쓰기는 트리의 lock을 공유로 잡고, 트리를 다시 채우거나 id 표를 늘리는
+ *   경우에만 독점으로 잡아서 다른 쓰기가 잡고 있는 노드를 바꾸지 않습니다.
+ */
+#ifdef RTREE_CONCURRENT
+
+_Static_assert(sizeof(struct Node) <= PGSIZE, "NODEHDR is out of date");
+
+/**
+ * @brief 노드를 읽기 시작합니다. 고치는 중인 경우에는 끝날 때까지 기다립니다.
+ *
+ * @return 읽기 시작한 시점의 버전
+ */
+static inline uint64_t RTreeReadBegin(struct Node *n)
+{
+	uint64_t v;
+
+	while ((v = __atomic_load_n(&n->version, __ATOMIC_ACQUIRE)) & 1)
+		;
+	return v;
+}
+
+/**
+ * @brief 읽는 동안 노드가 바뀌었는 지를 확인합니다.
+ *
+ * @return 다시 읽어야 하는 경우 1, 읽은 내용을 사용할 수 있는 경우 0
+ */
+static inline int RTreeReadRetry(struct Node *n, uint64_t v)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&n->version, __ATOMIC_RELAXED) != v;
+}
+
+/**
+ * @brief 노드를 잠그고 고치기 시작합니다. 다른 쓰기가 잠근 경우에는 풀릴
+ * 때까지 기다립니다.
+ */
+static inline void RTreeWriteBegin(struct Node *n)
+{
+	uint64_t v;
+
+	for (;;) {
+		v = __atomic_load_n(&n->version, __ATOMIC_RELAXED);
+		if (!(v & 1) &&
+		    __atomic_compare_exchange_n(&n->version, &v, v + 1, false,
+						__ATOMIC_ACQUIRE,
+						__ATOMIC_RELAXED))
+			break;
+		sched_yield();
+	}
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * @brief 노드를 다 고쳤음을 알리고 잠금을 풉니다.
+ */
+static inline void RTreeWriteEnd(struct Node *n)
+{
+	__atomic_store_n(&n->version, n->version + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief 탐색을 시작하면서 지금의 epoch에 탐색 중임을 알립니다.
+ *
+ * @details 알린 후에 epoch가 바뀌었으면 루트를 바꾼 쪽이 보지 못했을 수
+ * 있으므로 새로운 epoch에 다시 알립니다.
+ *
+ * @return 알린 epoch
+ */
+static uint64_t RTreeReadEnter(struct RTree *t)
+{
+	uint64_t e = __atomic_load_n(&t->epoch, __ATOMIC_SEQ_CST);
+
+	for (;;) {
+		__atomic_fetch_add(&t->readers[e & 1], 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&t->epoch, __ATOMIC_SEQ_CST) == e)
+			return e;
+		__atomic_fetch_sub(&t->readers[e & 1], 1, __ATOMIC_RELEASE);
+		e = __atomic_load_n(&t->epoch, __ATOMIC_SEQ_CST);
+	}
+}
+
+/**
+ * @brief 탐색이 끝났음을 알립니다.
+ */
+static inline void RTreeReadExit(struct RTree *t, uint64_t e)
+{
+	__atomic_fetch_sub(&t->readers[e & 1], 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief 탐색 스택에서 노드 하나에 해당합니다.
+ */
+struct RTreeLatchedFrame {
+	struct Node *node;
+	uint64_t parent_lsn; /* 이 노드를 가리키던 부모를 읽은 시점 */
+	int level; /* 이 노드가 있어야 할 level, 루트는 -1 */
+};
+
+/**
+ * @brief 잠금 없이 사각형에 겹쳐지는 모든 사각형을 찾습니다.
+ *
+ * @details 스택의 각 level에는 최대 MAXCARD개의 자식과 오른쪽 링크 하나가
+ * 쌓이므로 스택의 크기는 RTREE_MAX_DEPTH * (MAXCARD + 1)로 충분합니다.
+ * 루트는 부모가 없으므로 parent_lsn을 0으로 두어서 루트를 읽은 후에
+ * 루트가 분할되었더라도 오른쪽 링크를 모두 따라가도록 합니다.
+ * 읽는 동안 루트가 다시 채워지더라도 읽던 노드들은 탐색이 끝날 때까지
+ * 해제되지 않습니다. 있어야 할 level과 다른 노드는 RTreeOpen으로 연 파일의
+ * 잘못된 leaf 페이지이므로 건너뛰고, 연 트리는 분할되지 않으므로 오른쪽
+ * 링크도 따라가지 않습니다.
+ *
+ * @param t 탐색할 트리에 해당합니다.
+ * @param r 탐색 범위에 해당합니다.
+ * @param shcb 데이터를 찾았을 때의 callback 함수에 해당합니다.
+ * @param cbarg 추가적인 매개 변수 값입니다.
+ *
+ * @return 만난 사각형의 갯수를 반환합니다.
+ */
+int RTreeLatchedSearch(struct RTree *t, struct Rect *r, SearchHitCallback shcb,
+		       void *cbarg)
+{
+	struct RTreeLatchedFrame stack[RTREE_MAX_DEPTH * (MAXCARD + 1)];
+	struct Node *hits[MAXCARD];
+	register struct Node *n;
+	struct Node *right;
+	uint64_t v, lsn, nsn, parent_lsn, e;
+	int top, i, count, level, want, nhits, hitCount = 0;
+
+	assert(t && r);
+
+	e = RTreeReadEnter(t);
+	top = 0;
+	stack[0].node = __atomic_load_n(&t->root, __ATOMIC_ACQUIRE);
+	stack[0].parent_lsn = 0;
+	stack[0].level = -1;
+	while (top >= 0) {
+		n = stack[top].node;
+		parent_lsn = stack[top].parent_lsn;
+		want = stack[top].level;
+		top--;
+
+		do {
+			v = RTreeReadBegin(n);
+			count = n->count;
+			level = n->level;
+			lsn = n->lsn;
+			nsn = n->nsn;
+			right = n->right;
+			nhits = 0;
+			if (count < 0 || count > MAXCARD ||
+			    (want >= 0 && level != want))
+				continue; /**< 고치는 중이거나 잘못된 노드 */
+			for (i = 0; i < count; i++)
+				if (RTreeOverlap(r, &n->branch[i].rect))
+					hits[nhits++] = n->branch[i].child;
+		} while (RTreeReadRetry(n, v));
+		if (want >= 0 && level != want)
+			continue;
+
+		/**
+		 * @brief 부모를 읽은 후에 분할된 경우에는 오른쪽으로 옮겨진
+		 * 브랜치들을 보기 위해서 오른쪽 노드도 방문합니다.
+		 */
+		if (right && nsn > parent_lsn && !t->map) {
+			top++;
+			stack[top].node = right;
+			stack[top].parent_lsn = parent_lsn;
+			stack[top].level = want;
+		}
+
+		if (level > 0) {
+			assert(top + nhits < RTREE_MAX_DEPTH * (MAXCARD + 1));
+			for (i = 0; i < nhits; i++) {
+				top++;
+				stack[top].node = hits[i];
+				stack[top].parent_lsn = lsn;
+				stack[top].level = level - 1;
+			}
+		} else {
+			for (i = 0; i < nhits; i++) {
+				hitCount++;
+				if (shcb && !shcb((int)(tid_t)hits[i], cbarg))
+					goto done;
+			}
+		}
+	}
+done:
+	RTreeReadExit(t, e);
+	return hitCount;
+}
+
+/**
+ * @brief 노드가 트리에 연결되어 있는 지를 확인합니다.
+ *
+ * @details 분할로 새로 생긴 노드는 부모에 추가될 때까지 부모가 없으므로,
+ * 루트가 아닌데 부모가 없는 노드는 아직 만들고 있는 노드입니다.
+ */
+static inline int RTreeLatchedLinked(struct RTree *t, struct Node *n)
+{
+	return n->parent || n == __atomic_load_n(&t->root, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief 잠근 노드 n의 부모를 잠그고, 부모에서 n을 가리키는 브랜치를
+ * 찾습니다.
+ *
+ * @details 부모 포인터는 분할만 바꾸고, 분할은 부모를 잠근 상태에서 자식을
+ * 새로운 노드로 옮기므로 부모를 잠근 후에 n이 없으면 부모를 다시 읽습니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param n 잠근 노드에 해당합니다.
+ * @param slot 부모에서 n을 가리키는 브랜치 번호가 들어갑니다.
+ *
+ * @return 잠근 부모, n이 루트인 경우 NULL
+ */
+static struct Node *RTreeLatchParent(struct RTree *t, struct Node *n,
+				     int *slot)
+{
+	struct Node *p;
+	int i;
+
+	for (;;) {
+		p = __atomic_load_n(&n->parent, __ATOMIC_ACQUIRE);
+		if (!p)
+			return NULL;
+		RTreeWriteBegin(p);
+		if (RTreeLatchedLinked(t, p)) {
+			for (i = 0; i < p->count; i++) {
+				if (p->branch[i].child == n) {
+					*slot = i;
+					return p;
+				}
+			}
+		}
+		RTreeWriteEnd(p);
+		sched_yield(); /**< 분할이 끝나기를 기다립니다. */
+	}
+}
+
+/**
+ * @brief 잠근 노드 n에서부터 루트까지 올라가면서 부모의 브랜치를 고치고
+ * 잠금을 풉니다.
+ *
+ * @details 부모를 잠근 후에 자식을 풀어주므로 부모를 고치는 동안 자식이
+ * 바뀌지 않고, 같은 부모를 고치는 쓰기들은 자식을 고친 순서대로 부모를
+ * 고칩니다. 데이터의 수와 같은 집계는 항상 자식으로부터 다시 구합니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param n 잠근 노드에 해당합니다.
+ * @param r 삽입한 사각형, 삭제인 경우에는 NULL로 주어서 비어있지 않은
+ * 자식의 사각형으로 줄입니다.
+ */
+static void RTreeLatchedFixUp(struct RTree *t, struct Node *n, struct Rect *r)
+{
+	struct Node *p;
+	struct Rect cover;
+	int i;
+
+	while ((p = RTreeLatchParent(t, n, &i))) {
+		if (r) {
+			cover = RTreeCombineRect(r, &p->branch[i].rect);
+			RTreeSetBranchRect(p, i, &cover);
+		} else if (n->count > 0) {
+			cover = RTreeNodeCover(n);
+			RTreeSetBranchRect(p, i, &cover);
+		}
+		RTreeUpdateAggregate(p, i);
+		RTreeWriteEnd(n);
+		n = p;
+	}
+	RTreeWriteEnd(n);
+}
+
+/**
+ * @brief 잠금 없이 내려가서 level에 있는 노드 중에서 r을 넣을 노드를
+ * 고릅니다.
+ *
+ * @details 고른 후에 노드가 분할되더라도 그 노드에 넣으면 되므로 오른쪽
+ * 링크는 따라가지 않습니다. 분할 중인 노드는 level도 잠시 바뀌므로 level도
+ * 버전을 확인하면서 읽습니다. 트리의 lock을 공유로 가진 상태여야 합니다.
+ */
+static struct Node *RTreeLatchedChoose(struct RTree *t, struct Rect *r,
+				       int level)
+{
+	struct Node *n, *child;
+	uint64_t v;
+	int nlevel;
+
+	n = __atomic_load_n(&t->root, __ATOMIC_ACQUIRE);
+	for (;;) {
+		do {
+			v = RTreeReadBegin(n);
+			nlevel = n->level;
+			child = NULL;
+			if (nlevel > level && n->count > 0 &&
+			    n->count <= MAXCARD)
+				child = n->branch[RTreePickBranch(t, r, n)]
+						.child;
+		} while (RTreeReadRetry(n, v));
+		if (nlevel <= level)
+			break;
+		if (child)
+			n = child;
+	}
+	assert(nlevel == level);
+	return n;
+}
+
+/**
+ * @brief 브랜치를 추가하고, 분할된 경우에는 오른쪽 링크를 연결합니다.
+ *
+ * @details n은 이미 잠근 상태여야 하며, 새로운 노드는 잠근 후에 n의 오른쪽
+ * 링크를 통해서 보이게 됩니다.
+ *
+ * @return 분할된 경우 1, 그렇지 않은 경우 0
+ */
+static int RTreeLatchedAddBranch(struct RTree *t, struct Branch *b,
+				 struct Node *n, struct Node **new_node)
+{
+	struct Node *right = n->right;
+	uint64_t nsn = n->nsn;
+
+	if (!RTreeAddBranch(t, b, n, new_node))
+		return 0;
+
+	RTreeWriteBegin(*new_node);
+	t->nsn++;
+	(*new_node)->right = right;
+	(*new_node)->nsn = nsn;
+	(*new_node)->lsn = t->nsn;
+	n->right = *new_node;
+	n->nsn = t->nsn;
+	n->lsn = t->nsn;
+	return 1;
+}
+
+/**
+ * @brief 분할이 필요한 삽입을 다른 분할과 직렬화해서 진행합니다.
+ *
+ * @details split_lock을 기다리는 동안 다른 쓰기가 노드를 고쳤을 수 있으므로
+ * 노드를 다시 고르고, 그 사이에 자리가 생겼으면 분할하지 않습니다. 분할된
+ * 노드와 새로운 노드는 부모에 새로운 노드가 추가될 때까지 잠근 상태로
+ * 두므로 탐색이 부모의 새로운 브랜치와 오른쪽 링크를 통해서 같은 노드를 두 번
+ * 방문하지 않습니다.
+ *
+ * @return 루트가 분할된 경우 1, 그렇지 않은 경우 0, 노드가 부족한 경우 -1
+ */
+static int RTreeLatchedSplitInsert(struct RTree *t, struct Branch *b,
+				   int level)
+{
+	struct Node *n, *p, *right, *left, *newroot;
+	struct Rect r = b->rect, cover;
+	int i, split;
+
+	pthread_mutex_lock(&t->split_lock);
+	if (RTreeReserveInsert(t)) {
+		pthread_mutex_unlock(&t->split_lock);
+		return -1;
+	}
+	n = RTreeLatchedChoose(t, &r, level);
+	RTreeWriteBegin(n);
+	split = RTreeLatchedAddBranch(t, b, n, &right);
+	while (split && (p = RTreeLatchParent(t, n, &i))) {
+		cover = RTreeNodeCover(n);
+		RTreeSetBranchRect(p, i, &cover);
+		RTreeUpdateAggregate(p, i);
+		b->rect = RTreeNodeCover(right);
+		b->child = right;
+		p->lsn = n->nsn;
+		left = right;
+		split = RTreeLatchedAddBranch(t, b, p, &right);
+		RTreeWriteEnd(left);
+		RTreeWriteEnd(n);
+		n = p;
+	}
+
+	if (split) { /**< 루트가 분할된 경우 새로운 루트를 만들어 냅니다. */
+		newroot = RTreeNewNode(t);
+		newroot->level = n->level + 1;
+		newroot->lsn = n->nsn;
+		b->rect = RTreeNodeCover(n);
+		b->child = n;
+		RTreeAddBranch(t, b, newroot, NULL);
+		b->rect = RTreeNodeCover(right);
+		b->child = right;
+		RTreeAddBranch(t, b, newroot, NULL);
+		__atomic_store_n(&t->root, newroot, __ATOMIC_RELEASE);
+		RTreeWriteEnd(right);
+		RTreeWriteEnd(n);
+	} else {
+		RTreeLatchedFixUp(t, n, &r);
+	}
+	pthread_mutex_unlock(&t->split_lock);
+	return split;
+}
+
+/**
+ * @brief 삽입을 다른 탐색, 삽입, 삭제와 동시에 진행할 수 있도록 합니다.
+ *
+ * @details 잠금 없이 고른 노드에 자리가 있으면 그 노드만 잠가서 넣은 후에
+ * 부모들을 고치며, 분할이 필요한 경우에만 RTreeLatchedSplitInsert로
+ * 다른 분할과 직렬화합니다. id 표를 늘려야 하는 경우에는 트리의 lock을
+ * 독점으로 잡습니다.
+ *
+ * @param t 삽입할 트리에 해당합니다.
+ * @param r 삽입되는 사각형에 해당합니다.
+ * @param tid 삽입되는 사각형의 ID에 해당합니다.
+ * @param level 삽입할 노드의 level에 해당합니다.
+ *
+ * @return 루트가 분할된 경우 1을 반환, 그렇지 않은 경우 0을 반환합니다.
+ * id의 위치를 기록할 메모리나 노드가 부족한 경우에는 -1을 반환합니다.
+ */
+int RTreeLatchedInsert(struct RTree *t, struct Rect *r, tid_t tid, int level)
+{
+	struct Node *n;
+	struct Branch b;
+	int ret;
+
+	assert(t && r);
+
+	pthread_rwlock_rdlock(&t->lock);
+	if (level == 0 && tid >= t->nleafref) {
+		pthread_rwlock_unlock(&t->lock);
+		pthread_rwlock_wrlock(&t->lock);
+		ret = RTreeReserveId(t, tid);
+		pthread_rwlock_unlock(&t->lock);
+		if (ret)
+			return -1;
+		pthread_rwlock_rdlock(&t->lock);
+	}
+
+	b.rect = *r;
+	b.child = (struct Node *)tid;
+	n = RTreeLatchedChoose(t, r, level);
+	RTreeWriteBegin(n);
+	if (n->count < MAXKIDS(t, n)) {
+		RTreeAddBranch(t, &b, n, NULL);
+		RTreeLatchedFixUp(t, n, r);
+		ret = 0;
+	} else {
+		RTreeWriteEnd(n);
+		ret = RTreeLatchedSplitInsert(t, &b, level);
+	}
+	pthread_rwlock_unlock(&t->lock);
+	return ret;
+}
+
+/**
+ * @brief 살아있는 데이터가 leaf 용량의 RTREE_REPACK_PCT%보다 적은 지를
+ * 확인합니다.
+ */
+static int RTreeLatchedSparse(struct RTree *t)
+{
+	struct Node *root = __atomic_load_n(&t->root, __ATOMIC_ACQUIRE);
+
+	return root->level > 0 &&
+	       RTreeNodeTotal(root) * 100 < (long)t->node_pool.nused *
+						    LEAFCARD(t) *
+						    RTREE_REPACK_PCT;
+}
+
+/**
+ * @brief 트리가 너무 비게 되면 다시 채운 트리로 루트를 바꿉니다.
+ *
+ * @details 트리의 lock을 독점으로 잡아서 다른 쓰기를 막은 후에 다시
+ * 확인하고, RTreeRepack으로 새로운 노드들에 트리를 만들고 루트를 바꿉니다.
+ * 기존 트리는 바뀌지 않으므로 그 트리를 읽던 탐색은 그대로 끝까지
+ * 진행합니다. epoch를 올린 후에 이전 epoch의 탐색이 모두 끝나기를 기다려서
+ * 기존 노드들을 돌려줍니다.
+ *
+ * @param t 트리에 해당합니다.
+ */
+static void RTreeLatchedRepack(struct RTree *t)
+{
+	struct Node *old, *root;
+	uint64_t e;
+
+	pthread_rwlock_wrlock(&t->lock);
+	old = t->root;
+	if (!RTreeLatchedSparse(t))
+		goto out;
+	root = RTreeRepack(t);
+	if (!root)
+		goto out; /**< 메모리가 부족하면 다음 삭제에서 다시 시도합니다. */
+	__atomic_store_n(&t->root, root, __ATOMIC_RELEASE);
+	e = __atomic_fetch_add(&t->epoch, 1, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&t->readers[e & 1], __ATOMIC_SEQ_CST))
+		sched_yield();
+	RTreeFreeSubtree(t, old);
+	t->dstats.repacked++;
+out:
+	pthread_rwlock_unlock(&t->lock);
+}
+
+/**
+ * @brief 삭제를 다른 탐색, 삽입, 삭제와 동시에 진행할 수 있도록 합니다.
+ *
+ * @details id 표로 데이터가 들어있는 leaf를 바로 찾아서 그 leaf만 잠근
+ * 후에 부모들의 사각형과 집계를 고칩니다. 잠그는 사이에 분할로 데이터가
+ * 옮겨졌으면 표를 다시 읽습니다. 탐색이 이미 지나간 노드로 데이터가
+ * 옮겨지지 않도록 모자란 노드를 재삽입하지 않고, 비어있는 노드와 자식이
+ * 하나인 루트도 그대로 둡니다. 그 대신 트리가 너무 비게 되면
+ * RTreeLatchedRepack으로 다시 채웁니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param r 사각형을 가리키는 포인터, NULL이면 사각형을 확인하지 않습니다.
+ * @param tid 레코드의 id에 해당합니다.
+ *
+ * @return 레코드를 찾은 경우 0, 못 찾은 경우 1을 반환합니다.
+ */
+int RTreeLatchedDelete(struct RTree *t, struct Rect *r, tid_t tid)
+{
+	struct Node *n;
+	int i, sparse;
+
+	assert(t);
+
+	pthread_rwlock_rdlock(&t->lock);
+	for (;;) {
+		n = tid < t->nleafref ? __atomic_load_n(&t->leafref[tid].leaf,
+							__ATOMIC_ACQUIRE) :
+					NULL;
+		if (!n) {
+			pthread_rwlock_unlock(&t->lock);
+			return 1;
+		}
+		RTreeWriteBegin(n);
+		i = t->leafref[tid].slot;
+		if (t->leafref[tid].leaf == n && RTreeLatchedLinked(t, n) &&
+		    i < n->count && RTreeLeafId(n, i) == tid)
+			break;
+		RTreeWriteEnd(n);
+	}
+	if (r && !RTreeOverlap(r, &n->branch[i].rect)) {
+		RTreeWriteEnd(n);
+		pthread_rwlock_unlock(&t->lock);
+		return 1;
+	}
+	RTreeDisconnectBranch(t, n, i);
+	RTreeLatchedFixUp(t, n, NULL);
+	sparse = RTreeLatchedSparse(t);
+	pthread_rwlock_unlock(&t->lock);
+	if (sparse)
+		RTreeLatchedRepack(t);
+	return 0;
+}
+
+#endif /* RTREE_CONCURRENT */
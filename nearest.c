@@ -0,0 +1,209 @@
+/**
+ * @file nearest.c
+ * @brief 기준점에서 가까운 순서로 데이터를 찾는 best-first 탐색입니다.
+ *
+ * @details Hjaltason과 Samet의 방법을 따라서 아직 보지 않은 브랜치들을
+ * 기준점까지의 MINDIST로 정렬된 우선순위 큐에 넣어두고, 가장 가까운 것부터
+ * 꺼냅니다. 꺼낸 것이 데이터이면 큐에 남은 어떤 것보다도 가까우므로 바로
+ * 결과가 됩니다. 따라서 k를 미리 정하지 않고 원하는 만큼만 꺼낼 수 있습니다.
+ */
+
+#include "assert.h"
+#include "index.h"
+#include <stdlib.h>
+
+#define NEAREST_INIT_CAP 256 /**< 우선순위 큐의 처음 크기 */
+
+/**
+ * @brief 큐에서 a가 b보다 먼저 나와야 하는 지를 확인합니다.
+ *
+ * @details 거리가 같으면 데이터를 노드보다 먼저, 데이터끼리는 id가 작은 것을
+ * 먼저 꺼내서 결과의 순서가 트리의 모양에 따라 바뀌지 않도록 합니다.
+ */
+static int RTreeNearestLess(struct RTreeNearestEntry *a,
+			    struct RTreeNearestEntry *b)
+{
+	if (a->d2 != b->d2)
+		return a->d2 < b->d2;
+	if (a->level != b->level)
+		return a->level < b->level;
+	return a->level == 0 && a->child < b->child;
+}
+
+/**
+ * @brief 노드의 브랜치들을 모두 우선순위 큐에 넣습니다.
+ *
+ * @return 성공 시 0, 메모리가 부족한 경우 -1
+ */
+static int RTreeNearestPushNode(struct RTreeNearestCursor *c, struct Node *n)
+{
+	register struct RTreeNearestEntry *heap;
+	struct RTreeNearestEntry e;
+	struct Rect tmp;
+	register int i, j, parent;
+	int cap;
+
+	if (c->size + n->count > c->cap) {
+		cap = c->cap * 2;
+		while (cap < c->size + n->count)
+			cap *= 2;
+		heap = (struct RTreeNearestEntry *)realloc(c->heap,
+							   cap * sizeof(*heap));
+		if (!heap)
+			return -1;
+		c->heap = heap;
+		c->cap = cap;
+	}
+
+	heap = c->heap;
+	for (i = 0; i < n->count; i++) {
+		if (n->level == 0 && !RTreeLeafLive(n, i))
+			continue; /**< tombstone */
+		e.d2 = RTreeMinDist2(RTreeEntryRect(n, i, &tmp), c->point);
+		e.child = n->level > 0 ? n->branch[i].child :
+					 (struct Node *)RTreeLeafId(n, i);
+		e.level = n->level;
+		for (j = c->size++; j > 0; j = parent) {
+			parent = (j - 1) / 2;
+			if (!RTreeNearestLess(&e, &heap[parent]))
+				break;
+			heap[j] = heap[parent];
+		}
+		heap[j] = e;
+	}
+	return 0;
+}
+
+/**
+ * @brief 우선순위 큐에서 가장 가까운 브랜치를 꺼냅니다.
+ */
+static struct RTreeNearestEntry RTreeNearestPop(struct RTreeNearestCursor *c)
+{
+	register struct RTreeNearestEntry *heap = c->heap;
+	struct RTreeNearestEntry top = heap[0], last;
+	register int i, child;
+
+	last = heap[--c->size];
+	for (i = 0; (child = 2 * i + 1) < c->size; i = child) {
+		if (child + 1 < c->size &&
+		    RTreeNearestLess(&heap[child + 1], &heap[child]))
+			child++;
+		if (!RTreeNearestLess(&heap[child], &last))
+			break;
+		heap[i] = heap[child];
+	}
+	heap[i] = last;
+	return top;
+}
+
+/**
+ * @brief 기준점에서 가까운 순서로 데이터를 꺼내오는 커서를 엽니다.
+ *
+ * @details 커서를 사용하는 동안 트리를 수정해서는 안 됩니다.
+ *
+ * @param c 커서를 가리키는 포인터입니다.
+ * @param t 탐색할 트리에 해당합니다.
+ * @param point 기준점의 좌표 (NUMDIMS개)
+ *
+ * @return 성공 시 0, 메모리가 부족한 경우 -1을 반환합니다.
+ */
+int RTreeNearestOpen(struct RTreeNearestCursor *c, struct RTree *t,
+		     RectReal *point)
+{
+	register int i;
+
+	assert(c && t && point && t->root);
+
+	for (i = 0; i < NUMDIMS; i++)
+		c->point[i] = point[i];
+	c->size = 0;
+	c->cap = NEAREST_INIT_CAP;
+	c->heap = (struct RTreeNearestEntry *)malloc(
+		c->cap * sizeof(struct RTreeNearestEntry));
+	if (!c->heap)
+		return -1;
+	if (RTreeNearestPushNode(c, t->root)) {
+		RTreeNearestClose(c);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief 커서에서 다음으로 가까운 데이터를 꺼냅니다.
+ *
+ * @param c 커서를 가리키는 포인터입니다.
+ * @param id 찾은 데이터의 id가 들어갑니다.
+ * @param d2 기준점에서 데이터까지의 거리의 제곱이 들어갑니다.
+ * (NULL이면 무시합니다.)
+ *
+ * @return 데이터를 찾은 경우 1, 더 이상 없는 경우 0,
+ * 메모리가 부족한 경우 -1을 반환합니다.
+ */
+int RTreeNearestNext(struct RTreeNearestCursor *c, tid_t *id, RectDist *d2)
+{
+	struct RTreeNearestEntry e;
+
+	assert(c && id);
+
+	while (c->size > 0) {
+		e = RTreeNearestPop(c);
+		if (e.level > 0) { /**< 트리의 내장 노드의 경우 */
+			if ((e.level > 1 || RTreeLeafValid(e.child)) &&
+			    RTreeNearestPushNode(c, e.child))
+				return -1;
+		} else { /**< 트리의 leaf 노드의 경우 */
+			*id = (tid_t)e.child;
+			if (d2)
+				*d2 = e.d2;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief 커서를 닫습니다. 이후에 RTreeNearestNext는 항상 0을 반환합니다.
+ *
+ * @param c 커서를 가리키는 포인터입니다.
+ */
+void RTreeNearestClose(struct RTreeNearestCursor *c)
+{
+	assert(c);
+	free(c->heap);
+	c->heap = NULL;
+	c->size = c->cap = 0;
+}
+
+/**
+ * @brief 기준점에서 가장 가까운 k개의 데이터를 찾습니다.
+ *
+ * @param t 탐색할 트리에 해당합니다.
+ * @param point 기준점의 좌표 (NUMDIMS개)
+ * @param k 찾을 데이터의 수
+ * @param ids 가까운 순서대로 데이터의 id가 들어갑니다. (k개 이상의 공간)
+ * @param d2s 각 데이터까지의 거리의 제곱이 들어갑니다. (NULL이면 무시합니다.)
+ *
+ * @return 찾은 데이터의 수, 메모리가 부족한 경우 -1을 반환합니다.
+ */
+int RTreeNearest(struct RTree *t, RectReal *point, int k, tid_t *ids,
+		 RectDist *d2s)
+{
+	struct RTreeNearestCursor c;
+	int found, result;
+
+	assert(t && point && k >= 0 && ids);
+
+	if (RTreeNearestOpen(&c, t, point))
+		return -1;
+	for (found = 0; found < k; found++) {
+		result = RTreeNearestNext(&c, &ids[found],
+					  d2s ? &d2s[found] : NULL);
+		if (result < 0)
+			found = -1;
+		if (result <= 0)
+			break;
+	}
+	RTreeNearestClose(&c);
+	return found;
+}
@@ -2,8 +2,12 @@
 #include "assert.h"
 #include "card.h"
 #include "index.h"
+#include <float.h>
 #include <malloc.h>
 #include <stdio.h>
+#include <string.h>
+
+_Static_assert(sizeof(struct Node) <= PGSIZE, "struct Node must fit in a page");
 
 /**
  * @brief 브랜치를 초기화 합니다.
@@ -16,42 +20,174 @@ static void RTreeInitBranch(struct Branch *b)
 	b->child = NULL;
 }
 
+/**
+ * @brief i번째 브랜치의 사각형을 갱신합니다.
+ *
+ * @details RTREE_SOA로 빌드한 경우에는 차원별 경계값 배열도 함께 갱신하고,
+ * 저장된 부피도 지우므로 노드 안의 사각형은 반드시 이 함수를 통해서
+ * 바꾸도록 합니다.
+ *
+ * @param n 노드를 가리키는 포인터입니다.
+ * @param i branch 번호에 해당합니다.
+ * @param r 새로운 사각형에 해당합니다.
+ */
+void RTreeSetBranchRect(struct Node *n, int i, struct Rect *r)
+{
+#ifdef RTREE_SOA
+	register int j;
+	for (j = 0; j < NUMSIDES; j++)
+		n->bound[j][i] = r->boundary[j];
+#endif
+	n->branch[i].rect = *r;
+	n->vol[i] = (RectArea)-1;
+}
+
+/**
+ * @brief i번째 브랜치를 비어있는 브랜치로 만듭니다.
+ *
+ * @details RTREE_SOA로 빌드한 경우에는 어떤 사각형과도 겹치지 않도록
+ * 하한은 가장 큰 값, 상한은 가장 작은 값으로 설정합니다.
+ *
+ * @param n 노드를 가리키는 포인터입니다.
+ * @param i branch 번호에 해당합니다.
+ */
+static void RTreeClearBranch(struct Node *n, int i)
+{
+#ifdef RTREE_POINTLEAF
+	if (n->level == 0) {
+		memset(&n->point[i], 0, sizeof(n->point[i]));
+		return;
+	}
+#endif
+#ifdef RTREE_SOA
+	register int j;
+	for (j = 0; j < NUMDIMS; j++) {
+		n->bound[j][i] = (RectReal)RECTREAL_MAX;
+		n->bound[j + NUMDIMS][i] = (RectReal)-RECTREAL_MAX;
+	}
+#endif
+	RTreeInitBranch(&(n->branch[i]));
+	n->subcount[i] = 0;
+#ifdef RTREE_HILBERT
+	n->lhv[i] = 0;
+#endif
+}
+
 /**
  * @brief 노드를 초기화 하도록 합니다.
  *
+ * @details 브랜치는 [0, count)만 읽으므로 브랜치들은 지우지 않습니다.
+ *
  * @param N 초기화 시킬 노드에 해당합니다.
  */
 void RTreeInitNode(struct Node *N)
 {
 	register struct Node *n = N;
-	register int i;
 	n->count = 0;
 	n->level = -1;
-	for (i = 0; i < MAXCARD; i++)
-		RTreeInitBranch(&(n->branch[i]));
 }
 
 /**
  * @brief 모든 브랜치의 셀이 비어있는 새로운 노드를 만듭니다.
  *
- * @return 새롭게 생성된 노트 n을 반환하도록 합니다.
+ * @details 분할 도중에는 실패를 되돌릴 수 없으므로 트리를 고치는 함수들은
+ * RTreeReserveNodes로 필요한 노드를 먼저 확보한 후에 호출합니다.
+ *
+ * @param t 노드를 할당받을 트리에 해당합니다.
+ *
+ * @return 새롭게 생성된 노트 n을 반환하도록 합니다. 메모리가 부족한 경우
+ * NULL을 반환합니다.
  */
-struct Node *RTreeNewNode()
+struct Node *RTreeNewNode(struct RTree *t)
 {
 	register struct Node *n;
 
-	// n = new Node;
-	n = (struct Node *)malloc(sizeof(struct Node));
-	assert(n);
+	n = (struct Node *)RTreePoolAlloc(&t->node_pool);
+	if (!n)
+		return NULL;
 	RTreeInitNode(n);
+	n->parent = NULL; /**< RTreeInitNode는 부모를 유지합니다. */
+#ifdef RTREE_CONCURRENT
+	/**
+	 * @brief 분할 시에 RTreeInitNode가 다시 호출되더라도 버전과 링크는
+	 * 유지되어야 하므로 여기에서만 초기화 합니다.
+	 */
+	n->version = 0;
+	n->nsn = 0;
+	n->lsn = 0;
+	n->right = NULL;
+#endif
 	return n;
 }
 
-void RTreeFreeNode(struct Node *p)
+void RTreeFreeNode(struct RTree *t, struct Node *p)
 {
 	assert(p);
-	// delete p;
-	free(p);
+	RTreePoolFree(&t->node_pool, p);
+}
+
+/**
+ * @brief 이후에 RTreeNewNode가 k번 실패하지 않도록 노드를 확보합니다.
+ *
+ * @return 성공 시 0, 메모리가 부족한 경우 -1
+ */
+int RTreeReserveNodes(struct RTree *t, long k)
+{
+	return k > 0 ? RTreePoolReserve(&t->node_pool, k) : 0;
+}
+
+/**
+ * @brief 삽입 한 번이 새로 만들 수 있는 노드의 수를 구합니다.
+ *
+ * @details 브랜치 하나를 넣으면 루트까지 level마다 많아야 하나의 노드가
+ * 생기고, 루트가 나눠지면 새로운 루트가 생깁니다. R*-tree는 level마다 한 번
+ * 재삽입을 하므로 재삽입되는 브랜치마다 이만큼이 더 필요합니다.
+ *
+ * @param reinsert 0이면 R*-tree도 재삽입 없이 분할만 하는 경우로 구합니다.
+ */
+long RTreeInsertNodes(struct RTree *t, int reinsert)
+{
+	long h = t->root->level;
+	int card = NODECARD(t) > LEAFCARD(t) ? NODECARD(t) : LEAFCARD(t);
+
+	if (reinsert && t->method == RTREE_RSTAR)
+		return (h + 3) * (1 + (h + 2) * RSTAR_REINSERT(card + 1));
+	return h + 2;
+}
+
+/**
+ * @brief 삽입 한 번이 새로 만들 수 있는 노드를 확보합니다.
+ *
+ * @return 성공 시 0, 메모리가 부족한 경우 -1
+ */
+int RTreeReserveInsert(struct RTree *t)
+{
+	return RTreeReserveNodes(t, RTreeInsertNodes(t, 1));
+}
+
+/**
+ * @brief 노드를 할당받을 slab을 huge page로 받을 지를 설정합니다.
+ */
+void RTreeSetHugePage(struct RTree *t, int on)
+{
+	RTreePoolSetHugePage(&t->node_pool, on);
+}
+
+/**
+ * @brief 인덱스가 사용하는 메모리의 크기를 알려줍니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param in_use 노드와 리스트 노드가 사용 중인 메모리의 크기
+ * @param cached 풀이 재사용을 위해서 가지고 있는 메모리의 크기
+ */
+void RTreeMemoryStats(struct RTree *t, size_t *in_use, size_t *cached)
+{
+	if (in_use)
+		*in_use = RTreePoolBytesInUse(&t->node_pool) +
+			  RTreePoolBytesInUse(&t->list_pool);
+	if (cached)
+		*cached = RTreePoolBytesCached(&t->node_pool) +
+			  RTreePoolBytesCached(&t->list_pool);
 }
 
 extern void RTreeTabIn(int depth)
@@ -71,22 +207,153 @@ extern void RTreeTabIn(int depth)
 struct Rect RTreeNodeCover(struct Node *N)
 {
 	register struct Node *n = N;
-	register int i, first_time = 1;
+	register int i;
 	struct Rect r;
 	assert(n);
 
-	RTreeInitRect(&r);
-	for (i = 0; i < MAXKIDS(n); i++)
-		if (n->branch[i].child) {
-			if (first_time) {
-				r = n->branch[i].rect;
-				first_time = 0;
-			} else
-				r = RTreeCombineRect(&r, &(n->branch[i].rect));
-		}
+	if (n->count == 0) {
+		RTreeInitRect(&r);
+		return r;
+	}
+#ifdef RTREE_POINTLEAF
+	if (n->level == 0) {
+		register int j;
+		RTreeEntryRect(n, 0, &r);
+		for (i = 1; i < n->count; i++)
+			for (j = 0; j < NUMDIMS; j++) {
+				if (n->point[i].p[j] < r.boundary[j])
+					r.boundary[j] = n->point[i].p[j];
+				if (n->point[i].p[j] > r.boundary[j + NUMDIMS])
+					r.boundary[j + NUMDIMS] =
+						n->point[i].p[j];
+			}
+		return r;
+	}
+#endif
+	r = n->branch[0].rect;
+	for (i = 1; i < n->count; i++)
+		r = RTreeCombineRect(&r, &(n->branch[i].rect));
 	return r;
 }
 
+/**
+ * @brief 노드 아래에 있는 tombstone이 아닌 데이터의 수를 구합니다.
+ *
+ * @param N 노드를 가리키는 포인터입니다.
+ *
+ * @return 브랜치별 서브트리 데이터 수의 합
+ */
+long RTreeNodeTotal(struct Node *N)
+{
+	register struct Node *n = N;
+	register int i;
+	register long total = 0;
+	assert(n);
+
+#ifdef RTREE_POINTLEAF
+	if (n->level == 0)
+		return n->count;
+#endif
+	for (i = 0; i < n->count; i++)
+		total += n->subcount[i];
+	return total;
+}
+
+/**
+ * @brief R*-tree의 ChooseSubtree로 브랜치를 선택합니다.
+ *
+ * @details 자식이 leaf인 노드에서는 다른 브랜치들과의 겹침이 가장 적게
+ * 늘어나는 브랜치를, 그 위에서는 부피가 가장 적게 늘어나는 브랜치를 고릅니다.
+ * 겹침의 증가량은 부피의 증가량이 작은 RSTAR_CHOOSE_P개의 후보에 대해서만
+ * 계산합니다.
+ *
+ * @param r 삽입할 사각형
+ * @param n 브랜치를 고를 노드
+ *
+ * @return 최적의 브랜치 번호에 해당합니다.
+ */
+static int RTreePickBranchRStar(struct Rect *r, struct Node *n)
+{
+	RectArea area[MAXCARD], increase[MAXCARD];
+	int order[MAXCARD];
+	struct Rect tmp_rect;
+	register struct Rect *rr;
+	register int i, j, k, m;
+	RectArea overlap, bestOverlap = 0;
+	int best = 0;
+
+	for (i = 0; i < n->count; i++) {
+		rr = &n->branch[i].rect;
+		area[i] = RTreeRectArea(rr);
+		tmp_rect = RTreeCombineRect(r, rr);
+		increase[i] = RTreeRectArea(&tmp_rect) - area[i];
+		if (increase[i] < increase[best] ||
+		    (increase[i] == increase[best] && area[i] < area[best]))
+			best = i;
+	}
+	/**
+	 * @brief 늘어나지 않는 브랜치가 있으면 겹침도 늘어나지 않으므로
+	 * 바로 고릅니다.
+	 */
+	if (n->level != 1 || increase[best] == 0)
+		return best;
+
+	/**
+	 * @brief 부피의 증가량이 작은 순서로 후보를 고릅니다.
+	 */
+	for (i = 0, m = 0; i < n->count; i++) {
+		if (m == RSTAR_CHOOSE_P && increase[i] >= increase[order[m - 1]])
+			continue;
+		if (m < RSTAR_CHOOSE_P)
+			m++;
+		for (j = m - 1; j > 0 && increase[order[j - 1]] > increase[i];
+		     j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+	}
+
+	for (k = 0; k < m; k++) {
+		i = order[k];
+		rr = &n->branch[i].rect;
+		tmp_rect = RTreeCombineRect(r, rr);
+		overlap = 0;
+		for (j = 0; j < n->count; j++) {
+			if (j == i)
+				continue;
+			overlap += RTreeOverlapArea(&tmp_rect,
+						    &n->branch[j].rect) -
+				   RTreeOverlapArea(rr, &n->branch[j].rect);
+		}
+		if (k == 0 || overlap < bestOverlap ||
+		    (overlap == bestOverlap &&
+		     (increase[i] < increase[best] ||
+		      (increase[i] == increase[best] && area[i] < area[best])))) {
+			best = i;
+			bestOverlap = overlap;
+		}
+	}
+	return best;
+}
+
+/**
+ * @brief 자식 노드로부터 브랜치의 집계 값을 다시 구합니다.
+ *
+ * @details 서브트리의 데이터 수와, RTREE_HILBERT로 빌드한 경우에는 가장 큰
+ * Hilbert 값을 갱신합니다. 자식 노드가 바뀐 후에 호출해야 합니다.
+ *
+ * @param n 노드를 가리키는 포인터입니다. leaf가 아니어야 합니다.
+ * @param i branch 번호에 해당합니다.
+ */
+void RTreeUpdateAggregate(struct Node *n, int i)
+{
+	assert(n && n->level > 0 && i >= 0 && i < n->count);
+
+	n->subcount[i] = RTreeNodeTotal(n->branch[i].child);
+#ifdef RTREE_HILBERT
+	n->lhv[i] = RTreeNodeLhv(n->branch[i].child);
+#endif
+}
+
 /**
  * @brief 브랜치를 선택합니다.
  *
@@ -95,76 +362,145 @@ struct Rect RTreeNodeCover(struct Node *N)
  *
  * 선택된 것이 같은 값을 가지는 경우에는 검색의 효율성을 위해서 면적이 더 적은 것을 선택하도록 합니다.
  *
+ * @param t 트리에 해당합니다.
  * @param R 사각형을 가리키는 포인터에 해당합니다.
  * @param N 노드를 가리키는 포인터에 해당합니다.
  *
  * @return 최적의 브랜치 번호에 해당합니다.
  */
-int RTreePickBranch(struct Rect *R, struct Node *N)
+int RTreePickBranch(struct RTree *t, struct Rect *R, struct Node *N)
 {
 	register struct Rect *r = R;
 	register struct Node *n = N;
 	register struct Rect *rr;
-	register int i, first_time = 1;
-	RectReal increase, bestIncr = (RectReal)-1, area, bestArea;
-	int best;
+	register int i;
+	RectArea increase, bestIncr = (RectArea)-1, area, bestArea = 0;
+	int best = 0;
 	struct Rect tmp_rect;
 	assert(r && n);
+	assert(n->count > 0);
 
-	for (i = 0; i < MAXKIDS(n); i++) {
-		if (n->branch[i].child) {
-			rr = &n->branch[i].rect;
-			area = RTreeRectSphericalVolume(rr);
-			tmp_rect = RTreeCombineRect(r, rr);
-			increase = RTreeRectSphericalVolume(&tmp_rect) - area;
-			if (increase < bestIncr || first_time) {
-				best = i;
-				bestArea = area;
-				bestIncr = increase;
-				first_time = 0;
-			} else if (increase == bestIncr && area < bestArea) {
-				best = i;
-				bestArea = area;
-				bestIncr = increase;
-			}
+	if (t->method == RTREE_RSTAR)
+		return RTreePickBranchRStar(r, n);
+#ifdef RTREE_HILBERT
+	if (t->method == RTREE_HILBERT_TREE)
+		return RTreeHilbertPick(n, RTreeHilbertKey(r));
+#endif
+
+	for (i = 0; i < n->count; i++) {
+		rr = &n->branch[i].rect;
+		if (n->vol[i] < 0) /**< 사각형이 바뀐 후로 처음 보는 경우 */
+			n->vol[i] = RTreeVolume(t, rr);
+		area = n->vol[i];
+		tmp_rect = RTreeCombineRect(r, rr);
+		increase = RTreeVolume(t, &tmp_rect) - area;
+		if (increase < bestIncr || i == 0) {
+			best = i;
+			bestArea = area;
+			bestIncr = increase;
+		} else if (increase == bestIncr && area < bestArea) {
+			best = i;
+			bestArea = area;
+			bestIncr = increase;
 		}
 	}
 	return best;
 }
 
+/**
+ * @brief id로 데이터의 위치를 찾는 표가 id를 담을 수 있도록 늘립니다.
+ *
+ * @details 표는 id를 인덱스로 사용하므로 id는 작은 정수여야 합니다.
+ * 데이터를 leaf에 넣기 전에 호출해야 합니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param id 넣을 데이터의 id
+ *
+ * @return 성공 시 0, 메모리가 부족한 경우 -1
+ */
+int RTreeReserveId(struct RTree *t, tid_t id)
+{
+	struct RTreeLeafRef *ref;
+	size_t size;
+
+	if (id < t->nleafref)
+		return 0;
+	for (size = t->nleafref ? t->nleafref : 1024; size <= id; size *= 2)
+		;
+	ref = (struct RTreeLeafRef *)realloc(t->leafref, size * sizeof(*ref));
+	if (!ref)
+		return -1;
+	memset(ref + t->nleafref, 0, (size - t->nleafref) * sizeof(*ref));
+	t->leafref = ref;
+	t->nleafref = size;
+	return 0;
+}
+
+/**
+ * @brief id의 데이터가 leaf의 slot번째 브랜치에 있다고 기록합니다.
+ */
+static void RTreeSetLeafRef(struct RTree *t, tid_t id, struct Node *leaf,
+			    int slot)
+{
+	assert(id < t->nleafref);
+	t->leafref[id].leaf = leaf;
+	t->leafref[id].slot = slot;
+}
+
 /**
  * @brief 노드에 branch를 추가하고, 필요하다면 노드를 분리를 하도록 합니다.
  *
+ * @param t 트리에 해당합니다.
  * @param B branch 정보를 가리키는 포인터입니다.
  * @param N node를 가리키는 포인터입니다.
  * @param New_node 새로운 노트의 포인터에 대한 주소를 갑니다.
  *
  * @return 노드가 split 되지 않은 경우에는 0이 반환되고, split된 경우에는 1이 반환됩니다.
  */
-int RTreeAddBranch(struct Branch *B, struct Node *N, struct Node **New_node)
+int RTreeAddBranch(struct RTree *t, struct Branch *B, struct Node *N,
+		   struct Node **New_node)
 {
 	register struct Branch *b = B;
 	register struct Node *n = N;
 	register struct Node **new_node = New_node;
-	register int i;
 
 	assert(b);
 	assert(n);
 
-	if (n->count < MAXKIDS(n)) /**< split이 필요하지 않을 것으로 보임 */
+	if (n->count < MAXKIDS(t, n)) /**< split이 필요하지 않을 것으로 보임 */
 	{
-		for (i = 0; i < MAXKIDS(n); i++) /**< 빈 브랜치를 탐색 */
-		{
-			if (n->branch[i].child == NULL) {
-				n->branch[i] = *b;
-				n->count++;
-				break;
-			}
+		/**
+		 * @brief 브랜치는 [0, count)에 빈틈 없이 채워져 있으므로 맨 뒤에 붙입니다.
+		 */
+#ifdef RTREE_POINTLEAF
+		if (n->level == 0) { /**< 점 데이터만 넣을 수 있습니다. */
+			assert(b->rect.boundary[0] == b->rect.boundary[NUMDIMS]);
+			memcpy(n->point[n->count].p, b->rect.boundary,
+			       sizeof(n->point[n->count].p));
+			n->point[n->count].id = (tid_t)b->child;
+			RTreeSetLeafRef(t, (tid_t)b->child, n, n->count);
+			n->count++;
+			return 0;
 		}
+#endif
+		if (n->level > 0)
+			b->child->parent = n;
+		else if (b->rect.is_use) /**< tombstone은 표에 두지 않습니다. */
+			RTreeSetLeafRef(t, (tid_t)b->child, n, n->count);
+		n->branch[n->count].child = b->child;
+		n->subcount[n->count] = n->level > 0 ?
+						RTreeNodeTotal(b->child) :
+						b->rect.is_use;
+#ifdef RTREE_HILBERT
+		n->lhv[n->count] = n->level > 0 ? RTreeNodeLhv(b->child) :
+						  RTreeHilbertKey(&b->rect);
+#endif
+		RTreeSetBranchRect(n, n->count, &b->rect);
+		n->count++;
 		return 0;
 	} else {
 		assert(new_node);
-		RTreeSplitNode(n, b, new_node);
+		RTreeSplitNode(t, n, b, new_node);
 		return 1;
 	}
 }
@@ -172,14 +508,44 @@ int RTreeAddBranch(struct Branch *B, struct Node *N, struct Node **New_node)
 /**
  * @brief 현재 종속하는 노드의 연결을 끊습니다.
  *
+ * @details 브랜치들이 [0, count)에 빈틈 없이 있도록 마지막 브랜치를
+ * 지워진 자리로 옮깁니다. 따라서 i 이후의 브랜치 순서는 바뀔 수 있습니다.
+ *
+ * @param t 트리에 해당합니다.
  * @param n 노드를 가리키는 포인터입니다.
  * @param i branch 번호에 해당합니다.
  */
-void RTreeDisconnectBranch(struct Node *n, int i)
+void RTreeDisconnectBranch(struct RTree *t, struct Node *n, int i)
 {
-	assert(n && i >= 0 && i < MAXKIDS(n));
-	assert(n->branch[i].child);
+	register int last;
 
-	RTreeInitBranch(&(n->branch[i]));
+	assert(n && i >= 0 && i < n->count);
+
+	last = n->count - 1;
+	if (n->level == 0) { /**< 지운 데이터와 옮긴 데이터의 위치를 고칩니다. */
+		if (RTreeLeafLive(n, i))
+			t->leafref[RTreeLeafId(n, i)].leaf = NULL;
+		if (i != last && RTreeLeafLive(n, last))
+			RTreeSetLeafRef(t, RTreeLeafId(n, last), n, i);
+	}
+#ifdef RTREE_POINTLEAF
+	if (n->level == 0) {
+		n->point[i] = n->point[last];
+		RTreeClearBranch(n, last);
+		n->count--;
+		return;
+	}
+#endif
+	assert(n->branch[i].child);
+	if (i != last) {
+		n->branch[i].child = n->branch[last].child;
+		n->subcount[i] = n->subcount[last];
+#ifdef RTREE_HILBERT
+		n->lhv[i] = n->lhv[last];
+#endif
+		RTreeSetBranchRect(n, i, &n->branch[last].rect);
+		n->vol[i] = n->vol[last];
+	}
+	RTreeClearBranch(n, last);
 	n->count--;
 }
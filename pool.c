@@ -0,0 +1,258 @@
+#include "pool.h"
+#include "assert.h"
+#include "index.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+/**
+ * @brief 풀을 초기화 합니다. 이때는 아무런 메모리도 할당하지 않습니다.
+ *
+ * @param p 초기화 할 풀
+ * @param objsize 객체 하나의 크기
+ * @param align 객체의 정렬 단위 (2의 거듭제곱)
+ * @param slabsize slab 하나의 크기 (PGSIZE의 배수)
+ */
+void RTreePoolInit(struct RTreePool *p, size_t objsize, size_t align,
+		   size_t slabsize)
+{
+	assert(p);
+	assert(align && !(align & (align - 1)));
+	assert(slabsize % PGSIZE == 0);
+
+	if (objsize < sizeof(void *))
+		objsize = sizeof(void *);
+	p->objsize = (objsize + align - 1) & ~(align - 1);
+	p->slabsize = slabsize;
+	p->hugepage = 0;
+	p->free_list = NULL;
+	p->bump = p->bump_end = NULL;
+	p->slabs = p->spare = NULL;
+	p->nslabs = p->nspare = 0;
+	p->nused = p->nfree = 0;
+	assert(p->objsize <= p->slabsize);
+}
+
+/**
+ * @brief 이후에 받아오는 slab을 huge page로 받을 지를 설정합니다.
+ *
+ * @details slab의 크기가 HUGEPGSIZE의 배수인 경우에만 의미가 있습니다.
+ * 미리 예약된 huge page(MAP_HUGETLB)가 없으면 일반 페이지로 받은 후에
+ * transparent huge page를 요청(MADV_HUGEPAGE)합니다.
+ */
+void RTreePoolSetHugePage(struct RTreePool *p, int on)
+{
+	assert(p);
+	p->hugepage = on && (p->slabsize % HUGEPGSIZE == 0);
+}
+
+/**
+ * @brief slab으로 사용할 메모리를 받아옵니다.
+ *
+ * @return 페이지(huge page인 경우 HUGEPGSIZE)에 정렬된 메모리, 실패 시 NULL
+ */
+static void *RTreeSlabMap(struct RTreePool *p)
+{
+	void *mem;
+	char *base, *aligned;
+	size_t size = p->slabsize, head, tail;
+
+	if (!p->hugepage) {
+		mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		return mem == MAP_FAILED ? NULL : mem;
+	}
+
+#ifdef MAP_HUGETLB
+	mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (mem != MAP_FAILED)
+		return mem;
+#endif
+	/**
+	 * @brief transparent huge page가 적용될 수 있도록 HUGEPGSIZE만큼
+	 * 더 받은 후에 정렬이 맞지 않는 앞뒤를 돌려줍니다.
+	 */
+	mem = mmap(NULL, size + HUGEPGSIZE, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+		return NULL;
+	base = (char *)mem;
+	aligned = (char *)(((uintptr_t)base + HUGEPGSIZE - 1) &
+			   ~(uintptr_t)(HUGEPGSIZE - 1));
+	head = aligned - base;
+	tail = HUGEPGSIZE - head;
+	if (head)
+		munmap(base, head);
+	if (tail)
+		munmap(aligned + size, tail);
+#ifdef MADV_HUGEPAGE
+	madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+	return aligned;
+}
+
+/**
+ * @brief 새로운 slab을 받아옵니다.
+ *
+ * @return 받아온 slab, 실패 시 NULL
+ */
+static struct RTreeSlab *RTreeSlabNew(struct RTreePool *p)
+{
+	struct RTreeSlab *s;
+
+	s = (struct RTreeSlab *)malloc(sizeof(struct RTreeSlab));
+	if (!s)
+		return NULL;
+	s->mem = RTreeSlabMap(p);
+	if (!s->mem) {
+		free(s);
+		return NULL;
+	}
+	s->size = p->slabsize;
+	p->nslabs++;
+	return s;
+}
+
+/**
+ * @brief 새로운 slab을 나눠줄 영역으로 설정합니다.
+ *
+ * @details 예약해둔 slab이 있으면 그것을 먼저 사용합니다.
+ *
+ * @return 성공 시 0, 실패 시 -1
+ */
+static int RTreePoolGrow(struct RTreePool *p)
+{
+	struct RTreeSlab *s;
+
+	if (p->spare) {
+		s = p->spare;
+		p->spare = s->next;
+		p->nspare--;
+	} else if (!(s = RTreeSlabNew(p))) {
+		return -1;
+	}
+	s->next = p->slabs;
+	p->slabs = s;
+
+	p->bump = (char *)s->mem;
+	p->bump_end = p->bump + s->size;
+	return 0;
+}
+
+/**
+ * @brief 객체 하나를 할당합니다.
+ *
+ * @details free list에 객체가 있으면 재사용하고, 없으면 마지막 slab에서
+ * 잘라서 줍니다. 할당된 객체는 초기화되지 않습니다.
+ *
+ * @return 할당된 객체, 실패 시 NULL
+ */
+void *RTreePoolAlloc(struct RTreePool *p)
+{
+	void *obj;
+	assert(p);
+
+	if (p->free_list) {
+		obj = p->free_list;
+		p->free_list = *(void **)obj;
+		p->nfree--;
+	} else {
+		if ((size_t)(p->bump_end - p->bump) < p->objsize &&
+		    RTreePoolGrow(p))
+			return NULL;
+		obj = p->bump;
+		p->bump += p->objsize;
+	}
+	p->nused++;
+	return obj;
+}
+
+/**
+ * @brief 객체를 free list에 돌려줍니다. 메모리는 slab에 그대로 남아있습니다.
+ */
+void RTreePoolFree(struct RTreePool *p, void *obj)
+{
+	assert(p && obj);
+	assert(p->nused > 0);
+
+	*(void **)obj = p->free_list;
+	p->free_list = obj;
+	p->nused--;
+	p->nfree++;
+}
+
+/**
+ * @brief 이후의 할당 k번이 실패하지 않도록 slab을 미리 받아둡니다.
+ *
+ * @details 되돌리기 어려운 작업을 시작하기 전에 호출합니다. 미리 받은
+ * slab은 나눠주기 전까지 건드리지 않으므로 실제 메모리는 사용되지 않습니다.
+ *
+ * @param p 풀
+ * @param k 실패하지 않아야 하는 할당의 수
+ *
+ * @return 성공 시 0, 실패 시 -1
+ */
+int RTreePoolReserve(struct RTreePool *p, size_t k)
+{
+	struct RTreeSlab *s;
+	size_t avail, per = p->slabsize / p->objsize;
+
+	assert(p);
+	avail = p->nfree + (size_t)(p->bump_end - p->bump) / p->objsize +
+		p->nspare * per;
+	for (; avail < k; avail += per) {
+		s = RTreeSlabNew(p);
+		if (!s)
+			return -1;
+		s->next = p->spare;
+		p->spare = s;
+		p->nspare++;
+	}
+	return 0;
+}
+
+/**
+ * @brief 풀이 가진 모든 slab을 한 번에 운영체제로 돌려줍니다.
+ *
+ * @details 풀에서 할당된 객체들은 더 이상 사용할 수 없으며,
+ * 풀은 초기화 직후의 상태가 됩니다.
+ */
+void RTreePoolRelease(struct RTreePool *p)
+{
+	struct RTreeSlab *s;
+	assert(p);
+
+	while (p->slabs || p->spare) {
+		if (!p->slabs) {
+			p->slabs = p->spare;
+			p->spare = NULL;
+		}
+		s = p->slabs;
+		p->slabs = s->next;
+		munmap(s->mem, s->size);
+		free(s);
+	}
+	p->nslabs = p->nspare = 0;
+	p->nused = p->nfree = 0;
+	p->free_list = NULL;
+	p->bump = p->bump_end = NULL;
+}
+
+/**
+ * @brief 사용 중인 객체들이 차지하는 메모리의 크기를 반환합니다.
+ */
+size_t RTreePoolBytesInUse(struct RTreePool *p)
+{
+	assert(p);
+	return p->nused * p->objsize;
+}
+
+/**
+ * @brief slab으로 받아왔지만 사용 중이지 않은 메모리의 크기를 반환합니다.
+ */
+size_t RTreePoolBytesCached(struct RTreePool *p)
+{
+	assert(p);
+	return p->nslabs * p->slabsize - RTreePoolBytesInUse(p);
+}
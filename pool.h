@@ -0,0 +1,49 @@
+#ifndef __POOL__
+#define __POOL__
+
+#include <stddef.h>
+
+#define HUGEPGSIZE (2 * 1024 * 1024)
+
+/**
+ * @brief mmap으로 받아온 slab 하나에 대한 정보입니다.
+ */
+struct RTreeSlab {
+	struct RTreeSlab *next;
+	void *mem;
+	size_t size;
+};
+
+/**
+ * @brief 크기가 같은 객체들을 slab 단위로 할당하는 풀입니다.
+ *
+ * @details 해제된 객체는 객체의 앞부분을 next 포인터로 사용하는
+ * free list(intrusive free list)에 들어가서 다음 할당에 재사용됩니다.
+ * slab은 풀을 release 할 때 한 번에 운영체제로 돌려줍니다.
+ * RTreePoolReserve로 미리 받아둔 slab은 나눠주기 전까지 spare에 둡니다.
+ */
+struct RTreePool {
+	size_t objsize; /**< 정렬을 포함한 객체 하나의 크기 */
+	size_t slabsize; /**< slab 하나의 크기 */
+	int hugepage; /**< slab을 huge page로 받을 지 여부 */
+	void *free_list; /**< 해제된 객체들의 리스트 */
+	char *bump, *bump_end; /**< 마지막 slab에서 아직 나눠주지 않은 영역 */
+	struct RTreeSlab *slabs;
+	struct RTreeSlab *spare; /**< 예약만 하고 아직 나눠주지 않은 slab */
+	size_t nslabs; /**< 할당받은 slab의 수 (spare 포함) */
+	size_t nspare; /**< spare에 있는 slab의 수 */
+	size_t nused; /**< 사용 중인 객체의 수 */
+	size_t nfree; /**< free list에 있는 객체의 수 */
+};
+
+extern void RTreePoolInit(struct RTreePool *, size_t objsize, size_t align,
+			  size_t slabsize);
+extern void RTreePoolSetHugePage(struct RTreePool *, int);
+extern void *RTreePoolAlloc(struct RTreePool *);
+extern void RTreePoolFree(struct RTreePool *, void *);
+extern int RTreePoolReserve(struct RTreePool *, size_t);
+extern void RTreePoolRelease(struct RTreePool *);
+extern size_t RTreePoolBytesInUse(struct RTreePool *);
+extern size_t RTreePoolBytesCached(struct RTreePool *);
+
+#endif
@@ -7,6 +7,14 @@
 #include <float.h>
 #include <math.h>
 
+#ifdef RTREE_SOA
+#if defined(__AVX__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#endif
+
 #define BIG_NUM (FLT_MAX / 4.0)
 
 #define Undefined(x) ((x)->boundary[0] > (x)->boundary[NUMDIMS])
@@ -61,7 +69,7 @@ const double UnitSphereVolumes[] = {
  *
  * @return 담당하는 공간의 크기
  */
-RectReal RTreeRectSphericalVolume(struct Rect *R)
+RectArea RTreeRectSphericalVolume(struct Rect *R)
 {
 	register struct Rect *r = R;
 	register int i;
@@ -69,14 +77,151 @@ RectReal RTreeRectSphericalVolume(struct Rect *R)
 
 	assert(r);
 	if (Undefined(r))
-		return (RectReal)0;
+		return (RectArea)0;
 	for (i = 0; i < NUMDIMS; i++) {
 		double half_extent =
-			(r->boundary[i + NUMDIMS] - r->boundary[i]) / 2;
+			((double)r->boundary[i + NUMDIMS] - r->boundary[i]) / 2;
 		sum_of_squares += half_extent * half_extent;
 	}
 	radius = sqrt(sum_of_squares);
-	return (RectReal)(pow(radius, NUMDIMS) * UnitSphereVolume);
+	return (RectArea)(pow(radius, NUMDIMS) * UnitSphereVolume);
+}
+
+/**
+ * @brief RTreeRectSphericalVolume의 빠른 근사값을 반환합니다.
+ *
+ * @details 가장 긴 변을 지름으로 하는 구의 부피이므로 sqrt가 필요 없습니다.
+ *
+ * @param R 현재 사각형의 값
+ *
+ * @return 근사한 구의 부피
+ */
+RectArea RTreeRectFastSphericalVolume(struct Rect *R)
+{
+	register struct Rect *r = R;
+	register int i;
+	register double maxsize = 0, size;
+
+	assert(r);
+	if (Undefined(r))
+		return (RectArea)0;
+	for (i = 0; i < NUMDIMS; i++) {
+		size = (double)r->boundary[i + NUMDIMS] - r->boundary[i];
+		if (size > maxsize)
+			maxsize = size;
+	}
+	return (RectArea)(pow(maxsize / 2, NUMDIMS) * UnitSphereVolume);
+}
+
+/**
+ * @brief 사각형의 N차원 겉넓이를 반환합니다.
+ *
+ * @details 차원마다 나머지 차원의 길이의 곱을 더한 값의 두 배입니다.
+ * 2차원에서는 둘레에 해당하므로 한쪽으로 납작한 사각형도 0이 되지 않습니다.
+ *
+ * @param R 현재 사각형의 값
+ *
+ * @return 겉넓이
+ */
+RectArea RTreeRectSurfaceArea(struct Rect *R)
+{
+	register struct Rect *r = R;
+	register int i, j;
+	register RectArea face, sum = (RectArea)0;
+
+	assert(r);
+	if (Undefined(r))
+		return (RectArea)0;
+	for (i = 0; i < NUMDIMS; i++) {
+		face = (RectArea)1;
+		for (j = 0; j < NUMDIMS; j++)
+			if (j != i)
+				face *= (RectArea)r->boundary[j + NUMDIMS] -
+					r->boundary[j];
+		sum += face;
+	}
+	return 2 * sum;
+}
+
+/**
+ * @brief 사각형의 N차원 부피(box volume)를 반환합니다.
+ *
+ * @param R 현재 사각형의 값
+ *
+ * @return 각 차원의 길이의 곱
+ */
+RectArea RTreeRectArea(struct Rect *R)
+{
+	register struct Rect *r = R;
+	register int i;
+	register RectArea volume = (RectArea)1;
+
+	assert(r);
+	if (Undefined(r))
+		return (RectArea)0;
+	for (i = 0; i < NUMDIMS; i++)
+		volume *= (RectArea)r->boundary[i + NUMDIMS] - r->boundary[i];
+	return volume;
+}
+
+/**
+ * @brief 사각형의 margin(각 차원의 길이의 합)을 반환합니다.
+ *
+ * @details R*-tree의 분할에서 정사각형에 가까운 노드를 고르는 데 사용합니다.
+ *
+ * @param R 현재 사각형의 값
+ *
+ * @return 각 차원의 길이의 합
+ */
+RectArea RTreeRectMargin(struct Rect *R)
+{
+	register struct Rect *r = R;
+	register int i;
+	register RectArea margin = (RectArea)0;
+
+	assert(r);
+	if (Undefined(r))
+		return (RectArea)0;
+	for (i = 0; i < NUMDIMS; i++)
+		margin += (RectArea)r->boundary[i + NUMDIMS] - r->boundary[i];
+	return margin;
+}
+
+/**
+ * @brief enum RTreeAreaMetric 순서의 척도 함수들입니다.
+ */
+RectArea (*const RTreeMetrics[METRICS])(struct Rect *) = {
+	RTreeRectSphericalVolume,
+	RTreeRectArea,
+	RTreeRectSurfaceArea,
+	RTreeRectFastSphericalVolume,
+};
+
+/**
+ * @brief 두 사각형이 겹치는 부분의 부피를 반환합니다.
+ *
+ * @param R 사각형 1
+ * @param S 사각형 2
+ *
+ * @return 겹치는 부분의 부피, 겹치지 않는 경우 0
+ */
+RectArea RTreeOverlapArea(struct Rect *R, struct Rect *S)
+{
+	register struct Rect *r = R, *s = S;
+	register int i, j;
+	register RectReal lo, hi;
+	register RectArea volume = (RectArea)1;
+
+	assert(r && s);
+	for (i = 0; i < NUMDIMS; i++) {
+		j = i + NUMDIMS;
+		lo = MAX(r->boundary[i], s->boundary[i]);
+		hi = MIN(r->boundary[j], s->boundary[j]);
+		if (lo >= hi)
+			return (RectArea)0;
+		volume *= (RectArea)hi - lo;
+	}
+	return volume;
 }
 
 /**
@@ -131,3 +276,196 @@ int RTreeOverlap(struct Rect *R, struct Rect *S)
 	}
 	return TRUE;
 }
+
+/**
+ * @brief 사각형 R이 사각형 S 안에 완전히 들어가는 지를 확인합니다.
+ *
+ * @param R 안쪽 사각형
+ * @param S 바깥쪽 사각형
+ *
+ * @return R의 모든 점이 S 안에 있으면 TRUE
+ */
+int RTreeContained(struct Rect *R, struct Rect *S)
+{
+	register struct Rect *r = R, *s = S;
+	register int i, j;
+	assert(r && s);
+
+	for (i = 0; i < NUMDIMS; i++) {
+		j = i + NUMDIMS;
+		if (r->boundary[i] < s->boundary[i] ||
+		    r->boundary[j] > s->boundary[j])
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * @brief 점에서 사각형까지의 가장 가까운 거리의 제곱을 구합니다.
+ *
+ * @details 사각형 안의 어떤 점까지의 거리의 제곱도 이 값보다 작지 않습니다.
+ * 점이 사각형 안에 있으면 0입니다.
+ *
+ * @param R 사각형
+ * @param p 점의 좌표 (NUMDIMS개)
+ *
+ * @return 거리의 제곱
+ */
+RectDist RTreeMinDist2(struct Rect *R, RectReal *p)
+{
+	register struct Rect *r = R;
+	register int i;
+	register RectDist d, sum = 0;
+	assert(r && p);
+
+	for (i = 0; i < NUMDIMS; i++) {
+		if (p[i] < r->boundary[i])
+			d = (RectDist)r->boundary[i] - p[i];
+		else if (p[i] > r->boundary[i + NUMDIMS])
+			d = (RectDist)p[i] - r->boundary[i + NUMDIMS];
+		else
+			d = 0;
+		sum += d * d;
+	}
+	return sum;
+}
+
+/**
+ * @brief 점에서 사각형까지의 가장 먼 거리의 제곱을 구합니다.
+ *
+ * @details 차원마다 더 먼 쪽의 경계를 고르므로 사각형 안의 어떤 점까지의
+ * 거리의 제곱도 이 값보다 크지 않습니다.
+ *
+ * @param R 사각형
+ * @param p 점의 좌표 (NUMDIMS개)
+ *
+ * @return 거리의 제곱
+ */
+RectDist RTreeMaxDist2(struct Rect *R, RectReal *p)
+{
+	register struct Rect *r = R;
+	register int i;
+	register RectDist lo, hi, sum = 0;
+	assert(r && p);
+
+	for (i = 0; i < NUMDIMS; i++) {
+		lo = (RectDist)p[i] - r->boundary[i];
+		hi = (RectDist)r->boundary[i + NUMDIMS] - p[i];
+		lo = lo < 0 ? -lo : lo;
+		hi = hi < 0 ? -hi : hi;
+		sum += MAX(lo, hi) * MAX(lo, hi);
+	}
+	return sum;
+}
+
+#ifdef RTREE_SOA
+_Static_assert(MAXCARD <= 64, "RTreeOverlapMask needs MAXCARD <= 64");
+
+/**
+ * @brief 노드의 브랜치들 중 사각형과 겹치는 것들을 한 번에 구합니다.
+ *
+ * @details 노드의 차원별 경계값 배열(bound)을 사용해서 AVX로는 4개,
+ * SSE2로는 2개의 브랜치를 한 명령어로 검사합니다. RTREE_INTCOORD로 빌드하면
+ * 정수 비교를 사용해서 AVX2로는 8개, SSE2로는 4개씩 검사합니다.
+ * 남는 브랜치는 RTreeOverlap과 같은 방식으로 하나씩 검사합니다.
+ *
+ * @param N 검사할 노드
+ * @param R 겹침을 확인할 사각형
+ * @param count 검사할 브랜치의 수
+ *
+ * @return i번째 브랜치가 겹치는 경우 i번째 비트가 1인 마스크
+ */
+uint64_t RTreeOverlapMask(struct Node *N, struct Rect *R, int count)
+{
+	register struct Node *n = N;
+	register struct Rect *r = R;
+	register int i = 0, d;
+	uint64_t mask = 0;
+	int hit;
+	assert(n && r);
+	assert(count <= MAXCARD);
+
+#ifdef RTREE_INTCOORD
+	/**
+	 * @brief 정수에는 lo <= qhi 비교가 없으므로 겹치지 않는 조건
+	 * lo > qhi 또는 qlo > hi를 모아서 뒤집습니다.
+	 */
+#if defined(__AVX2__)
+	for (; i + 8 <= count; i += 8) {
+		__m256i miss = _mm256_setzero_si256();
+		for (d = 0; d < NUMDIMS; d++) {
+			__m256i lo = _mm256_loadu_si256(
+				(const __m256i *)&n->bound[d][i]);
+			__m256i hi = _mm256_loadu_si256(
+				(const __m256i *)&n->bound[d + NUMDIMS][i]);
+			__m256i qlo = _mm256_set1_epi32(r->boundary[d]);
+			__m256i qhi =
+				_mm256_set1_epi32(r->boundary[d + NUMDIMS]);
+			miss = _mm256_or_si256(miss,
+					       _mm256_cmpgt_epi32(lo, qhi));
+			miss = _mm256_or_si256(miss,
+					       _mm256_cmpgt_epi32(qlo, hi));
+		}
+		hit = _mm256_movemask_ps(_mm256_castsi256_ps(miss));
+		mask |= (uint64_t)(~hit & 0xff) << i;
+	}
+#elif defined(__SSE2__)
+	for (; i + 4 <= count; i += 4) {
+		__m128i miss = _mm_setzero_si128();
+		for (d = 0; d < NUMDIMS; d++) {
+			__m128i lo = _mm_loadu_si128(
+				(const __m128i *)&n->bound[d][i]);
+			__m128i hi = _mm_loadu_si128(
+				(const __m128i *)&n->bound[d + NUMDIMS][i]);
+			__m128i qlo = _mm_set1_epi32(r->boundary[d]);
+			__m128i qhi = _mm_set1_epi32(r->boundary[d + NUMDIMS]);
+			miss = _mm_or_si128(miss, _mm_cmpgt_epi32(lo, qhi));
+			miss = _mm_or_si128(miss, _mm_cmpgt_epi32(qlo, hi));
+		}
+		hit = _mm_movemask_ps(_mm_castsi128_ps(miss));
+		mask |= (uint64_t)(~hit & 0xf) << i;
+	}
+#endif
+#elif defined(__AVX__)
+	for (; i + 4 <= count; i += 4) {
+		__m256d hits = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+		for (d = 0; d < NUMDIMS; d++) {
+			__m256d lo = _mm256_loadu_pd(&n->bound[d][i]);
+			__m256d hi = _mm256_loadu_pd(&n->bound[d + NUMDIMS][i]);
+			__m256d qlo = _mm256_set1_pd(r->boundary[d]);
+			__m256d qhi = _mm256_set1_pd(r->boundary[d + NUMDIMS]);
+			hits = _mm256_and_pd(hits,
+					     _mm256_cmp_pd(lo, qhi, _CMP_LE_OQ));
+			hits = _mm256_and_pd(hits,
+					     _mm256_cmp_pd(qlo, hi, _CMP_LE_OQ));
+		}
+		mask |= (uint64_t)_mm256_movemask_pd(hits) << i;
+	}
+#elif defined(__SSE2__)
+	for (; i + 2 <= count; i += 2) {
+		__m128d hits = _mm_castsi128_pd(_mm_set1_epi64x(-1));
+		for (d = 0; d < NUMDIMS; d++) {
+			__m128d lo = _mm_loadu_pd(&n->bound[d][i]);
+			__m128d hi = _mm_loadu_pd(&n->bound[d + NUMDIMS][i]);
+			__m128d qlo = _mm_set1_pd(r->boundary[d]);
+			__m128d qhi = _mm_set1_pd(r->boundary[d + NUMDIMS]);
+			hits = _mm_and_pd(hits, _mm_cmple_pd(lo, qhi));
+			hits = _mm_and_pd(hits, _mm_cmple_pd(qlo, hi));
+		}
+		mask |= (uint64_t)_mm_movemask_pd(hits) << i;
+	}
+#endif
+	for (; i < count; i++) {
+		hit = 1;
+		for (d = 0; d < NUMDIMS; d++) {
+			if (n->bound[d][i] > r->boundary[d + NUMDIMS] ||
+			    r->boundary[d] > n->bound[d + NUMDIMS][i]) {
+				hit = 0;
+				break;
+			}
+		}
+		mask |= (uint64_t)hit << i;
+	}
+	return mask;
+}
+#endif
@@ -1,36 +1,38 @@
 
-#include "split_l.h"
+#include "index.h"
 #include "assert.h"
 #include "card.h"
-#include "index.h"
 #include <stdio.h>
 
 /**
  * @brief 꽉찬 노드로 부터 브랜치들을 브랜치 버퍼로 가져와서 추가적인 브랜치에 추가하도록 합니다.
  *
+ * @param t 트리에 해당합니다. 트리의 분할 작업 공간을 사용합니다.
  * @param N 꽉찬 노드를 가리킵니다.
  * @param B 추가적인 브랜치에 해당합니다.
  */
-static void RTreeGetBranches(struct Node *N, struct Branch *B)
+static void RTreeGetBranches(struct RTree *t, struct Node *N, struct Branch *B)
 {
 	register struct Node *n = N;
 	register struct Branch *b = B;
+	register struct SplitVars *s = &t->split;
 	register int i;
 
 	assert(n);
 	assert(b);
 
-	for (i = 0; i < MAXKIDS(n); i++) { /**< 브랜치 버퍼로 가져옵니다. */
-		assert(n->branch[i].child); /**< 엔트리가 꽉 찼는지 확인 */
-		BranchBuf[i] = n->branch[i];
+	for (i = 0; i < MAXKIDS(t, n); i++) { /**< 브랜치 버퍼로 가져옵니다. */
+		RTreeGetBranch(n, i, &s->BranchBuf[i]);
+		assert(s->BranchBuf[i].child); /**< 엔트리가 꽉 찼는지 확인 */
 	}
-	BranchBuf[MAXKIDS(n)] = *b; /**< 추가적인 브랜치를 넣어줍니다. */
-	BranchCount = MAXKIDS(n) + 1;
+	s->BranchBuf[MAXKIDS(t, n)] = *b; /**< 추가적인 브랜치를 넣어줍니다. */
+	s->BranchCount = MAXKIDS(t, n) + 1;
 
 	/* 집합에 있는 모든 Recctangle에 대해 계산합니다.*/
-	CoverSplit = BranchBuf[0].rect;
-	for (i = 1; i < MAXKIDS(n) + 1; i++) {
-		CoverSplit = RTreeCombineRect(&CoverSplit, &BranchBuf[i].rect);
+	s->CoverSplit = s->BranchBuf[0].rect;
+	for (i = 1; i < MAXKIDS(t, n) + 1; i++) {
+		s->CoverSplit = RTreeCombineRect(&s->CoverSplit,
+						 &s->BranchBuf[i].rect);
 	}
 
 	RTreeInitNode(n);
@@ -61,12 +63,16 @@ static void RTreeInitPVars(struct PartitionVars *P, int maxrects, int minfill)
 /**
  * @brief 그룹 중 하나에 브랜치를 넣어주도록 합니다.
  *
+ * @param t 트리에 해당합니다.
  * @param i seed의 번호에 해당합니다.
  * @param group 그룹 번호에 해당합니다.
  * @param p 현재의 PartitionVars 포인터에 해당합니다.
  */
-static void RTreeClassify(int i, int group, struct PartitionVars *p)
+static void RTreeClassify(struct RTree *t, int i, int group,
+			  struct PartitionVars *p)
 {
+	struct Branch *buf = t->split.BranchBuf;
+
 	assert(p);
 	assert(!p->taken[i]);
 
@@ -74,11 +80,11 @@ static void RTreeClassify(int i, int group, struct PartitionVars *p)
 	p->taken[i] = TRUE;
 
 	if (p->count[group] == 0)
-		p->cover[group] = BranchBuf[i].rect;
+		p->cover[group] = buf[i].rect;
 	else
 		p->cover[group] =
-			RTreeCombineRect(&BranchBuf[i].rect, &p->cover[group]);
-	p->area[group] = RTreeRectSphericalVolume(&p->cover[group]);
+			RTreeCombineRect(&buf[i].rect, &p->cover[group]);
+	p->area[group] = RTreeVolume(t, &p->cover[group]);
 	p->count[group]++;
 }
 
@@ -89,15 +95,17 @@ static void RTreeClassify(int i, int group, struct PartitionVars *p)
  * 분리와 겹침의 거리는 현재 차원에서의 모든 집합 공간에서의 폭(width)에 modulo한 값으로
  * 설정됩니다.
  *
+ * @param t 트리에 해당합니다.
  * @param P 파티션 변수 포인터
  */
-static void RTreePickSeeds(struct PartitionVars *P)
+static void RTreePickSeeds(struct RTree *t, struct PartitionVars *P)
 {
 	register struct PartitionVars *p = P;
+	register struct Branch *buf = t->split.BranchBuf;
 	register int i, dim, high;
 	register struct Rect *r, *rlow, *rhigh;
 	register float w, separation, bestSep;
-	RectReal width[NUMDIMS];
+	RectArea width[NUMDIMS];
 	int leastUpper[NUMDIMS], greatestLower[NUMDIMS];
 	int seed0, seed1;
 	assert(p);
@@ -109,14 +117,14 @@ static void RTreePickSeeds(struct PartitionVars *P)
 		 * @brief 현재 차원에서 각 방향에서 가장 먼 사각형들을  찾습니다.
 		 */
 		greatestLower[dim] = leastUpper[dim] = 0;
-		for (i = 1; i < NODECARD + 1; i++) {
-			r = &BranchBuf[i].rect;
+		for (i = 1; i < p->total; i++) {
+			r = &buf[i].rect;
 			if (r->boundary[dim] >
-			    BranchBuf[greatestLower[dim]].rect.boundary[dim]) {
+			    buf[greatestLower[dim]].rect.boundary[dim]) {
 				greatestLower[dim] = i;
 			}
 			if (r->boundary[high] <
-			    BranchBuf[leastUpper[dim]].rect.boundary[high]) {
+			    buf[leastUpper[dim]].rect.boundary[high]) {
 				leastUpper[dim] = i;
 			}
 		}
@@ -124,8 +132,8 @@ static void RTreePickSeeds(struct PartitionVars *P)
 		/**
 		 * @brief 현재 차원에서의 모든 집합의 폭을 구합니다.
 		 */
-		width[dim] =
-			CoverSplit.boundary[high] - CoverSplit.boundary[dim];
+		width[dim] = (RectArea)t->split.CoverSplit.boundary[high] -
+			     t->split.CoverSplit.boundary[dim];
 	}
 
 	/**
@@ -137,20 +145,21 @@ static void RTreePickSeeds(struct PartitionVars *P)
 
 		assert(width[dim] >= 0);
 		if (width[dim] == 0)
-			w = (RectReal)1;
+			w = (RectArea)1;
 		else
 			w = width[dim];
 
-		rlow = &BranchBuf[leastUpper[dim]].rect;
-		rhigh = &BranchBuf[greatestLower[dim]].rect;
+		rlow = &buf[leastUpper[dim]].rect;
+		rhigh = &buf[greatestLower[dim]].rect;
 		if (dim == 0) {
 			seed0 = leastUpper[0];
 			seed1 = greatestLower[0];
 			separation = bestSep =
-				(rhigh->boundary[0] - rlow->boundary[NUMDIMS]) /
+				((RectArea)rhigh->boundary[0] -
+				 rlow->boundary[NUMDIMS]) /
 				w;
 		} else {
-			separation = (rhigh->boundary[dim] -
+			separation = ((RectArea)rhigh->boundary[dim] -
 				      rlow->boundary[dim + NUMDIMS]) /
 				     w;
 			if (separation > bestSep) {
@@ -162,8 +171,8 @@ static void RTreePickSeeds(struct PartitionVars *P)
 	}
 
 	if (seed0 != seed1) {
-		RTreeClassify(seed0, 0, p);
-		RTreeClassify(seed1, 1, p);
+		RTreeClassify(t, seed0, 0, p);
+		RTreeClassify(t, seed1, 1, p);
 	}
 }
 
@@ -174,25 +183,27 @@ static void RTreePickSeeds(struct PartitionVars *P)
  * 모든 비둘기 집에 한 마리 이상의 비둘기 들어갔다고하면 어느 집에는
  * 2 마리 이상의 비둘기가 들어갔다"를 의미합니다.
  *
+ * @param t 트리에 해당합니다.
  * @param P 현재 PartitionVars 구조체에 해당합니다.
  */
-static void RTreePigeonhole(struct PartitionVars *P)
+static void RTreePigeonhole(struct RTree *t, struct PartitionVars *P)
 {
 	register struct PartitionVars *p = P;
+	register struct Branch *buf = t->split.BranchBuf;
 	struct Rect newCover[2];
 	register int i, group;
-	RectReal newArea[2], increase[2];
+	RectArea newArea[2], increase[2];
 
-	for (i = 0; i < NODECARD + 1; i++) {
+	for (i = 0; i < p->total; i++) {
 		if (!p->taken[i]) {
 			/**
 			 * @brief 하나의 그룹이 가득 찬 경우 다른 그룹에 사각형을 넣습니다.
 			 */
 			if (p->count[0] >= p->total - p->minfill) {
-				RTreeClassify(i, 1, p);
+				RTreeClassify(t, i, 1, p);
 				continue;
 			} else if (p->count[1] >= p->total - p->minfill) {
-				RTreeClassify(i, 0, p);
+				RTreeClassify(t, i, 0, p);
 				continue;
 			}
 
@@ -203,12 +214,11 @@ static void RTreePigeonhole(struct PartitionVars *P)
 			for (group = 0; group < 2; group++) {
 				if (p->count[group] > 0)
 					newCover[group] = RTreeCombineRect(
-						&BranchBuf[i].rect,
-						&p->cover[group]);
+						&buf[i].rect, &p->cover[group]);
 				else
-					newCover[group] = BranchBuf[i].rect;
-				newArea[group] = RTreeRectSphericalVolume(
-					&newCover[group]);
+					newCover[group] = buf[i].rect;
+				newArea[group] =
+					RTreeVolume(t, &newCover[group]);
 				increase[group] =
 					newArea[group] - p->area[group];
 			}
@@ -217,53 +227,371 @@ static void RTreePigeonhole(struct PartitionVars *P)
 			 * @brief 그룹 안의 사각형 중 확장량이 최소한인 것을 넣습니다.
 			 */
 			if (increase[0] < increase[1])
-				RTreeClassify(i, 0, p);
+				RTreeClassify(t, i, 0, p);
 			else if (increase[1] < increase[0])
-				RTreeClassify(i, 1, p);
+				RTreeClassify(t, i, 1, p);
 
 			/**
 			 * @brief 그룹 안의 사각형 중 최대한 적게 포함하는 것을 넣습니다.
 			 */
 			else if (p->area[0] < p->area[1])
-				RTreeClassify(i, 0, p);
+				RTreeClassify(t, i, 0, p);
 			else if (p->area[1] < p->area[0])
-				RTreeClassify(i, 1, p);
+				RTreeClassify(t, i, 1, p);
 
 			/**
 			 * @brief 그룹 안의 사각형 중에 가장 적은 원소를 가진 그룹을 넣습니다.
 			 */
 			else if (p->count[0] < p->count[1])
-				RTreeClassify(i, 0, p);
+				RTreeClassify(t, i, 0, p);
 			else
-				RTreeClassify(i, 1, p);
+				RTreeClassify(t, i, 1, p);
 		}
 	}
-	assert(p->count[0] + p->count[1] == NODECARD + 1);
+	assert(p->count[0] + p->count[1] == p->total);
 }
 
 /**
  * @brief 파티션을 찾는 0번째 방법입니다.
  *
+ * @param t 트리에 해당합니다.
+ * @param p 찾은 파티션 값이 들어갑니다.
+ * @param minfill 최소 차야하는 값입니다.
+ */
+static void RTreeMethodZero(struct RTree *t, struct PartitionVars *p,
+			    int minfill)
+{
+	RTreeInitPVars(p, t->split.BranchCount, minfill);
+	RTreePickSeeds(t, p);
+	RTreePigeonhole(t, p);
+}
+
+/**
+ * @brief 버퍼의 브랜치 번호들을 한 차원의 경계값으로 정렬합니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param order 정렬할 브랜치 번호들
+ * @param n 브랜치의 수
+ * @param side 먼저 비교할 경계값 (dim 또는 dim + NUMDIMS)
+ */
+static void RTreeSortBuf(struct RTree *t, int *order, int n, int side)
+{
+	register struct Branch *buf = t->split.BranchBuf;
+	register int i, j, k;
+	int other = side < NUMDIMS ? side + NUMDIMS : side - NUMDIMS;
+	struct Rect *r;
+
+	for (i = 0; i < n; i++) {
+		r = &buf[i].rect;
+		for (j = i; j > 0; j--) {
+			k = order[j - 1];
+			if (buf[k].rect.boundary[side] < r->boundary[side] ||
+			    (buf[k].rect.boundary[side] == r->boundary[side] &&
+			     buf[k].rect.boundary[other] <= r->boundary[other]))
+				break;
+			order[j] = k;
+		}
+		order[j] = i;
+	}
+}
+
+/**
+ * @brief 정렬된 브랜치들의 앞쪽 k개와 뒤쪽 total - k개를 감싸는 사각형을 구합니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param order 정렬된 브랜치 번호들
+ * @param n 브랜치의 수
+ * @param head head[k]에 앞쪽 k개를 감싸는 사각형이 들어갑니다.
+ * @param tail tail[k]에 뒤쪽 n - k개를 감싸는 사각형이 들어갑니다.
+ */
+static void RTreeSplitCovers(struct RTree *t, int *order, int n,
+			     struct Rect *head, struct Rect *tail)
+{
+	register struct Branch *buf = t->split.BranchBuf;
+	register int k;
+
+	head[1] = buf[order[0]].rect;
+	for (k = 2; k < n; k++)
+		head[k] = RTreeCombineRect(&head[k - 1], &buf[order[k - 1]].rect);
+	tail[n - 1] = buf[order[n - 1]].rect;
+	for (k = n - 2; k > 0; k--)
+		tail[k] = RTreeCombineRect(&tail[k + 1], &buf[order[k]].rect);
+}
+
+/**
+ * @brief 파티션을 찾는 R*-tree의 방법입니다.
+ *
+ * @details 차원마다 하한과 상한으로 정렬한 후에 가능한 모든 분할에 대해서
+ * margin의 합이 가장 작은 차원을 고릅니다. 그 차원에서는 두 그룹의 겹치는
+ * 부피가 가장 작은 분할을, 같으면 부피의 합이 가장 작은 분할을 고릅니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param p 찾은 파티션 값이 들어갑니다.
+ * @param minfill 최소 차야하는 값입니다.
+ */
+static void RTreeMethodRStar(struct RTree *t, struct PartitionVars *p,
+			     int minfill)
+{
+	struct Rect head[ANYMAXCARD + 1], tail[ANYMAXCARD + 1];
+	int order[ANYMAXCARD + 1];
+	register int side, k;
+	int n = t->split.BranchCount, bestSide = 0, bestSplit = minfill;
+	int dim, bestDim = 0;
+	RectArea margin, bestMargin = 0, overlap, bestOverlap = 0, area,
+			     bestArea = 0;
+
+	RTreeInitPVars(p, n, minfill);
+	if (minfill < 1)
+		minfill = 1;
+
+	/**
+	 * @brief margin의 합이 가장 작은 차원을 고릅니다.
+	 */
+	for (dim = 0; dim < NUMDIMS; dim++) {
+		margin = 0;
+		for (side = dim; side < NUMSIDES; side += NUMDIMS) {
+			RTreeSortBuf(t, order, n, side);
+			RTreeSplitCovers(t, order, n, head, tail);
+			for (k = minfill; k <= n - minfill; k++)
+				margin += RTreeRectMargin(&head[k]) +
+					  RTreeRectMargin(&tail[k]);
+		}
+		if (dim == 0 || margin < bestMargin) {
+			bestMargin = margin;
+			bestDim = dim;
+		}
+	}
+
+	/**
+	 * @brief 고른 차원에서 겹침이 가장 작은 분할을 고릅니다.
+	 */
+	for (side = bestDim; side < NUMSIDES; side += NUMDIMS) {
+		RTreeSortBuf(t, order, n, side);
+		RTreeSplitCovers(t, order, n, head, tail);
+		for (k = minfill; k <= n - minfill; k++) {
+			overlap = RTreeOverlapArea(&head[k], &tail[k]);
+			area = RTreeRectArea(&head[k]) + RTreeRectArea(&tail[k]);
+			if ((side == bestDim && k == minfill) ||
+			    overlap < bestOverlap ||
+			    (overlap == bestOverlap && area < bestArea)) {
+				bestOverlap = overlap;
+				bestArea = area;
+				bestSide = side;
+				bestSplit = k;
+			}
+		}
+	}
+
+	RTreeSortBuf(t, order, n, bestSide);
+	for (k = 0; k < n; k++)
+		RTreeClassify(t, order[k], k < bestSplit ? 0 : 1, p);
+}
+
+/**
+ * @brief Guttman의 quadratic split에서 2개의 seed를 고릅니다.
+ *
+ * @details 둘을 감싸는 사각형에서 각자의 부피를 뺀 낭비가 가장 큰 쌍을
+ * 고릅니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param p 파티션 변수 포인터
+ */
+static void RTreeQuadraticSeeds(struct RTree *t, struct PartitionVars *p)
+{
+	register struct Branch *buf = t->split.BranchBuf;
+	register int i, j;
+	RectArea area[ANYMAXCARD + 1], waste, worst = 0;
+	struct Rect tmp_rect;
+	int seed0 = 0, seed1 = 1;
+
+	for (i = 0; i < p->total; i++)
+		area[i] = RTreeVolume(t, &buf[i].rect);
+	for (i = 0; i < p->total - 1; i++) {
+		for (j = i + 1; j < p->total; j++) {
+			tmp_rect = RTreeCombineRect(&buf[i].rect, &buf[j].rect);
+			waste = RTreeVolume(t, &tmp_rect) - area[i] - area[j];
+			if ((i == 0 && j == 1) || waste > worst) {
+				worst = waste;
+				seed0 = i;
+				seed1 = j;
+			}
+		}
+	}
+	RTreeClassify(t, seed0, 0, p);
+	RTreeClassify(t, seed1, 1, p);
+}
+
+/**
+ * @brief 파티션을 찾는 Guttman의 quadratic 방법입니다.
+ *
+ * @details 남은 브랜치 중에서 두 그룹의 부피 증가량의 차이가 가장 큰 것을
+ * 먼저 증가량이 작은 그룹에 넣습니다. 증가량이 같으면 부피가 작은 그룹,
+ * 그것도 같으면 브랜치가 적은 그룹에 넣습니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param p 찾은 파티션 값이 들어갑니다.
+ * @param minfill 최소 차야하는 값입니다.
+ */
+static void RTreeMethodQuadratic(struct RTree *t, struct PartitionVars *p,
+				 int minfill)
+{
+	register struct Branch *buf = t->split.BranchBuf;
+	register int i, group;
+	struct Rect tmp_rect;
+	RectArea increase[2], diff, bestDiff;
+	int best, chosen;
+
+	RTreeInitPVars(p, t->split.BranchCount, minfill);
+	RTreeQuadraticSeeds(t, p);
+
+	while (p->count[0] + p->count[1] < p->total) {
+		/**
+		 * @brief 하나의 그룹이 가득 찬 경우 나머지는 모두 다른 그룹에 넣습니다.
+		 */
+		if (p->count[0] >= p->total - p->minfill ||
+		    p->count[1] >= p->total - p->minfill) {
+			group = p->count[0] >= p->total - p->minfill;
+			for (i = 0; i < p->total; i++)
+				if (!p->taken[i])
+					RTreeClassify(t, i, group, p);
+			break;
+		}
+
+		best = -1;
+		bestDiff = 0;
+		chosen = 0;
+		for (i = 0; i < p->total; i++) {
+			if (p->taken[i])
+				continue;
+			for (group = 0; group < 2; group++) {
+				tmp_rect = RTreeCombineRect(&buf[i].rect,
+							    &p->cover[group]);
+				increase[group] = RTreeVolume(t, &tmp_rect) -
+						  p->area[group];
+			}
+			diff = increase[0] - increase[1];
+			if (diff < 0)
+				diff = -diff;
+			if (best < 0 || diff > bestDiff) {
+				best = i;
+				bestDiff = diff;
+				if (increase[0] != increase[1])
+					chosen = increase[1] < increase[0];
+				else if (p->area[0] != p->area[1])
+					chosen = p->area[1] < p->area[0];
+				else
+					chosen = p->count[1] < p->count[0];
+			}
+		}
+		RTreeClassify(t, best, chosen, p);
+	}
+	assert(p->count[0] + p->count[1] == p->total);
+}
+
+/**
+ * @brief 키 값이 작은 순서로 브랜치 번호들을 정렬합니다.
+ */
+static void RTreeSortKeys(int *order, RectDist *key, int n)
+{
+	register int i, j;
+
+	for (i = 0; i < n; i++) {
+		for (j = i; j > 0 && key[order[j - 1]] > key[i]; j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+	}
+}
+
+/**
+ * @brief 파티션을 찾는 Ang과 Tan의 linear 방법입니다.
+ *
+ * @details 차원마다 각 브랜치를 노드의 아래쪽 경계와 위쪽 경계 중 더 가까운
+ * 쪽의 그룹으로 나눕니다. 두 그룹의 크기가 가장 고른 차원을 고르고, 같으면
+ * 두 그룹의 겹치는 부피가, 그것도 같으면 부피의 합이 작은 차원을 고릅니다.
+ * 한 그룹이 minfill보다 작아지면 경계에 가까운 브랜치부터 옮겨서 맞춥니다.
+ *
+ * @param t 트리에 해당합니다.
  * @param p 찾은 파티션 값이 들어갑니다.
  * @param minfill 최소 차야하는 값입니다.
  */
-static void RTreeMethodZero(struct PartitionVars *p, int minfill)
+static void RTreeMethodAngTan(struct RTree *t, struct PartitionVars *p,
+			      int minfill)
 {
-	RTreeInitPVars(p, BranchCount, minfill);
-	RTreePickSeeds(p);
-	RTreePigeonhole(p);
+	register struct Branch *buf = t->split.BranchBuf;
+	register struct Rect *cover = &t->split.CoverSplit;
+	RectDist key[NUMDIMS][ANYMAXCARD + 1];
+	int order[NUMDIMS][ANYMAXCARD + 1], split[NUMDIMS];
+	struct Rect head[ANYMAXCARD + 1], tail[ANYMAXCARD + 1];
+	register int i, dim;
+	int n = t->split.BranchCount, low, worst, bestWorst = 0, bestDim = 0;
+	RectArea overlap, bestOverlap = 0, area, bestArea = 0;
+
+	RTreeInitPVars(p, n, minfill);
+	if (minfill < 1)
+		minfill = 1;
+
+	for (dim = 0; dim < NUMDIMS; dim++) {
+		/**
+		 * @brief 키가 음수이면 아래쪽 경계에 더 가깝습니다.
+		 */
+		for (i = 0, low = 0; i < n; i++) {
+			key[dim][i] = ((RectDist)buf[i].rect.boundary[dim] -
+				       cover->boundary[dim]) -
+				      (cover->boundary[dim + NUMDIMS] -
+				       buf[i].rect.boundary[dim + NUMDIMS]);
+			low += key[dim][i] < 0;
+		}
+		RTreeSortKeys(order[dim], key[dim], n);
+		worst = low > n - low ? low : n - low;
+		if (low < minfill)
+			low = minfill;
+		else if (low > n - minfill)
+			low = n - minfill;
+		split[dim] = low;
+
+		RTreeSplitCovers(t, order[dim], n, head, tail);
+		overlap = RTreeOverlapArea(&head[low], &tail[low]);
+		area = RTreeRectArea(&head[low]) + RTreeRectArea(&tail[low]);
+		if (dim == 0 || worst < bestWorst ||
+		    (worst == bestWorst &&
+		     (overlap < bestOverlap ||
+		      (overlap == bestOverlap && area < bestArea)))) {
+			bestWorst = worst;
+			bestOverlap = overlap;
+			bestArea = area;
+			bestDim = dim;
+		}
+	}
+
+	for (i = 0; i < n; i++)
+		RTreeClassify(t, order[bestDim][i], i < split[bestDim] ? 0 : 1,
+			      p);
 }
 
+/**
+ * @brief 분할 방법별로 파티션을 찾는 함수입니다. (enum RTreeSplitMethod 순서)
+ */
+static void (*const RTreeMethods[METHODS])(struct RTree *,
+					   struct PartitionVars *, int) = {
+	RTreeMethodZero,
+	RTreeMethodRStar,
+	RTreeMethodQuadratic,
+	RTreeMethodAngTan,
+	RTreeMethodZero, /**< Hilbert R-tree는 hilbert.c에서 직접 나눕니다 */
+};
+
 /**
  * @brief 파티션에 기반해서 2개의 노드들에 버퍼로부터 브랜치에 복사해서 넣습니다.
  *
+ * @param t 트리에 해당합니다.
  * @param N 노드 1
  * @param Q 노드 2
  * @param P 파티션에 해당합니다.
  */
-static void RTreeLoadNodes(struct Node *N, struct Node *Q,
+static void RTreeLoadNodes(struct RTree *t, struct Node *N, struct Node *Q,
 			   struct PartitionVars *P)
 {
+	register struct Branch *buf = t->split.BranchBuf;
 	register struct Node *n = N, *q = Q;
 	register struct PartitionVars *p = P;
 	register int i;
@@ -271,11 +599,11 @@ static void RTreeLoadNodes(struct Node *N, struct Node *Q,
 	assert(q);
 	assert(p);
 
-	for (i = 0; i < NODECARD + 1; i++) {
+	for (i = 0; i < p->total; i++) {
 		if (p->partition[i] == 0)
-			RTreeAddBranch(&BranchBuf[i], n, NULL);
+			RTreeAddBranch(t, &buf[i], n, NULL);
 		else if (p->partition[i] == 1)
-			RTreeAddBranch(&BranchBuf[i], q, NULL);
+			RTreeAddBranch(t, &buf[i], q, NULL);
 		else
 			assert(FALSE);
 	}
@@ -285,11 +613,13 @@ static void RTreeLoadNodes(struct Node *N, struct Node *Q,
  * @brief 노드를 split 하도록 합니다. 노드의 브랜치들과 기타 등등을 2개의 노드로 변경합니다.
  * 새로운 노드들은 이전의 노드와 새로운 노드로 구성됩니다.
  *
+ * @param t 트리에 해당합니다.
  * @param n split의 대상이 되는 노드에 해당합니다.
  * @param b 현재의 branch 정보입니다.
  * @param nn node들에 대한 인덱스 정보를 가집니다.
  */
-void RTreeSplitNode(struct Node *n, struct Branch *b, struct Node **nn)
+void RTreeSplitNode(struct RTree *t, struct Node *n, struct Branch *b,
+		    struct Node **nn)
 {
 	register struct PartitionVars *p;
 	register int level;
@@ -301,20 +631,84 @@ void RTreeSplitNode(struct Node *n, struct Branch *b, struct Node **nn)
 	 * @brief 모든 브랜치를 버퍼에 넣고 이전의 노드를 초기화 합니다.
 	 */
 	level = n->level;
-	RTreeGetBranches(n, b);
+	RTreeGetBranches(t, n, b);
 
 	/**
-	 * 파티션을 찾도록 합니다. 이때, 0번 방법(Linear Split)을 사용해서 찾습니다.
+	 * 파티션을 찾도록 합니다. 이때, 트리에 설정된 방법을 사용해서 찾습니다.
 	 */
-	p = &Partitions[0];
-	RTreeMethodZero(p, level > 0 ? MinNodeFill : MinLeafFill);
+	p = &t->split.Partitions[t->method];
+	RTreeMethods[t->method](t, p,
+				level > 0 ? MinNodeFill(t) : MinLeafFill(t));
 
 	/**
 	 * @brief 현재 선택된 파티션에 따라서 2개의 노드를 버퍼에서 브랜치로 넣습니다.
 	 *
 	 */
-	*nn = RTreeNewNode();
+	*nn = RTreeNewNode(t);
 	(*nn)->level = n->level = level;
-	RTreeLoadNodes(n, *nn, p);
-	assert(n->count + (*nn)->count == NODECARD + 1);
+	RTreeLoadNodes(t, n, *nn, p);
+	assert(n->count + (*nn)->count == p->total);
+}
+
+/**
+ * @brief R*-tree에서 넘친 노드의 일부 브랜치를 분할 대신 재삽입하도록 합니다.
+ *
+ * @details 한 번의 삽입에서 level마다 처음 넘친 노드에 대해서만 수행합니다.
+ * 노드를 감싸는 사각형의 중심에서 먼 RSTAR_REINSERT개의 브랜치를 노드에서
+ * 빼서 재삽입 버퍼에 넣고, 나머지는 노드에 다시 넣습니다. 재삽입은 뺀
+ * 브랜치 중에서 가까운 것부터 하도록 버퍼의 뒤쪽에 가까운 것을 둡니다.
+ *
+ * @param t 트리에 해당합니다.
+ * @param n 꽉찬 노드를 가리킵니다. 루트가 아니어야 합니다.
+ * @param b 추가적인 브랜치에 해당합니다.
+ *
+ * @return 재삽입 버퍼로 옮긴 경우 1, 분할해야 하는 경우 0
+ */
+int RTreeReinsertOverflow(struct RTree *t, struct Node *n, struct Branch *b)
+{
+	register struct SplitVars *s = &t->split;
+	register int i, j, k;
+	RectArea center[NUMDIMS], dist[ANYMAXCARD + 1];
+	int order[ANYMAXCARD + 1];
+	int level = n->level, keep;
+	struct Rect *r;
+	RectArea d;
+
+	assert(n != t->root);
+	if (t->method != RTREE_RSTAR || level >= RTREE_MAX_DEPTH ||
+	    (s->OverflowLevels & (1u << level)))
+		return 0;
+	s->OverflowLevels |= 1u << level;
+
+	RTreeGetBranches(t, n, b);
+	n->level = level;
+
+	for (i = 0; i < NUMDIMS; i++)
+		center[i] = ((RectArea)s->CoverSplit.boundary[i] +
+			     s->CoverSplit.boundary[i + NUMDIMS]) /
+			    2;
+	for (i = 0; i < s->BranchCount; i++) {
+		r = &s->BranchBuf[i].rect;
+		dist[i] = 0;
+		for (j = 0; j < NUMDIMS; j++) {
+			d = ((RectArea)r->boundary[j] +
+			     r->boundary[j + NUMDIMS]) / 2 - center[j];
+			dist[i] += d * d;
+		}
+		for (k = i; k > 0 && dist[order[k - 1]] > dist[i]; k--)
+			order[k] = order[k - 1];
+		order[k] = i;
+	}
+
+	keep = s->BranchCount - RSTAR_REINSERT(s->BranchCount);
+	for (i = 0; i < keep; i++)
+		RTreeAddBranch(t, &s->BranchBuf[order[i]], n, NULL);
+	for (i = s->BranchCount - 1; i >= keep; i--) {
+		assert(s->ReinsertCount <
+		       RTREE_MAX_DEPTH * RSTAR_REINSERT(ANYMAXCARD + 1));
+		s->ReinsertBuf[s->ReinsertCount] = s->BranchBuf[order[i]];
+		s->ReinsertLevel[s->ReinsertCount] = level;
+		s->ReinsertCount++;
+	}
+	return 1;
 }
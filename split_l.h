@@ -1,20 +1,85 @@
-
+/**
+ * @note struct Branch와 MAXCARD가 필요하므로 index.h 안에서 include 됩니다.
+ * 이 파일을 먼저 include 하더라도 index.h가 struct Branch를 정의한 후에
+ * 아래의 정의들이 오도록 guard를 include 뒤에 둡니다.
+ */
 #include "index.h"
 
-#define METHODS 1
+#ifndef __SPLIT_L__
+#define __SPLIT_L__
+
+/**
+ * @brief 노드를 고르고 분할하는 방법입니다.
+ */
+enum RTreeSplitMethod {
+	RTREE_LINEAR = 0, /**< Guttman의 linear split */
+	RTREE_RSTAR, /**< R*-tree의 삽입과 분할 */
+	RTREE_QUADRATIC, /**< Guttman의 quadratic split */
+	RTREE_ANGTAN, /**< Ang과 Tan의 linear split */
+	RTREE_HILBERT_TREE, /**< Hilbert R-tree (RTREE_HILBERT로 빌드한 경우) */
+};
+
+#define METHODS 5
+
+/**
+ * @brief Hilbert 값으로 정렬하는 브랜치입니다.
+ *
+ * @details Hilbert R-tree에서 노드를 나눌 때와 RTreeInsertBatch에서 사용합니다.
+ */
+struct RTreeHilbertEntry {
+	uint64_t key;
+	struct Branch branch;
+};
+
+/**
+ * @brief R*-tree에서 처음 넘친 노드의 브랜치 중 재삽입하는 수입니다. (30%)
+ */
+#define RSTAR_REINSERT(n) ((n)*3 / 10)
 
-struct Branch BranchBuf[MAXCARD + 1];
-int BranchCount;
-struct Rect CoverSplit;
+/**
+ * @brief R*-tree에서 겹침의 증가량을 계산할 후보 브랜치의 수입니다.
+ */
+#define RSTAR_CHOOSE_P 32
 
 /**
  * @brief 파티션을 찾는 변수입니다.
  */
 struct PartitionVars {
-	int partition[MAXCARD + 1];
+	int partition[ANYMAXCARD + 1];
 	int total, minfill;
-	int taken[MAXCARD + 1];
+	int taken[ANYMAXCARD + 1];
 	int count[2];
 	struct Rect cover[2];
-	RectReal area[2];
-} Partitions[METHODS];
+	RectArea area[2];
+};
+
+/**
+ * @brief 노드를 분할할 때 사용하는 작업 공간입니다.
+ *
+ * @details 트리마다 하나씩 가지므로 서로 다른 트리는 동시에 분할할 수 있습니다.
+ */
+struct SplitVars {
+	struct Branch BranchBuf[ANYMAXCARD + 1];
+	int BranchCount;
+	struct Rect CoverSplit;
+	struct PartitionVars Partitions[METHODS];
+
+	/**
+	 * @brief R*-tree의 강제 재삽입을 기다리는 브랜치들입니다.
+	 *
+	 * @details 한 번의 삽입에서 level마다 한 번씩만 재삽입하므로
+	 * level의 수만큼의 공간이면 충분합니다.
+	 */
+	struct Branch ReinsertBuf[RTREE_MAX_DEPTH * RSTAR_REINSERT(ANYMAXCARD + 1)];
+	int ReinsertLevel[RTREE_MAX_DEPTH * RSTAR_REINSERT(ANYMAXCARD + 1)];
+	int ReinsertCount;
+	uint32_t OverflowLevels; /**< 이번 삽입에서 재삽입을 한 level들 */
+#ifdef RTREE_HILBERT
+	/**
+	 * @brief 넘친 노드와 형제 노드의 브랜치들을 다시 나누는 데 사용합니다.
+	 */
+	struct RTreeHilbertEntry HilbertBuf[2 * ANYMAXCARD + 1];
+#endif
+};
+
+#endif
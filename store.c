@@ -0,0 +1,385 @@
+#include "index.h"
+#include "assert.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @file store.c
+ * @brief 트리를 페이지 단위의 파일로 저장하고 mmap으로 여는 함수들입니다.
+ *
+ * @details 파일은 PGSIZE 크기의 페이지들이며, 0번 페이지는 헤더이고 나머지
+ * 페이지에는 노드가 하나씩 그대로 들어갑니다. 노드는 루트부터 level 순서(BFS)로
+ * 놓이므로 내장 노드들은 파일의 앞쪽에 모이고, 포인터 대신 페이지 번호를
+ * 가집니다. 부모가 없는 경우의 페이지 번호는 헤더의 번호인 0입니다.
+ *
+ * RTreeOpen은 파일을 MAP_PRIVATE로 매핑한 후에 내장 노드가 가진 페이지 번호만
+ * 포인터로 바꿉니다. leaf 노드는 건드리지 않으므로 탐색이 처음 방문할 때
+ * 페이지가 읽히고, 여는 시간은 내장 노드의 수에만 비례합니다.
+ * 연 트리의 탐색은 매핑된 페이지 위에서 그대로 실행됩니다.
+ */
+
+_Static_assert(sizeof(struct Node) <= PGSIZE, "a node must fit in a page");
+
+#define RTREE_FILE_MAGIC "RTREEIDX"
+#define RTREE_FILE_VERSION 1
+#define RTREE_SAVE_PAGES 64 /**< 한 번의 write로 쓰는 페이지 수 */
+
+/**
+ * @brief 0번 페이지에 들어가는 파일의 헤더입니다.
+ *
+ * @details 노드의 모양은 빌드 옵션에 따라 다르므로 같은 옵션으로 빌드한
+ * 경우에만 열 수 있습니다.
+ */
+struct RTreeFileHeader {
+	char magic[8]; /**< RTREE_FILE_MAGIC */
+	uint32_t version; /**< RTREE_FILE_VERSION */
+	uint32_t pgsize; /**< PGSIZE */
+	uint32_t nodesize; /**< sizeof(struct Node) */
+	uint32_t build; /**< RTreeBuildFlags() */
+	int32_t nodecard, leafcard; /**< 트리의 최대 브랜칭 수 */
+	int32_t method, metric; /**< 트리의 삽입 방법과 부피 척도 */
+	uint64_t npages; /**< 헤더를 포함한 페이지의 수 */
+	uint64_t root; /**< 루트의 페이지 번호 */
+	int64_t ndead; /**< 트리에 남아있는 tombstone의 수 */
+};
+
+_Static_assert(sizeof(struct RTreeFileHeader) <= PGSIZE,
+	       "the header must fit in a page");
+
+/**
+ * @brief 노드와 좌표의 모양을 바꾸는 빌드 옵션들을 하나의 값으로 만듭니다.
+ *
+ * @details 파일에 기록해두고 같은 옵션으로 빌드한 경우에만 읽도록 합니다.
+ */
+uint32_t RTreeBuildFlags(void)
+{
+	uint32_t flags = NUMDIMS | sizeof(RectReal) << 8;
+
+#ifdef RTREE_SOA
+	flags |= 1u << 16;
+#endif
+#ifdef RTREE_HILBERT
+	flags |= 1u << 17;
+#endif
+#ifdef RTREE_CONCURRENT
+	flags |= 1u << 18;
+#endif
+#ifdef RTREE_POINTLEAF
+	flags |= 1u << 19;
+#endif
+#ifdef RTREE_INTCOORD
+	flags |= 1u << 20;
+#endif
+	return flags;
+}
+
+static long RTreeCountNodes(struct Node *n)
+{
+	long nodes = 1;
+	int i;
+
+	if (n->level > 0)
+		for (i = 0; i < n->count; i++)
+			nodes += RTreeCountNodes(n->branch[i].child);
+	return nodes;
+}
+
+/**
+ * @brief 버퍼를 모두 씁니다.
+ *
+ * @return 성공 시 0, 실패 시 -1
+ */
+static int RTreeWriteAll(int fd, const char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(fd, buf, len);
+		if (n < 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/**
+ * @brief 파일이 들어있는 디렉터리를 디스크에 씁니다.
+ *
+ * @details rename으로 바꾸거나 새로 만든 파일의 이름이 전원이 꺼진 후에도
+ * 남도록 합니다.
+ *
+ * @param path 디렉터리 안에 있는 파일의 경로
+ *
+ * @return 성공 시 0, 실패 시 -1
+ */
+int RTreeSyncDir(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+	char *dir;
+	int fd, ret;
+
+	if (!slash) {
+		dir = strdup(".");
+	} else {
+		dir = strndup(path, slash == path ? 1 : slash - path);
+	}
+	if (!dir)
+		return -1;
+	fd = open(dir, O_RDONLY);
+	free(dir);
+	if (fd < 0)
+		return -1;
+	ret = fsync(fd);
+	close(fd);
+	return ret;
+}
+
+/**
+ * @brief 노드들을 BFS 순서로 페이지에 담아서 씁니다.
+ *
+ * @details 노드의 자식들은 큐의 뒤에 차례로 붙으므로 큐에서의 위치 + 1이
+ * 자식의 페이지 번호가 됩니다.
+ *
+ * @return 성공 시 0, 실패 시 -1
+ */
+static int RTreeWriteNodes(struct RTree *t, int fd, char *buf, long nnodes)
+{
+	struct Node **queue, *n, *page;
+	uint64_t *parent;
+	long head, tail = 0, npage = 1; /**< 0번 페이지는 이미 버퍼에 있습니다. */
+	int i, ret = 0;
+
+	queue = (struct Node **)malloc(nnodes * sizeof(struct Node *));
+	parent = (uint64_t *)malloc(nnodes * sizeof(uint64_t));
+	if (!queue || !parent) {
+		ret = -1;
+		goto out;
+	}
+	queue[tail] = t->root;
+	parent[tail++] = 0;
+
+	for (head = 0; head < tail; head++) {
+		n = queue[head];
+		page = (struct Node *)(buf + npage * PGSIZE);
+		memset(page, 0, PGSIZE);
+		memcpy(page, n, sizeof(struct Node));
+		page->parent = (struct Node *)(uintptr_t)parent[head];
+#ifdef RTREE_CONCURRENT
+		page->version = page->nsn = page->lsn = 0;
+		page->right = NULL;
+#endif
+		if (n->level > 0) {
+			for (i = 0; i < n->count; i++) {
+				queue[tail] = n->branch[i].child;
+				parent[tail] = head + 1;
+				page->branch[i].child =
+					(struct Node *)(uintptr_t)(++tail);
+			}
+		}
+		if (++npage < RTREE_SAVE_PAGES && head + 1 < tail)
+			continue;
+		if (RTreeWriteAll(fd, buf, npage * PGSIZE)) {
+			ret = -1;
+			goto out;
+		}
+		npage = 0;
+	}
+	assert(tail == nnodes);
+
+out:
+	free(queue);
+	free(parent);
+	return ret;
+}
+
+/**
+ * @brief 트리를 페이지 단위의 파일로 저장합니다.
+ *
+ * @details 같은 디렉터리의 임시 파일에 쓰고 fsync 한 후에 rename으로
+ * 바꾸므로, 저장 중에 프로세스가 죽더라도 path에는 이전 파일이나 새로운
+ * 파일 중 하나가 온전하게 남습니다. RTREE_CONCURRENT로 빌드한 경우에는
+ * 저장하는 동안 삽입과 삭제를 막습니다.
+ *
+ * @param t 저장할 트리에 해당합니다.
+ * @param path 저장할 파일의 경로
+ *
+ * @return 성공 시 0, 실패 시 -1
+ */
+int RTreeSave(struct RTree *t, const char *path)
+{
+	struct RTreeFileHeader *h;
+	char *buf = NULL, *tmp;
+	long nnodes;
+	int fd = -1, ret = -1;
+
+	assert(t && path && t->root);
+
+	tmp = (char *)malloc(strlen(path) + sizeof(".tmp"));
+	if (!tmp)
+		return -1;
+	sprintf(tmp, "%s.tmp", path);
+#ifdef RTREE_CONCURRENT
+	pthread_rwlock_wrlock(&t->lock);
+#endif
+	buf = (char *)malloc(RTREE_SAVE_PAGES * PGSIZE);
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (!buf || fd < 0)
+		goto out;
+
+	nnodes = RTreeCountNodes(t->root);
+	memset(buf, 0, PGSIZE);
+	h = (struct RTreeFileHeader *)buf;
+	memcpy(h->magic, RTREE_FILE_MAGIC, sizeof(h->magic));
+	h->version = RTREE_FILE_VERSION;
+	h->pgsize = PGSIZE;
+	h->nodesize = sizeof(struct Node);
+	h->build = RTreeBuildFlags();
+	h->nodecard = t->nodecard;
+	h->leafcard = t->leafcard;
+	h->method = t->method;
+	h->metric = t->metric;
+	h->npages = nnodes + 1;
+	h->root = 1;
+	h->ndead = t->ndead;
+
+	if (RTreeWriteNodes(t, fd, buf, nnodes) || fsync(fd))
+		goto out;
+	if (close(fd)) {
+		fd = -1;
+		goto out;
+	}
+	fd = -1;
+	if (rename(tmp, path) || RTreeSyncDir(path))
+		goto out;
+	ret = 0;
+
+out:
+#ifdef RTREE_CONCURRENT
+	pthread_rwlock_unlock(&t->lock);
+#endif
+	if (fd >= 0)
+		close(fd);
+	if (ret)
+		unlink(tmp);
+	free(tmp);
+	free(buf);
+	return ret;
+}
+
+/**
+ * @brief 내장 노드가 가진 페이지 번호를 매핑된 페이지의 포인터로 바꿉니다.
+ *
+ * @details 자식이 leaf인 경우에는 자식의 페이지를 읽지 않도록 포인터만 바꾸고
+ * 부모는 고치지 않습니다. 페이지 번호와 level이 맞지 않는 파일은 거부합니다.
+ * leaf 페이지의 level과 데이터 수는 탐색이 처음 읽을 때 RTreeLeafValid로
+ * 확인합니다.
+ *
+ * @return 성공 시 0, 파일이 잘못된 경우 -1
+ */
+static int RTreeSwizzle(char *base, uint64_t npages, struct Node *n)
+{
+	struct Node *c;
+	uint64_t p;
+	int i;
+
+	if (n->level == 0)
+		return 0;
+	if (n->count < 0 || n->count > MAXCARD)
+		return -1;
+	for (i = 0; i < n->count; i++) {
+		p = (uint64_t)(uintptr_t)n->branch[i].child;
+		if (p == 0 || p >= npages)
+			return -1;
+		c = (struct Node *)(base + p * PGSIZE);
+		n->branch[i].child = c;
+		if (n->level == 1)
+			continue;
+		if (c->level != n->level - 1)
+			return -1;
+		c->parent = n;
+		if (RTreeSwizzle(base, npages, c))
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief RTreeSave로 저장한 파일을 mmap으로 열어서 탐색할 수 있는 트리를
+ * 만듭니다.
+ *
+ * @details 연 트리는 탐색(RTreeSearch, 커서, 원 탐색, 최근접 탐색)에만
+ * 사용할 수 있습니다. leaf 노드의 부모 포인터와 id의 위치는 복원하지 않으므로
+ * 삽입이나 삭제를 해서는 안 됩니다. RTreeFreeIndex로 닫습니다.
+ * 열 때는 헤더와 내장 노드만 확인하고 leaf 페이지는 읽지 않으므로, 잘못된
+ * leaf 페이지는 탐색이 처음 읽을 때 찾아서 비어있는 것으로 보고 건너뜁니다.
+ *
+ * @param path 열 파일의 경로
+ *
+ * @return 성공 시 트리, 파일을 열 수 없거나 헤더, 루트, 내장 노드의 형식이
+ * 맞지 않는 경우 NULL
+ */
+struct RTree *RTreeOpen(const char *path)
+{
+	struct RTreeFileHeader *h;
+	struct RTree *t = NULL;
+	struct stat st;
+	char *base;
+	int fd;
+
+	assert(path);
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) < 0 || st.st_size < 2 * PGSIZE ||
+	    st.st_size % PGSIZE) {
+		close(fd);
+		return NULL;
+	}
+	base = (char *)mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return NULL;
+
+	h = (struct RTreeFileHeader *)base;
+	if (memcmp(h->magic, RTREE_FILE_MAGIC, sizeof(h->magic)) ||
+	    h->version != RTREE_FILE_VERSION || h->pgsize != PGSIZE ||
+	    h->nodesize != sizeof(struct Node) ||
+	    h->build != RTreeBuildFlags() ||
+	    h->npages != (uint64_t)st.st_size / PGSIZE || h->root == 0 ||
+	    h->root >= h->npages || h->nodecard < 1 || h->nodecard > MAXCARD ||
+	    h->leafcard < 1 || h->leafcard > LEAFMAXCARD)
+		goto fail;
+
+	t = RTreeNewIndex();
+	if (!t)
+		goto fail;
+	RTreeFreeNode(t, t->root);
+	t->root = (struct Node *)(base + h->root * PGSIZE);
+	t->map = base;
+	t->map_size = st.st_size;
+	if (t->root->level < 0 || t->root->level >= RTREE_MAX_DEPTH ||
+	    (t->root->level == 0 && !RTreeLeafValid(t->root)) ||
+	    RTreeSwizzle(base, h->npages, t->root)) {
+		RTreeFreeIndex(t);
+		return NULL;
+	}
+	t->root->parent = NULL;
+	t->nodecard = h->nodecard;
+	t->leafcard = h->leafcard;
+	t->method = h->method;
+	t->metric = h->metric;
+	t->ndead = h->ndead;
+	return t;
+
+fail:
+	munmap(base, st.st_size);
+	return NULL;
+}
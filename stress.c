@@ -0,0 +1,342 @@
+/**
+ * @file stress.c
+ * @brief 여러 스레드에서 삽입, 삭제, 탐색을 동시에 수행한 후에
+ * 같은 연산들을 직렬로 재수행한 트리와 결과를 비교합니다.
+ *
+ * @details `make CONCURRENT=1 stress`로 빌드합니다.
+ * - 1..NSTABLE의 점은 처음에 넣은 후에 지우지 않으므로, 동시에 진행되는
+ *   탐색은 범위 안의 이 점들을 항상 빠짐 없이 한 번씩만 찾아야 합니다.
+ * - 각 writer는 겹치지 않는 id 구간을 가지므로 최종 상태는 연산 순서와
+ *   관계 없이 직렬 재수행의 결과와 같아야 합니다.
+ * - writer는 자신의 id를 모두 넣은 후에 연산을 수행하고, 마지막에 대부분을
+ *   지우므로 탐색 도중에 트리를 다시 채우는 경우도 확인합니다.
+ * - writer들이 같은 노드의 사각형과 집계를 동시에 고치므로, 마지막에는
+ *   모든 브랜치가 자식을 덮고 자식의 데이터 수를 가지는 지도 확인합니다.
+ */
+
+#include "index.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef RTREE_CONCURRENT
+#error "stress.c must be built with 'make CONCURRENT=1 stress'"
+#endif
+
+#define NSTABLE 20000 /**< 지우지 않는 점의 수 */
+#define NWRITERS 4
+#define NREADERS 4
+#define NPERWRITER 20000 /**< writer 하나가 가지는 id의 수 */
+#define NOPS 50000 /**< writer 하나가 수행하는 연산의 수 */
+#define KEEP 4 /**< 마지막에 지우지 않고 남기는 id의 간격 */
+#define NQUERIES 500 /**< 최종 비교에 사용하는 탐색의 수 */
+#define NIDS (NSTABLE + NWRITERS * NPERWRITER + 1)
+#define SPACE 1000.0 /**< 점들이 놓이는 공간의 크기 */
+
+static struct Rect points[NIDS]; /**< id별 점의 위치 */
+static tid_t *ops[NWRITERS]; /**< writer별 연산 기록 (id가 없으면 삽입, 있으면 삭제) */
+static bool final_live[NIDS]; /**< 모든 연산 후에 트리에 있어야 하는 점 */
+static struct RTree *tree;
+static int writers_done;
+
+/**
+ * @brief 스레드마다 따로 사용하는 xorshift 난수 생성기입니다.
+ */
+static uint64_t Random(uint64_t *s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+static RectReal RandomReal(uint64_t *s, RectReal max)
+{
+	return (RectReal)(Random(s) % 1000000) / 1000000.0 * max;
+}
+
+/**
+ * @brief 임의의 탐색 범위를 만듭니다.
+ */
+static void RandomQuery(uint64_t *s, struct Rect *q)
+{
+	RectReal w = RandomReal(s, SPACE / 10), h = RandomReal(s, SPACE / 10);
+
+	q->is_use = true;
+	q->boundary[0] = RandomReal(s, SPACE);
+	q->boundary[1] = RandomReal(s, SPACE);
+	q->boundary[2] = q->boundary[0] + w;
+	q->boundary[3] = q->boundary[1] + h;
+}
+
+/**
+ * @brief 탐색 도중 reader가 확인하는 상태입니다.
+ */
+struct Check {
+	struct Rect *query;
+	unsigned *stamp; /**< id별로 마지막으로 찾은 탐색 번호 */
+	unsigned cur; /**< 현재 탐색 번호 */
+	long nstable; /**< 찾은 지우지 않는 점의 수 */
+	long errors;
+	/**
+	 * @brief 같은 id를 두 번 찾는 것을 모두 오류로 볼 지 여부입니다.
+	 *
+	 * @details 탐색 도중에 writer가 점을 지운 후에 다른 leaf에 다시 넣으면
+	 * 탐색이 같은 점을 두 번 만날 수 있으므로, 동시에 탐색하는 경우에는
+	 * 지우지 않는 점에 대해서만 확인합니다.
+	 */
+	bool strict;
+};
+
+static int CheckHit(int id, void *arg)
+{
+	struct Check *c = (struct Check *)arg;
+
+	if (id <= 0 || id >= NIDS || !RTreeOverlap(&points[id], c->query)) {
+		c->errors++;
+		return 1;
+	}
+	if (c->stamp[id] == c->cur && (c->strict || id <= NSTABLE)) {
+		c->errors++;
+		return 1;
+	}
+	c->stamp[id] = c->cur;
+	if (id <= NSTABLE)
+		c->nstable++;
+	return 1;
+}
+
+static void *Reader(void *arg)
+{
+	uint64_t seed = 0x9e3779b97f4a7c15ULL + (uintptr_t)arg;
+	struct Check c = { 0 };
+	struct Rect q;
+	long expected, nsearch = 0;
+	int i;
+
+	c.stamp = (unsigned *)calloc(NIDS, sizeof(unsigned));
+	if (!c.stamp)
+		return (void *)-1L;
+	c.query = &q;
+	while (!__atomic_load_n(&writers_done, __ATOMIC_ACQUIRE)) {
+		RandomQuery(&seed, &q);
+		c.cur++;
+		c.nstable = 0;
+		RTreeSearch(tree, &q, CheckHit, &c);
+
+		for (expected = 0, i = 1; i <= NSTABLE; i++)
+			expected += RTreeOverlap(&points[i], &q);
+		if (expected != c.nstable)
+			c.errors++;
+		nsearch++;
+	}
+	fprintf(stderr, "reader %ld: %ld searches, %ld errors\n",
+		(long)(uintptr_t)arg, nsearch, c.errors);
+	free(c.stamp);
+	return (void *)c.errors;
+}
+
+/**
+ * @brief writer w가 가지는 첫 번째 id를 반환합니다.
+ */
+static tid_t WriterBase(int w)
+{
+	return NSTABLE + 1 + (tid_t)w * NPERWRITER;
+}
+
+/**
+ * @brief writer w의 연산 기록을 순서대로 트리에 적용합니다.
+ *
+ * @details 연산 전에 writer의 id를 모두 넣고, 연산 후에는 KEEP의 배수가
+ * 아닌 id를 모두 지웁니다.
+ */
+static void Replay(struct RTree *t, int w)
+{
+	bool live[NPERWRITER];
+	tid_t base = WriterBase(w);
+	tid_t id;
+	int i;
+
+	for (i = 0; i < NPERWRITER; i++) {
+		RTreeInsertRect(t, &points[base + i], base + i, 0);
+		live[i] = true;
+	}
+	for (i = 0; i < NOPS; i++) {
+		id = ops[w][i];
+		if (live[id - base])
+			RTreeDeleteRect(t, &points[id], id);
+		else
+			RTreeInsertRect(t, &points[id], id, 0);
+		live[id - base] = !live[id - base];
+	}
+	for (i = 0; i < NPERWRITER; i++)
+		if (live[i] && (base + i) % KEEP)
+			RTreeDeleteRect(t, &points[base + i], base + i);
+}
+
+static void *Writer(void *arg)
+{
+	Replay(tree, (int)(uintptr_t)arg);
+	return NULL;
+}
+
+/**
+ * @brief 처음부터 있는 점들을 넣은 트리를 만듭니다.
+ */
+static struct RTree *NewStableTree(void)
+{
+	struct RTree *t = RTreeNewIndex();
+	tid_t id;
+
+	if (!t)
+		return NULL;
+	for (id = 1; id <= NSTABLE; id++)
+		RTreeInsertRect(t, &points[id], id, 0);
+	return t;
+}
+
+/**
+ * @brief 서브 트리의 브랜치, 부모 포인터, id 표가 서로 맞는 지를 확인합니다.
+ *
+ * @return 맞지 않는 브랜치의 수
+ */
+static long CheckNode(struct RTree *t, struct Node *n)
+{
+	struct Node *c;
+	struct Rect cover;
+	long errors = 0;
+	int i;
+
+	for (i = 0; i < n->count; i++) {
+		if (n->level == 0) {
+			if (t->leafref[RTreeLeafId(n, i)].leaf != n ||
+			    t->leafref[RTreeLeafId(n, i)].slot != i)
+				errors++;
+			continue;
+		}
+		c = n->branch[i].child;
+		if (c->parent != n || c->level != n->level - 1 ||
+		    n->subcount[i] != RTreeNodeTotal(c))
+			errors++;
+		cover = RTreeNodeCover(c);
+		if (c->count > 0 && !RTreeContained(&cover, &n->branch[i].rect))
+			errors++;
+		errors += CheckNode(t, c);
+	}
+	return errors;
+}
+
+/**
+ * @brief 두 트리와 최종 상태로부터 직접 구한 결과가 같은 지를 비교합니다.
+ *
+ * @return 다른 탐색의 수
+ */
+static long Compare(struct RTree *a, struct RTree *b)
+{
+	uint64_t seed = 12345;
+	struct Check ca = { 0 }, cb = { 0 };
+	struct Rect q;
+	long mismatches = 0, na, nb, nexp;
+	int i, id;
+
+	ca.stamp = (unsigned *)calloc(NIDS, sizeof(unsigned));
+	cb.stamp = (unsigned *)calloc(NIDS, sizeof(unsigned));
+	if (!ca.stamp || !cb.stamp) {
+		free(ca.stamp);
+		free(cb.stamp);
+		return -1;
+	}
+	ca.query = cb.query = &q;
+	ca.strict = cb.strict = true;
+	for (i = 0; i < NQUERIES; i++) {
+		RandomQuery(&seed, &q);
+		ca.cur = cb.cur = i + 1;
+		na = RTreeSearch(a, &q, CheckHit, &ca);
+		nb = RTreeSearch(b, &q, CheckHit, &cb);
+		for (nexp = 0, id = 1; id < NIDS; id++) {
+			if (!final_live[id] || !RTreeOverlap(&points[id], &q))
+				continue;
+			nexp++;
+			if (ca.stamp[id] != ca.cur || cb.stamp[id] != cb.cur)
+				mismatches++;
+		}
+		if (na != nexp || nb != nexp)
+			mismatches++;
+	}
+	mismatches += ca.errors + cb.errors;
+	free(ca.stamp);
+	free(cb.stamp);
+	return mismatches;
+}
+
+int main(void)
+{
+	pthread_t readers[NREADERS], writers[NWRITERS];
+	uint64_t seed = 42;
+	struct RTree *serial;
+	struct RTreeDeleteStats ds;
+	void *ret;
+	long errors = 0;
+	tid_t id, base;
+	int i, w;
+
+	for (id = 1; id < NIDS; id++) {
+		points[id].is_use = true;
+		points[id].boundary[0] = points[id].boundary[2] =
+			RandomReal(&seed, SPACE);
+		points[id].boundary[1] = points[id].boundary[3] =
+			RandomReal(&seed, SPACE);
+	}
+	for (id = 1; id <= NSTABLE; id++)
+		final_live[id] = true;
+	for (w = 0; w < NWRITERS; w++) {
+		ops[w] = (tid_t *)malloc(NOPS * sizeof(tid_t));
+		if (!ops[w]) {
+			fprintf(stderr, "cannot allocate the memory to 'ops'\n");
+			return -1;
+		}
+		base = WriterBase(w);
+		for (id = base; id < base + NPERWRITER; id++)
+			final_live[id] = true;
+		for (i = 0; i < NOPS; i++) {
+			id = base + Random(&seed) % NPERWRITER;
+			ops[w][i] = id;
+			final_live[id] = !final_live[id];
+		}
+		for (id = base; id < base + NPERWRITER; id++)
+			final_live[id] = final_live[id] && id % KEEP == 0;
+	}
+
+	tree = NewStableTree();
+	serial = NewStableTree();
+	if (!tree || !serial) {
+		fprintf(stderr, "cannot allocate the memory to 'tree'\n");
+		return -1;
+	}
+
+	for (i = 0; i < NREADERS; i++)
+		pthread_create(&readers[i], NULL, Reader, (void *)(uintptr_t)i);
+	for (w = 0; w < NWRITERS; w++)
+		pthread_create(&writers[w], NULL, Writer, (void *)(uintptr_t)w);
+	for (w = 0; w < NWRITERS; w++)
+		pthread_join(writers[w], NULL);
+	__atomic_store_n(&writers_done, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < NREADERS; i++) {
+		pthread_join(readers[i], &ret);
+		errors += (long)ret;
+	}
+
+	for (w = 0; w < NWRITERS; w++)
+		Replay(serial, w);
+	errors += Compare(tree, serial);
+	errors += CheckNode(tree, tree->root) + CheckNode(serial, serial->root);
+
+	RTreeGetDeleteStats(tree, &ds);
+	fprintf(stderr, "repacked %ld times\n", ds.repacked);
+	printf("%s: %ld errors\n", errors ? "FAIL" : "OK", errors);
+	RTreeFreeIndex(tree);
+	RTreeFreeIndex(serial);
+	for (w = 0; w < NWRITERS; w++)
+		free(ops[w]);
+	return errors ? 1 : 0;
+}
@@ -7,21 +7,85 @@
  */
 
 #include "index.h"
+#include "cmd.h"
+#include <float.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <unistd.h>
 
 #define MAX_TABLE_SIZE ((0x1 << 20) + 1)
+#ifdef RTREE_INTCOORD
+#define EPSILON 1 /**< 정수 거리는 d2 - r2 < 1, 즉 d2 <= r2로 비교합니다 */
+#else
 #define EPSILON (0.00001)
+#endif
+#define MAX_WORKERS 64 /**< 탐색에 사용하는 최대 스레드의 수 */
+#define MIN_PARALLEL_BATCH 64 /**< 이보다 짧은 탐색 묶음은 혼자 처리합니다 */
+#define OUTBUF_SIZE (1 << 20) /**< 결과를 모아서 쓰는 버퍼의 크기 */
+#define WAL_CHECKPOINT (1 << 20) /**< checkpoint 사이의 기본 갱신 수 */
+#define WAL_RETRY 16 /**< 건너뛴 checkpoint를 간격의 몇 분의 1 후에 다시 시도 */
+
+static struct Rect *rect_tbl; /**< (id, rectangle)에 대한 정보를 가지는 테이블*/
 
 /**
- * @brief 탐색과 관련된 전역 변수에 해당합니다.
+ * @brief 탐색 하나의 입력과 결과에 해당합니다.
  */
-static struct Rect *rect_tbl; /**< (id, rectangle)에 대한 정보를 가지는 테이블*/
-static RectReal cx, cy;
-static RectReal max_d_square;
-static long max_id, nhits;
-static RectReal cur_d;
+struct Query {
+	RectReal cx, cy; /**< 원의 중심 */
+	RectReal cur_d; /**< 원의 반지름 */
+	RectDist max_d_square; /**< 원 안의 점 중 가장 먼 점까지의 거리의 제곱 */
+	long max_id, nhits; /**< 가장 먼 점의 id와 원 안의 점의 수 */
+};
+
+/**
+ * @brief 새로운 id의 삽입을 모아두는 버퍼입니다.
+ *
+ * @details 첫 탐색 전까지 모아둔 삽입은 RTreeBulkLoad로 한 번에 트리를 만드는
+ * 데 사용되고, 그 후에는 탐색이나 다른 갱신이 들어오기 전까지 연속으로 들어온
+ * 삽입을 RTreeInsertBatch로 한 번에 넣습니다.
+ */
+static tid_t *bulk_ids;
+static long nbulk, bulk_size;
+static bool bulk_loading = true;
+
+/**
+ * @brief 갱신(삽입, 삭제) 사이에 연속으로 들어온 탐색들을 모아두는 버퍼입니다.
+ *
+ * @details 트리가 바뀌지 않는 동안의 탐색은 서로 독립적이므로 갱신이 들어오기
+ * 전에 모아둔 탐색들을 여러 스레드에서 나눠서 처리한 후에 입력 순서대로
+ * 출력합니다.
+ */
+static struct Query *batch;
+static long nbatch, batch_size;
+
+/**
+ * @brief 탐색 묶음을 처리하는 스레드 하나에 해당합니다.
+ *
+ * @details 맡은 탐색의 구간 [head, tail)을 64비트 하나(상위 32비트가 head,
+ * 하위 32비트가 tail)에 담아서 CAS로 갱신합니다. 자신은 앞에서부터 하나씩
+ * 가져가고, 자신의 구간이 비면 다른 스레드의 구간에서 뒤쪽 절반을 훔쳐옵니다.
+ */
+struct Worker {
+	pthread_t thread;
+	uint64_t range;
+} __attribute__((aligned(64)));
+
+static struct Worker *workers;
+static int nworkers = 1;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static unsigned long pool_gen; /**< 처리를 시작한 묶음의 수 */
+static int pool_active; /**< 현재 묶음을 처리 중인 스레드의 수 */
+static bool pool_exit;
+static struct RTree *pool_tree;
+
+static struct RTreeWal *wal; /**< RTREE_WAL로 연 로그, 없으면 NULL */
+static long wal_updates; /**< 마지막 checkpoint 후의 갱신 수 */
+static long wal_interval = WAL_CHECKPOINT;
+static long wal_next = WAL_CHECKPOINT; /**< checkpoint를 시도할 갱신 수 */
 
 /**
  * @brief Final Challenge에서 명시된 Command에 대한 열거형을 만듭니다.
@@ -32,57 +96,540 @@ enum { INSERT = '+',
 };
 
 /**
- * @brief 검색 중에 실행되는 Callback Function 입니다.
+ * @brief 원 안의 점의 수와 원 안에서 가장 먼 점을 구합니다.
  *
- * @details Search 중에 이 함수가 불리게 되면 가장 먼저 점의 좌표를 구합니다.
- * `struct Rect`의 경우에 `xmin, ymin, xmax, ymax`로 구성되나,
- * 점의 경우 `xmin == xmax`이고 `ymin == ymax`이므로 `xmin`하고 `ymin`만 구하도록 합니다.
+ * @details 점의 수는 브랜치마다 저장된 서브트리의 점의 수로 구하므로 원 안의
+ * 점을 모두 방문하지 않습니다. 가장 먼 점은 원의 경계에 가까운 브랜치부터
+ * 찾아서 더 가까운 브랜치들은 건너뛰도록 합니다.
  *
- * xmin은struct Rect에서 boundary[0]에 해당하고, ymin은 boundary[1]에 해당합니다.
- * 그리고 이 x, y와 현재 원의 중심인 cx, cy와의 거리(d;d^2은 d_square)를 구합니다.
+ * 점과 원의 중심과의 거리(d;d^2은 d_square)가 원의 반지름(cur_d)과
+ * 같거나 작으면 원 안의 점으로 봅니다. 최대 거리가 같은 점들 중에서는
+ * id가 좀 더 작은 녀석이 출력이 될 수 있도록 합니다.
  *
- * 만약 원의 반지름(cur_d) 보다 d가 적은 경우에는 d가
- * 현재 기록된 최대 거리(max_d; max_d^2은 max_d_square)보다 크면 최대 id와 거리를 갱신하도록 합니다.
+ * @param tree 탐색할 R-Tree에 해당합니다.
+ * @param q 탐색의 입력이며, 결과가 함께 기록됩니다.
  *
- * 추가로 최대 거리가 d와 같은 경우에는 id가 좀 더 작은 녀석이 출력이 될 수 있도록 조정합니다.
- * 그리고 원 안에 있는 점이므로 점의 수를 1 증가 시켜줍니다.
- *
- * @param id 현재 원의 반지름을 기반으로 하는 사각형과 겹치는 점의 id
- * @param arg 사용되지 않음
- *
- * @return 문제가 없는 경우 1을 반환 (현재는 무조건 1을 반환하도록 되어 있습니다.)
  * @note double의 경우 같음의 비교에는 오차가 발생할 수 있으므로
  * fabs(double_value) < EPSILON으로 같다를 표기하도록 합니다.
+ * RTREE_INTCOORD로 빌드한 경우에는 거리의 제곱을 정수로 정확하게 비교합니다.
  *
  * (EPSION은 아주 작은 수를 의미합니다.)
  */
-int SearchCallback(int id, void *arg)
-{
-	struct Rect *r = &rect_tbl[id];
-	RectReal x = r->boundary[0], y = r->boundary[1];
-	RectReal d_square = (cx - x) * (cx - x) + (cy - y) * (cy - y);
-	double cmp = d_square - (cur_d * cur_d);
-	if (r->is_use) { /**< R-Tree 상에 데이터가 존재하는 지 여부 확인 */
-		if (cmp < 0 || fabs(cmp) < EPSILON) {
-			if (d_square > max_d_square) {
-				max_id = id;
-				max_d_square = d_square;
-			} else if (fabs(d_square - max_d_square) < EPSILON) {
-				max_id = (max_id > id) ? id : max_id;
-				max_d_square = d_square;
-			}
-			nhits++;
+static void SearchCircle(struct RTree *tree, struct Query *q)
+{
+	struct RTreeCircle c;
+	tid_t id;
+
+	c.cx = q->cx;
+	c.cy = q->cy;
+	c.r = q->cur_d;
+	c.eps = EPSILON;
+
+	q->max_d_square = -1;
+	q->max_id = -1;
+	q->nhits = RTreeCircleCount(tree, &c);
+	if (q->nhits > 0 &&
+	    RTreeCircleFarthest(tree, &c, &id, &q->max_d_square))
+		q->max_id = (long)id;
+}
+
+/**
+ * @brief 삽입 버퍼의 id를 정렬하기 위한 비교 함수입니다.
+ */
+static int CompareId(const void *a, const void *b)
+{
+	tid_t x = *(const tid_t *)a, y = *(const tid_t *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief 모아둔 삽입들을 트리에 넣습니다.
+ *
+ * @details 첫 번째 호출에서는 모아둔 삽입들로 트리를 만들고 일반적인 삽입
+ * 모드로 전환합니다. 모으는 동안 삭제된 id는 rect_tbl에서 사용되지 않는
+ * 것으로 표시되므로 제외하고, 삭제 후 다시 삽입되어 두 번 기록된 id는
+ * 정렬 후에 한 번만 넣도록 합니다.
+ *
+ * @param tree 데이터를 채울 R-Tree에 해당합니다.
+ *
+ * @return 문제가 없는 경우 0, 메모리 할당에 실패한 경우 -1을 반환합니다.
+ */
+static int BulkFlush(struct RTree *tree)
+{
+	struct Rect *points;
+	long i, n;
+	int ret;
+
+	if (nbulk == 0) {
+		bulk_loading = false;
+		return 0;
+	}
+
+	points = (struct Rect *)malloc(nbulk * sizeof(struct Rect));
+	if (!points)
+		return -1;
+
+	qsort(bulk_ids, nbulk, sizeof(tid_t), CompareId);
+	for (i = 0, n = 0; i < nbulk; i++) {
+		if (!rect_tbl[bulk_ids[i]].is_use)
+			continue;
+		if (n > 0 && bulk_ids[n - 1] == bulk_ids[i])
+			continue;
+		bulk_ids[n] = bulk_ids[i];
+		points[n] = rect_tbl[bulk_ids[i]];
+		n++;
+	}
+
+	ret = bulk_loading ? RTreeBulkLoad(tree, points, bulk_ids, n) :
+			     RTreeInsertBatch(tree, points, bulk_ids, n);
+	free(points);
+	if (ret)
+		return -1;
+	bulk_loading = false;
+	nbulk = 0;
+	return 0;
+}
+
+/**
+ * @brief 삽입을 버퍼에 모아둡니다.
+ *
+ * @param id 삽입된 사각형의 id
+ *
+ * @return 문제가 없는 경우 0, 메모리 할당에 실패한 경우 -1을 반환합니다.
+ */
+static int BulkAppend(tid_t id)
+{
+	tid_t *ids;
+
+	if (nbulk == bulk_size) {
+		bulk_size = bulk_size ? bulk_size * 2 : 1024;
+		ids = (tid_t *)realloc(bulk_ids, bulk_size * sizeof(tid_t));
+		if (!ids)
+			return -1;
+		bulk_ids = ids;
+	}
+	bulk_ids[nbulk++] = id;
+	return 0;
+}
+
+/**
+ * @brief RTREE_STATS 환경 변수가 설정된 경우에 인덱스의 상태를 출력합니다.
+ */
+static void PrintStats(struct RTree *tree)
+{
+	struct RTreeDeleteStats ds;
+	struct RTreeUpdateStats us;
+	struct RTreeWalStats ws;
+	size_t in_use, cached;
+	double n;
+
+	if (!getenv("RTREE_STATS"))
+		return;
+	RTreeMemoryStats(tree, &in_use, &cached);
+	fprintf(stderr, "memory: %zu bytes in use, %zu bytes cached\n", in_use,
+		cached);
+	RTreeGetDeleteStats(tree, &ds);
+	n = ds.deletes ? ds.deletes : 1;
+	fprintf(stderr,
+		"delete: %ld deletes, %ld leaf purges, %ld tree purges, "
+		"%.3f reinserts/delete, %.3f purge visits/delete\n",
+		ds.deletes, ds.leaf_purges, ds.tree_purges, ds.reinserted / n,
+		ds.visited / n);
+	RTreeGetUpdateStats(tree, &us);
+	fprintf(stderr,
+		"update: %ld moves, %ld in place, %ld enlarged, %ld reinserted\n",
+		us.updates, us.inplace, us.enlarged, us.reinserted);
+	if (!wal)
+		return;
+	RTreeGetWalStats(wal, &ws);
+	fprintf(stderr,
+		"wal: %ld recovered, %ld replayed, %ld appends, %ld commits, "
+		"%ld stalls, %ld checkpoints, %ld skipped, %ld failed\n",
+		ws.recovered, ws.replayed, ws.appends, ws.commits, ws.stalls,
+		ws.checkpoints, ws.skipped, ws.failed);
+}
+
+/**
+ * @brief RTREE_LAZY 환경 변수가 설정된 경우에 lazy 삭제를 사용합니다.
+ *
+ * @details 값은 "leaf 비율,트리 비율"(%)이며, 형식이 맞지 않으면 기본
+ * 비율을 사용합니다.
+ */
+static void SetLazy(struct RTree *tree)
+{
+	const char *env = getenv("RTREE_LAZY");
+	int node = RTREE_LAZY_NODE_PCT, whole = RTREE_LAZY_TREE_PCT;
+
+	if (!env)
+		return;
+	if (sscanf(env, "%d,%d", &node, &whole) != 2) {
+		node = RTREE_LAZY_NODE_PCT;
+		whole = RTREE_LAZY_TREE_PCT;
+	}
+	if (!RTreeSetLazyDelete(tree, node, whole))
+		fprintf(stderr, "lazy delete is not available\n");
+}
+
+/**
+ * @brief RTREE_SAVE 환경 변수가 설정된 경우에 최종 트리를 그 경로에
+ * 저장합니다.
+ *
+ * @details 저장한 파일은 RTreeOpen으로 다시 만들지 않고 바로 탐색할 수
+ * 있습니다.
+ */
+static void SaveTree(struct RTree *tree)
+{
+	const char *env = getenv("RTREE_SAVE");
+
+	if (env && RTreeSave(tree, env))
+		fprintf(stderr, "'%s' save failed\n", env);
+}
+
+/**
+ * @brief RTREE_WAL 환경 변수가 설정된 경우에 그 디렉터리의 로그를 열고
+ * 이전에 기록된 데이터를 복구합니다.
+ *
+ * @details 복구한 데이터는 rect_tbl에도 채우고, 이후의 삽입은 모으지 않고
+ * 트리에 넣습니다. checkpoint 사이의 갱신 수는 RTREE_CHECKPOINT 환경 변수로
+ * 정할 수 있습니다.
+ *
+ * @return 문제가 없는 경우 0, 로그를 열거나 복구할 수 없는 경우 -1
+ */
+static int OpenWal(struct RTree *tree)
+{
+	const char *env = getenv("RTREE_WAL");
+	struct RTreeCursor c;
+	struct Rect all, r;
+	tid_t id;
+	int i, ret = 0;
+
+	if (!env)
+		return 0;
+	wal = RTreeWalOpen(env, tree);
+	if (!wal)
+		return -1;
+	env = getenv("RTREE_CHECKPOINT");
+	if (env && atol(env) > 0)
+		wal_interval = atol(env);
+	wal_next = wal_interval;
+
+	for (i = 0; i < NUMDIMS; i++) {
+		all.boundary[i] = -RECTREAL_MAX;
+		all.boundary[i + NUMDIMS] = RECTREAL_MAX;
+	}
+	RTreeCursorOpen(&c, tree, &all);
+	while (RTreeCursorNext(&c, &id, &r)) {
+		if (id >= MAX_TABLE_SIZE) {
+			ret = -1;
+			break;
+		}
+		rect_tbl[id] = r;
+		rect_tbl[id].is_use = true;
+		bulk_loading = false;
+	}
+	RTreeCursorClose(&c);
+	return ret;
+}
+
+/**
+ * @brief 로그가 열려있는 경우에 갱신을 로그에 기록합니다.
+ *
+ * @return 문제가 없는 경우 0, 로그를 쓰지 못한 경우 -1을 반환합니다.
+ */
+static int LogUpdate(char op, long id)
+{
+	if (!wal)
+		return 0;
+	wal_updates++;
+	return op == INSERT ? RTreeWalInsert(wal, &rect_tbl[id], id) :
+			      RTreeWalDelete(wal, id);
+}
+
+/**
+ * @brief 마지막 checkpoint 후에 갱신이 충분히 쌓였으면 checkpoint를
+ * 시작합니다.
+ *
+ * @details 트리가 로그와 같은 상태가 되도록 모아둔 삽입을 먼저 넣으므로
+ * 명령마다 호출할 수 있고, 삽입과 삭제만 이어지는 구간에서도 checkpoint를
+ * 만듭니다. 이전 checkpoint가 진행 중이면 간격의 WAL_RETRY 분의 1만큼 갱신이
+ * 더 쌓인 후에 다시 시도해서, 그동안 삽입을 하나씩 넣게 되지 않도록 합니다.
+ *
+ * @return 문제가 없는 경우 0, 실패한 경우 -1을 반환합니다.
+ */
+static int Checkpoint(struct RTree *tree)
+{
+	int ret;
+
+	if (!wal || wal_updates < wal_next)
+		return 0;
+	if (BulkFlush(tree)) {
+		fprintf(stderr, "bulk insert failed\n");
+		return -1;
+	}
+	ret = RTreeWalCheckpoint(wal, tree);
+	if (ret < 0) {
+		fprintf(stderr, "write-ahead log failed\n");
+		return -1;
+	}
+	if (ret == 0)
+		wal_updates = 0;
+	wal_next = wal_updates + (ret == 0 ? wal_interval :
+					    wal_interval / WAL_RETRY + 1);
+	return 0;
+}
+
+static uint64_t RangePack(uint32_t head, uint32_t tail)
+{
+	return ((uint64_t)head << 32) | tail;
+}
+
+/**
+ * @brief 자신의 구간에서 다음 탐색을 가져옵니다.
+ *
+ * @return 가져온 경우 true, 구간이 비어있는 경우 false
+ */
+static bool WorkerTake(struct Worker *w, long *i)
+{
+	uint64_t r = __atomic_load_n(&w->range, __ATOMIC_ACQUIRE);
+	uint32_t head, tail;
+
+	do {
+		head = r >> 32;
+		tail = (uint32_t)r;
+		if (head >= tail)
+			return false;
+	} while (!__atomic_compare_exchange_n(&w->range, &r,
+					      RangePack(head + 1, tail), true,
+					      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+	*i = head;
+	return true;
+}
+
+/**
+ * @brief 다른 스레드의 구간에서 뒤쪽 절반을 가져와서 자신의 구간으로 합니다.
+ *
+ * @details 자신의 구간이 빈 상태에서만 호출되므로, 다른 스레드가 자신의
+ * 구간을 동시에 훔쳐가는 일은 없습니다.
+ *
+ * @return 가져온 경우 true, 모든 스레드의 구간이 비어있는 경우 false
+ */
+static bool WorkerSteal(struct Worker *w)
+{
+	int self = w - workers, k;
+	struct Worker *victim;
+	uint64_t r;
+	uint32_t head, tail, half;
+
+	for (k = 1; k < nworkers; k++) {
+		victim = &workers[(self + k) % nworkers];
+		r = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+		do {
+			head = r >> 32;
+			tail = (uint32_t)r;
+			if (head >= tail)
+				break;
+			half = (tail - head + 1) / 2;
+		} while (!__atomic_compare_exchange_n(
+			&victim->range, &r, RangePack(head, tail - half), true,
+			__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+		if (head < tail) {
+			__atomic_store_n(&w->range, RangePack(tail - half, tail),
+					 __ATOMIC_RELEASE);
+			return true;
 		}
 	}
+	return false;
+}
+
+/**
+ * @brief 더 이상 남은 탐색이 없을 때까지 탐색을 처리합니다.
+ */
+static void WorkerRun(struct Worker *w)
+{
+	long i;
+
+	do {
+		while (WorkerTake(w, &i))
+			SearchCircle(pool_tree, &batch[i]);
+	} while (WorkerSteal(w));
+}
+
+/**
+ * @brief 메인 스레드를 제외한 스레드들이 묶음을 기다리는 함수입니다.
+ */
+static void *WorkerMain(void *arg)
+{
+	struct Worker *w = (struct Worker *)arg;
+	unsigned long gen = 0;
+
+	pthread_mutex_lock(&pool_lock);
+	for (;;) {
+		while (gen == pool_gen && !pool_exit)
+			pthread_cond_wait(&pool_start, &pool_lock);
+		if (pool_exit)
+			break;
+		gen = pool_gen;
+		pthread_mutex_unlock(&pool_lock);
+
+		WorkerRun(w);
+
+		pthread_mutex_lock(&pool_lock);
+		if (--pool_active == 0)
+			pthread_cond_signal(&pool_done);
+	}
+	pthread_mutex_unlock(&pool_lock);
+	return NULL;
+}
 
-	return 1; // keep going
+/**
+ * @brief 탐색에 사용할 스레드들을 만듭니다.
+ *
+ * @details 스레드의 수는 RTREE_THREADS 환경 변수로 정할 수 있으며,
+ * 없는 경우에는 온라인 상태인 CPU의 수를 사용합니다. 메인 스레드도
+ * 탐색에 참여하므로 (스레드의 수 - 1)개의 스레드를 새로 만듭니다.
+ *
+ * @return 문제가 없는 경우 0, 실패한 경우 -1을 반환합니다.
+ */
+static int PoolInit(void)
+{
+	const char *env = getenv("RTREE_THREADS");
+	long n = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+	int i;
+
+	if (n < 1)
+		n = 1;
+	if (n > MAX_WORKERS)
+		n = MAX_WORKERS;
+	if (posix_memalign((void **)&workers, 64, n * sizeof(struct Worker)))
+		return -1;
+	for (nworkers = 1; nworkers < n; nworkers++) {
+		i = nworkers;
+		workers[i].range = 0;
+		if (pthread_create(&workers[i].thread, NULL, WorkerMain,
+				   &workers[i]))
+			break;
+	}
+	workers[0].range = 0;
+	return 0;
 }
 
-int main(void)
+/**
+ * @brief 탐색에 사용한 스레드들을 정리합니다.
+ */
+static void PoolFree(void)
 {
-	struct Node *root = RTreeNewIndex();
-	FILE *fin = NULL;
-	FILE *fout = NULL;
+	int i;
+
+	if (!workers)
+		return;
+	pthread_mutex_lock(&pool_lock);
+	pool_exit = true;
+	pthread_cond_broadcast(&pool_start);
+	pthread_mutex_unlock(&pool_lock);
+	for (i = 1; i < nworkers; i++)
+		pthread_join(workers[i].thread, NULL);
+	free(workers);
+	workers = NULL;
+}
+
+/**
+ * @brief 탐색을 묶음에 추가합니다.
+ *
+ * @return 문제가 없는 경우 0, 메모리 할당에 실패한 경우 -1을 반환합니다.
+ */
+static int BatchAppend(struct Query *q)
+{
+	struct Query *qs;
+
+	if (nbatch == batch_size) {
+		batch_size = batch_size ? batch_size * 2 : 1024;
+		qs = (struct Query *)realloc(batch,
+					     batch_size * sizeof(struct Query));
+		if (!qs)
+			return -1;
+		batch = qs;
+	}
+	batch[nbatch++] = *q;
+	return 0;
+}
+
+/**
+ * @brief 모아둔 탐색들을 처리하고 입력 순서대로 결과를 출력합니다.
+ *
+ * @details 트리를 바꾸기 전에 반드시 호출해야 합니다. 각 탐색은 자신의
+ * struct Query에만 결과를 기록하므로 스레드 사이에 공유하는 결과는 없습니다.
+ *
+ * @param tree 탐색할 R-Tree에 해당합니다.
+ * @param fout 결과를 출력할 버퍼
+ *
+ * @return 문제가 없는 경우 0, 파일 쓰기에 실패한 경우 -1을 반환합니다.
+ */
+static int BatchFlush(struct RTree *tree, struct OutBuf *fout)
+{
+	long i, per;
+	int w;
+
+	if (nbatch == 0)
+		return 0;
+
+	if (nworkers == 1 || nbatch < MIN_PARALLEL_BATCH) {
+		for (i = 0; i < nbatch; i++)
+			SearchCircle(tree, &batch[i]);
+	} else {
+		per = nbatch / nworkers;
+		for (w = 0; w < nworkers; w++)
+			workers[w].range = RangePack(
+				w * per, w == nworkers - 1 ? nbatch : (w + 1) * per);
+
+		pthread_mutex_lock(&pool_lock);
+		pool_tree = tree;
+		pool_active = nworkers - 1;
+		pool_gen++;
+		pthread_cond_broadcast(&pool_start);
+		pthread_mutex_unlock(&pool_lock);
+
+		WorkerRun(&workers[0]);
+
+		pthread_mutex_lock(&pool_lock);
+		while (pool_active > 0)
+			pthread_cond_wait(&pool_done, &pool_lock);
+		pthread_mutex_unlock(&pool_lock);
+	}
+
+	for (i = 0; i < nbatch; i++)
+		if (OutResult(fout, batch[i].nhits, batch[i].max_id))
+			return -1;
+	nbatch = 0;
+	return 0;
+}
+
+/**
+ * @brief 명령 파일을 읽어서 수행한 결과를 pout.txt에 기록합니다.
+ *
+ * @details 명령 파일은 첫 번째 인자로 줄 수 있으며, 없으면 pin.txt를 읽습니다.
+ * 파일이 cmdconv로 만든 이진 형식이면 자동으로 이진 형식으로 읽습니다.
+ */
+int main(int argc, char *argv[])
+{
+	const char *path = argc > 1 ? argv[1] : "pin.txt";
+	struct RTree *tree;
+	struct CmdReader fin = { .fd = -1 };
+	struct OutBuf fout = { .fd = -1 };
+	struct Command cmd;
+	int ret;
+
+	tree = RTreeNewIndex();
+	if (!tree) {
+		fprintf(stderr, "cannot allocate the memory to 'tree'\n");
+		return -1;
+	}
+	RTreeSetHugePage(tree, 1);
+	SetLazy(tree);
+	if (PoolInit()) {
+		fprintf(stderr, "cannot allocate the memory to 'workers'\n");
+		RTreeFreeIndex(tree);
+		return -1;
+	}
 
 	rect_tbl = (struct Rect *)calloc(MAX_TABLE_SIZE, sizeof(struct Rect));
 	if (!rect_tbl) {
@@ -90,95 +637,144 @@ int main(void)
 		goto exception;
 	}
 
-	fin = fopen("pin.txt", "r");
-	if (!fin) {
-		fprintf(stderr, "'pin.txt' open failed\n");
+	if (OpenWal(tree)) {
+		fprintf(stderr, "write-ahead log recovery failed\n");
 		goto exception;
 	}
-	fout = fopen("pout.txt", "w");
-	if (!fout) {
+
+	if (CmdOpen(&fin, path)) {
+		fprintf(stderr, "'%s' open failed\n", path);
+		goto exception;
+	}
+	if (OutOpen(&fout, "pout.txt", OUTBUF_SIZE)) {
 		fprintf(stderr, "'pout.txt' open failed\n");
 		goto exception;
 	}
 
-	while (!feof(fin)) {
-		struct Rect rect;
-		char cmd;
-		long id;
+	while ((ret = CmdNext(&fin, &cmd)) > 0) {
+		struct Rect rect, old;
+		struct Query query;
+		long id = cmd.id;
 
-		fscanf(fin, "%c", &cmd);
-		switch (cmd) {
+		switch (cmd.op) {
 		case INSERT:
-			fscanf(fin, " %ld", &id);
-
-			fscanf(fin, " %lf %lf\n", &rect.boundary[0],
-			       &rect.boundary[1]);
-
+			rect.is_use = false;
+			rect.boundary[0] = cmd.x;
+			rect.boundary[1] = cmd.y;
 			/**
 			 * @brief 점이기 때문에 xmax == xmin이고, ymax == ymin이다.
 			 */
 			rect.boundary[2] = rect.boundary[0];
 			rect.boundary[3] = rect.boundary[1];
+			if (BatchFlush(tree, &fout))
+				goto write_failed;
+			if (rect_tbl[id].is_use && BulkFlush(tree)) {
+				fprintf(stderr, "bulk insert failed\n");
+				goto exception;
+			}
+			old = rect_tbl[id];
 			rect_tbl[id] = rect;
 			rect_tbl[id].is_use = true;
-			RTreeInsertRect(&rect_tbl[id], id, &root, 0);
+			if (LogUpdate(INSERT, id))
+				goto wal_failed;
+			if (bulk_loading || !old.is_use) {
+				/**
+				 * @brief 첫 탐색 전의 삽입은 모아서 한 번에 트리를 만들고,
+				 * 그 후에는 연속된 새로운 id의 삽입을 모아서 넣습니다.
+				 */
+				if (BulkAppend(id)) {
+					fprintf(stderr,
+						"cannot allocate the memory to 'bulk_ids'\n");
+					goto exception;
+				}
+				break;
+			}
+			/**
+			 * @brief 이미 있는 id는 새로운 위치로 옮깁니다.
+			 */
+			RTreeUpdateRect(tree, id, &old, &rect_tbl[id]);
 			break;
 		case ERASE:
-			fscanf(fin, " %ld\n", &id);
 			if (!rect_tbl[id].is_use) {
 				break;
 			}
-			RTreeDeleteRect(&rect_tbl[id], id, &root);
+			if (LogUpdate(ERASE, id))
+				goto wal_failed;
+			if (BatchFlush(tree, &fout))
+				goto write_failed;
+			if (!bulk_loading) {
+				if (BulkFlush(tree)) {
+					fprintf(stderr, "bulk insert failed\n");
+					goto exception;
+				}
+				RTreeDeleteId(tree, id);
+			}
 			rect_tbl[id] =
 				(struct Rect){ .is_use = false,
 					       .boundary = { 0, 0, 0, 0 } };
 			break;
 		case SEARCH:
-			fscanf(fin, " %lf %lf", &cx, &cy);
-			fscanf(fin, " %lf\n", &cur_d);
-
-			/**
-			 * @brief 원을 감싸는 사각형을 그리도록 한다.
-			 */
-			rect.boundary[0] = cx - cur_d;
-			rect.boundary[1] = cy - cur_d;
-			rect.boundary[2] = cx + cur_d;
-			rect.boundary[3] = cy + cur_d;
-
-			/**
-			 * @brief 전역 변수를 초기화 합니다.
-			 */
-			nhits = 0;
-			max_d_square = -1;
-			max_id = -1;
-			RTreeSearch(root, &rect, SearchCallback, 0);
-			fprintf(fout, "%ld", nhits);
-			if (nhits == 0) {
-				fprintf(fout, "\r\n");
-			} else {
-				fprintf(fout, " %ld\r\n", max_id);
+			if (BulkFlush(tree)) {
+				fprintf(stderr, "bulk insert failed\n");
+				goto exception;
 			}
+			query.cx = cmd.x;
+			query.cy = cmd.y;
+			query.cur_d = cmd.r;
 
+			if (BatchAppend(&query)) {
+				fprintf(stderr,
+					"cannot allocate the memory to 'batch'\n");
+				goto exception;
+			}
 			break;
-		default:
-			fprintf(stderr, "invalid command\n");
-			goto exception;
 		}
+		if (Checkpoint(tree))
+			goto exception;
 	}
+	if (ret < 0) {
+		fprintf(stderr, "invalid command\n");
+		goto exception;
+	}
+	if (BatchFlush(tree, &fout))
+		goto write_failed;
+	if (BulkFlush(tree)) {
+		fprintf(stderr, "bulk insert failed\n");
+		goto exception;
+	}
+	PrintStats(tree);
+	ret = RTreeWalClose(wal);
+	wal = NULL;
+	if (ret)
+		goto wal_failed;
+	SaveTree(tree);
+	PoolFree();
+	free(batch);
+	free(bulk_ids);
+	RTreeFreeIndex(tree);
 	free(rect_tbl);
-	fclose(fin);
-	fclose(fout);
+	CmdClose(&fin);
+	if (OutClose(&fout))
+		goto write_failed;
 	return 0;
 
+write_failed:
+	fprintf(stderr, "'pout.txt' write failed\n");
+	goto exception;
+wal_failed:
+	fprintf(stderr, "write-ahead log failed\n");
 exception:
-	if (!rect_tbl) {
-		free(rect_tbl);
-	}
-	if (!fin) {
-		fclose(fin);
+	RTreeWalClose(wal);
+	PoolFree();
+	free(batch);
+	free(bulk_ids);
+	RTreeFreeIndex(tree);
+	free(rect_tbl);
+	if (fin.fd >= 0) {
+		CmdClose(&fin);
 	}
-	if (!fout) {
-		fclose(fout);
+	if (fout.fd >= 0) {
+		OutClose(&fout);
 	}
 	return -1;
 }
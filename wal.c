@@ -0,0 +1,887 @@
+#include "index.h"
+#include "assert.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <float.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @file wal.c
+ * @brief 트리의 갱신을 기록하는 write-ahead log와 checkpoint입니다.
+ *
+ * @details 디렉터리 하나에 로그 segment(wal.<번호>)와 checkpoint(ckpt.<번호>)를
+ * 둡니다. 번호는 16자리 16진수이므로 이름 순서가 번호 순서와 같습니다.
+ *
+ * - 갱신은 메모리의 버퍼에 레코드로 덧붙이고, flush 스레드가
+ *   RTREE_WAL_INTERVAL마다 모인 레코드를 한 번에 쓰고 fsync 합니다(group
+ *   commit). 갱신하는 쪽은 fsync를 기다리지 않으며, 디스크에 써졌는지
+ *   확인해야 하는 경우에만 RTreeWalSync로 기다립니다.
+ * - checkpoint는 트리의 데이터를 모은 후에 새로운 segment n으로 바꾸고,
+ *   checkpoint 스레드가 모은 데이터로 꽉 채운 트리를 만들어서 RTreeSave로
+ *   ckpt.n에 저장합니다. 따라서 ckpt.n에는 segment n - 1까지의 갱신이
+ *   모두 들어있으며, 저장이 끝나면 n보다 작은 번호의 파일들을 지웁니다.
+ * - 복구는 열 수 있는 가장 큰 번호의 checkpoint를 RTreeOpen으로 열어서
+ *   트리를 만들고, 그 번호 이상의 segment만 순서대로 다시 적용합니다.
+ *   레코드마다 checksum이 있으므로 마지막 segment의 끝에 반만 써진
+ *   레코드는 버리고 파일을 그 앞까지 자르며, 헤더도 다 써지지 않은 마지막
+ *   segment는 지웁니다. checkpoint가 있는데 하나도 열 수 없거나 segment의
+ *   번호가 이어지지 않으면 갱신을 잃은 것이므로 복구하지 않습니다.
+ */
+
+#define RTREE_WAL_MAGIC "RTREEWAL"
+#define RTREE_WAL_VERSION 1
+#define RTREE_WAL_SEQ_DIGITS 16 /**< 파일 이름의 번호의 자릿수 */
+
+/**
+ * @brief segment의 맨 앞에 있는 헤더입니다.
+ *
+ * @details 헤더 뒤에는 struct RTreeWalRecord가 빈틈 없이 이어집니다.
+ */
+struct RTreeWalHeader {
+	char magic[8]; /**< RTREE_WAL_MAGIC */
+	uint32_t version; /**< RTREE_WAL_VERSION */
+	uint32_t recsize; /**< sizeof(struct RTreeWalRecord) */
+	uint32_t build; /**< RTreeBuildFlags() */
+	uint32_t pad;
+	uint64_t seq; /**< segment의 번호 */
+};
+
+/**
+ * @brief 갱신 하나에 해당하는 로그의 레코드입니다.
+ *
+ * @details 삭제는 rect를 사용하지 않고 0으로 채웁니다.
+ */
+struct RTreeWalRecord {
+	uint64_t lsn; /**< segment 안에서 1부터 1씩 증가하는 번호 */
+	uint32_t op; /**< '+' 또는 '-' */
+	uint32_t sum; /**< sum을 0으로 두고 구한 레코드의 checksum */
+	int64_t id;
+	RectReal boundary[NUMSIDES];
+};
+
+/**
+ * @brief write-ahead log 하나에 해당합니다.
+ */
+struct RTreeWal {
+	char *dir; /* 로그와 checkpoint가 있는 디렉터리 */
+	int fd; /* 쓰고 있는 segment */
+	uint64_t seq; /* 쓰고 있는 segment의 번호 */
+	char *buf; /* 레코드를 덧붙이는 버퍼 */
+	char *spare; /* flush 스레드가 쓰고 있는 버퍼 */
+	size_t len; /* buf에 모인 bytes */
+	uint64_t next_lsn; /* 다음 레코드의 LSN */
+	uint64_t durable; /* fsync가 끝난 마지막 LSN */
+	bool sync; /* 기다리는 쪽이 있어서 바로 써야 함 */
+	bool failed; /* 로그를 쓰지 못해서 이후의 갱신을 받지 않음 */
+	bool exit; /* flush 스레드를 끝냄 */
+	struct RTreeWalStats stats;
+	pthread_mutex_t lock; /* 위의 값들을 보호합니다 */
+	pthread_cond_t flush_cond; /* flush 스레드를 깨웁니다 */
+	pthread_cond_t done_cond; /* 버퍼를 비웠거나 fsync가 끝남 */
+	pthread_t flusher;
+
+	pthread_mutex_t ckpt_lock; /* 아래의 값들을 보호합니다 */
+	pthread_cond_t ckpt_cond;
+	struct Rect *ckpt_rects; /* checkpoint에 넣을 데이터 */
+	tid_t *ckpt_ids;
+	long ckpt_n;
+	uint64_t ckpt_seq; /* 만들 checkpoint의 번호 */
+	bool request; /* checkpoint 스레드가 아직 받지 않은 요청 */
+	bool busy; /* checkpoint를 만드는 중 */
+	bool ckpt_failed; /* 마지막 checkpoint를 만들지 못했고 아직 알리지 않음 */
+	bool ckpt_exit; /* checkpoint 스레드를 끝냄 */
+	pthread_t checkpointer;
+};
+
+/**
+ * @brief 레코드의 FNV-1a checksum을 구합니다.
+ */
+static uint32_t RTreeWalSum(struct RTreeWalRecord *rec)
+{
+	const unsigned char *p = (const unsigned char *)rec;
+	uint32_t saved = rec->sum, h = 2166136261u;
+	size_t i;
+
+	rec->sum = 0;
+	for (i = 0; i < sizeof(*rec); i++)
+		h = (h ^ p[i]) * 16777619u;
+	rec->sum = saved;
+	return h;
+}
+
+/**
+ * @brief 디렉터리 안의 파일 경로를 만듭니다.
+ *
+ * @return 성공 시 해제해야 하는 경로, 메모리가 부족한 경우 NULL
+ */
+static char *RTreeWalPath(const char *dir, const char *kind, uint64_t seq)
+{
+	size_t size = strlen(dir) + strlen(kind) + RTREE_WAL_SEQ_DIGITS + 3;
+	char *path;
+
+	path = (char *)malloc(size);
+	if (path)
+		snprintf(path, size, "%s/%s.%016llx", dir, kind,
+			 (unsigned long long)seq);
+	return path;
+}
+
+static int RTreeWalCompareSeq(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief 디렉터리에서 kind.<번호> 파일들의 번호를 오름차순으로 모읍니다.
+ *
+ * @details 저장 중인 임시 파일(.tmp)처럼 이름이 정확히 맞지 않는 파일은
+ * 무시합니다.
+ *
+ * @return 번호의 수, 실패 시 -1
+ */
+static long RTreeWalList(const char *dir, const char *kind, uint64_t **seqs)
+{
+	size_t klen = strlen(kind);
+	struct dirent *e;
+	uint64_t *tmp;
+	long n = 0, cap = 0;
+	DIR *d;
+
+	*seqs = NULL;
+	d = opendir(dir);
+	if (!d)
+		return -1;
+	while ((e = readdir(d))) {
+		if (strlen(e->d_name) != klen + 1 + RTREE_WAL_SEQ_DIGITS ||
+		    strncmp(e->d_name, kind, klen) || e->d_name[klen] != '.' ||
+		    strspn(e->d_name + klen + 1, "0123456789abcdef") !=
+			    RTREE_WAL_SEQ_DIGITS)
+			continue;
+		if (n == cap) {
+			cap = cap ? cap * 2 : 16;
+			tmp = (uint64_t *)realloc(*seqs, cap * sizeof(*tmp));
+			if (!tmp) {
+				closedir(d);
+				free(*seqs);
+				*seqs = NULL;
+				return -1;
+			}
+			*seqs = tmp;
+		}
+		(*seqs)[n++] = strtoull(e->d_name + klen + 1, NULL, 16);
+	}
+	closedir(d);
+	qsort(*seqs, n, sizeof(uint64_t), RTreeWalCompareSeq);
+	return n;
+}
+
+/**
+ * @brief 버퍼를 모두 씁니다.
+ *
+ * @return 성공 시 0, 실패 시 -1
+ */
+static int RTreeWalWrite(int fd, const char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(fd, buf, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/**
+ * @brief 새로운 segment를 만들고 헤더를 디스크에 씁니다.
+ *
+ * @return 성공 시 segment의 파일 디스크립터, 실패 시 -1
+ */
+static int RTreeWalNewSegment(const char *dir, uint64_t seq)
+{
+	struct RTreeWalHeader h;
+	char *path;
+	int fd;
+
+	path = RTreeWalPath(dir, "wal", seq);
+	if (!path)
+		return -1;
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0666);
+	if (fd < 0) {
+		free(path);
+		return -1;
+	}
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, RTREE_WAL_MAGIC, sizeof(h.magic));
+	h.version = RTREE_WAL_VERSION;
+	h.recsize = sizeof(struct RTreeWalRecord);
+	h.build = RTreeBuildFlags();
+	h.seq = seq;
+	if (RTreeWalWrite(fd, (const char *)&h, sizeof(h)) || fsync(fd) ||
+	    RTreeSyncDir(path)) {
+		close(fd);
+		unlink(path);
+		fd = -1;
+	}
+	free(path);
+	return fd;
+}
+
+/**
+ * @brief 레코드 하나를 트리에 다시 적용합니다.
+ *
+ * @details 삽입은 같은 id의 데이터를 지운 후에 넣으므로 여러 번 적용해도
+ * 결과가 같습니다.
+ *
+ * @return 성공 시 0, 메모리가 부족한 경우 -1
+ */
+static int RTreeWalApply(struct RTree *t, struct RTreeWalRecord *rec)
+{
+	struct Rect r;
+	int i;
+
+	RTreeDeleteId(t, (tid_t)rec->id);
+	if (rec->op != '+')
+		return 0;
+	r.is_use = true;
+	for (i = 0; i < NUMSIDES; i++)
+		r.boundary[i] = rec->boundary[i];
+	return RTreeInsertRect(t, &r, (tid_t)rec->id, 0) < 0 ? -1 : 0;
+}
+
+/**
+ * @brief segment 하나의 레코드들을 순서대로 트리에 적용합니다.
+ *
+ * @details checksum이나 LSN이 맞지 않는 레코드를 만나면 거기서 멈춥니다.
+ * 마지막 segment의 경우에는 쓰다가 멈춘 것이므로 파일을 그 앞까지 자르고,
+ * 그 외의 segment의 경우에는 로그가 손상된 것으로 봅니다. 마지막 segment의
+ * 헤더가 다 써지지 않은 경우에는 레코드도 없으므로 파일을 지웁니다. 남겨두면
+ * 다음 segment가 만들어진 후에는 마지막 segment가 아니게 되어 로그를 다시
+ * 열 수 없습니다.
+ *
+ * @param last 마지막 segment인 지 여부
+ *
+ * @return 성공 시 0, segment를 지운 경우 1,
+ * 로그가 손상되었거나 메모리가 부족한 경우 -1
+ */
+static int RTreeWalReplay(struct RTreeWal *w, struct RTree *t, uint64_t seq,
+			  int last)
+{
+	struct RTreeWalHeader *h;
+	struct RTreeWalRecord rec;
+	struct stat st;
+	char *path, *base = NULL;
+	size_t off = sizeof(*h);
+	uint64_t lsn = 0;
+	int fd, ret = -1;
+
+	path = RTreeWalPath(w->dir, "wal", seq);
+	if (!path)
+		return -1;
+	fd = open(path, O_RDWR);
+	if (fd < 0 || fstat(fd, &st) < 0)
+		goto out;
+	if ((size_t)st.st_size < sizeof(*h))
+		goto torn;
+	base = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (base == MAP_FAILED) {
+		base = NULL;
+		goto out;
+	}
+	madvise(base, st.st_size, MADV_SEQUENTIAL);
+	h = (struct RTreeWalHeader *)base;
+	if (memcmp(h->magic, RTREE_WAL_MAGIC, sizeof(h->magic)) ||
+	    h->version != RTREE_WAL_VERSION ||
+	    h->recsize != sizeof(struct RTreeWalRecord) ||
+	    h->build != RTreeBuildFlags() || h->seq != seq) {
+		if ((size_t)st.st_size == sizeof(*h))
+			goto torn; /**< 헤더를 쓰고 fsync 하기 전에 멈춤 */
+		goto out;
+	}
+
+	for (; off + sizeof(rec) <= (size_t)st.st_size; off += sizeof(rec)) {
+		memcpy(&rec, base + off, sizeof(rec));
+		if (rec.sum != RTreeWalSum(&rec) ||
+		    (rec.op != '+' && rec.op != '-') ||
+		    rec.lsn != lsn + 1)
+			break;
+		if (RTreeWalApply(t, &rec))
+			goto out;
+		lsn = rec.lsn;
+		w->stats.replayed++;
+	}
+	if (off == (size_t)st.st_size)
+		ret = 0;
+	else if (last)
+		ret = ftruncate(fd, off) || fsync(fd) ? -1 : 0;
+	goto out;
+
+torn: /**< 헤더를 쓰다가 멈춤 */
+	if (last && !unlink(path) && !RTreeSyncDir(path))
+		ret = 1;
+out:
+	if (base)
+		munmap(base, st.st_size);
+	if (fd >= 0)
+		close(fd);
+	free(path);
+	return ret;
+}
+
+/**
+ * @brief 트리의 살아있는 데이터를 모두 배열에 모읍니다.
+ *
+ * @return 모은 데이터의 수, 메모리가 부족한 경우 -1
+ */
+static long RTreeWalCollect(struct RTree *t, struct Rect **rects,
+			    tid_t **ids)
+{
+	struct RTreeCursor c;
+	struct Rect all;
+	long n = RTreeNodeTotal(t->root), i = 0;
+	int d;
+
+	*rects = (struct Rect *)malloc((n > 0 ? n : 1) * sizeof(struct Rect));
+	*ids = (tid_t *)malloc((n > 0 ? n : 1) * sizeof(tid_t));
+	if (!*rects || !*ids) {
+		free(*rects);
+		free(*ids);
+		return -1;
+	}
+	for (d = 0; d < NUMDIMS; d++) {
+		all.boundary[d] = -RECTREAL_MAX;
+		all.boundary[d + NUMDIMS] = RECTREAL_MAX;
+	}
+	RTreeCursorOpen(&c, t, &all);
+	while (RTreeCursorNext(&c, &(*ids)[i], &(*rects)[i]))
+		i++;
+	RTreeCursorClose(&c);
+	assert(i == n);
+	return n;
+}
+
+/**
+ * @brief 가장 최근의 checkpoint를 읽고 그 뒤의 로그를 다시 적용합니다.
+ *
+ * @details ckpt.n을 읽은 경우에는 segment n부터, checkpoint가 없는 경우에는
+ * 첫 segment인 1부터 번호가 빠짐없이 이어져야 합니다. segment n은 ckpt.n보다
+ * 먼저 만들어지므로 항상 있어야 합니다. 그 앞의 segment는 checkpoint를 만든
+ * 후에 지웠으므로, 빠진 segment가 있으면 남은 segment만 적용해도 갱신을 잃게
+ * 됩니다.
+ *
+ * @return 성공 시 0, 실패 시 -1
+ */
+static int RTreeWalRecover(struct RTreeWal *w, struct RTree *t)
+{
+	struct RTree *ckpt = NULL;
+	struct Rect *rects;
+	uint64_t *ckpts, *wals, start = 0, next;
+	tid_t *ids;
+	char *path;
+	long nckpt, nwal, n, i;
+	int ret = -1, r;
+
+	nckpt = RTreeWalList(w->dir, "ckpt", &ckpts);
+	nwal = RTreeWalList(w->dir, "wal", &wals);
+	if (nckpt < 0 || nwal < 0)
+		goto out;
+
+	/**
+	 * @brief 저장이 끝나지 않은 checkpoint는 이름이 바뀌지 않았으므로
+	 * 목록에 있는 checkpoint는 모두 온전합니다.
+	 */
+	for (i = nckpt - 1; i >= 0 && !ckpt; i--) {
+		path = RTreeWalPath(w->dir, "ckpt", ckpts[i]);
+		if (!path)
+			goto out;
+		ckpt = RTreeOpen(path);
+		free(path);
+		if (ckpt)
+			start = ckpts[i];
+	}
+	if (nckpt > 0 && !ckpt)
+		goto out; /**< 지운 segment의 갱신을 되살릴 수 없음 */
+	if (ckpt) {
+		n = RTreeWalCollect(ckpt, &rects, &ids);
+		RTreeFreeIndex(ckpt);
+		if (n < 0)
+			goto out;
+		if (n > INT32_MAX || RTreeBulkLoad(t, rects, ids, n)) {
+			free(rects);
+			free(ids);
+			goto out;
+		}
+		free(rects);
+		free(ids);
+		w->stats.recovered = n;
+	}
+
+	next = nckpt > 0 ? start : 1;
+	for (i = 0; i < nwal; i++) {
+		if (wals[i] < start)
+			continue;
+		if (wals[i] != next)
+			goto out; /**< 빠진 segment가 있음 */
+		r = RTreeWalReplay(w, t, wals[i], i == nwal - 1);
+		if (r < 0)
+			goto out;
+		if (r == 0)
+			next++;
+	}
+	if (nckpt > 0 && next == start)
+		goto out; /**< checkpoint 전에 만든 segment n이 없음 */
+	w->seq = next; /**< 지운 segment는 같은 번호로 다시 만듭니다. */
+	ret = 0;
+
+out:
+	free(ckpts);
+	free(wals);
+	return ret;
+}
+
+/**
+ * @brief 버퍼에 모인 레코드를 주기적으로 쓰고 fsync 하는 스레드입니다.
+ *
+ * @details 쓰는 동안에는 잠금을 풀고 다른 버퍼에 갱신을 받으므로 갱신하는
+ * 쪽은 fsync를 기다리지 않습니다.
+ */
+static void *RTreeWalFlusher(void *arg)
+{
+	struct RTreeWal *w = (struct RTreeWal *)arg;
+	struct timespec until;
+	uint64_t lsn;
+	size_t len;
+	char *tmp;
+	int fd, failed;
+
+	pthread_mutex_lock(&w->lock);
+	for (;;) {
+		while (w->len == 0 && !w->exit)
+			pthread_cond_wait(&w->flush_cond, &w->lock);
+		if (w->len == 0) { /**< 남은 레코드가 없을 때만 끝냅니다. */
+			pthread_mutex_unlock(&w->lock);
+			return NULL;
+		}
+		if (!w->sync && !w->exit && w->len < RTREE_WAL_BUFFER / 2) {
+			clock_gettime(CLOCK_REALTIME, &until);
+			until.tv_nsec += RTREE_WAL_INTERVAL * 1000L;
+			if (until.tv_nsec >= 1000000000L) {
+				until.tv_sec++;
+				until.tv_nsec -= 1000000000L;
+			}
+			pthread_cond_timedwait(&w->flush_cond, &w->lock,
+					       &until);
+		}
+
+		tmp = w->spare;
+		w->spare = w->buf;
+		w->buf = tmp;
+		len = w->len;
+		w->len = 0;
+		w->sync = false;
+		lsn = w->next_lsn - 1;
+		fd = w->fd;
+		pthread_cond_broadcast(&w->done_cond);
+		pthread_mutex_unlock(&w->lock);
+
+		failed = RTreeWalWrite(fd, w->spare, len) || fdatasync(fd);
+
+		pthread_mutex_lock(&w->lock);
+		if (failed) {
+			w->failed = true;
+		} else {
+			w->durable = lsn;
+			w->stats.commits++;
+		}
+		pthread_cond_broadcast(&w->done_cond);
+	}
+}
+
+/**
+ * @brief 이전 checkpoint들과 checkpoint에 들어간 segment들을 지웁니다.
+ */
+static void RTreeWalRemoveBefore(struct RTreeWal *w, uint64_t seq)
+{
+	static const char *const kinds[] = { "ckpt", "wal" };
+	uint64_t *seqs;
+	char *path;
+	long n, i;
+	int k;
+
+	for (k = 0; k < 2; k++) {
+		n = RTreeWalList(w->dir, kinds[k], &seqs);
+		for (i = 0; i < n && seqs[i] < seq; i++) {
+			path = RTreeWalPath(w->dir, kinds[k], seqs[i]);
+			if (path)
+				unlink(path);
+			free(path);
+		}
+		free(seqs);
+	}
+}
+
+/**
+ * @brief 모아둔 데이터로 checkpoint를 만드는 스레드입니다.
+ */
+static void *RTreeWalCheckpointer(void *arg)
+{
+	struct RTreeWal *w = (struct RTreeWal *)arg;
+	struct RTree *t;
+	struct Rect *rects;
+	tid_t *ids;
+	char *path;
+	uint64_t seq;
+	long n;
+	int failed;
+
+	for (;;) {
+		pthread_mutex_lock(&w->ckpt_lock);
+		while (!w->request && !w->ckpt_exit)
+			pthread_cond_wait(&w->ckpt_cond, &w->ckpt_lock);
+		if (!w->request) {
+			pthread_mutex_unlock(&w->ckpt_lock);
+			return NULL;
+		}
+		w->request = false;
+		w->busy = true;
+		rects = w->ckpt_rects;
+		ids = w->ckpt_ids;
+		n = w->ckpt_n;
+		seq = w->ckpt_seq;
+		pthread_mutex_unlock(&w->ckpt_lock);
+
+		t = RTreeNewIndex();
+		path = RTreeWalPath(w->dir, "ckpt", seq);
+		failed = !t || !path || RTreeBulkLoad(t, rects, ids, n) ||
+			 RTreeSave(t, path);
+		RTreeFreeIndex(t);
+		free(path);
+		free(rects);
+		free(ids);
+		if (!failed)
+			RTreeWalRemoveBefore(w, seq);
+
+		pthread_mutex_lock(&w->lock);
+		if (failed)
+			w->stats.failed++;
+		else
+			w->stats.checkpoints++;
+		pthread_mutex_unlock(&w->lock);
+		pthread_mutex_lock(&w->ckpt_lock);
+		w->ckpt_failed = failed != 0;
+		w->busy = false;
+		pthread_cond_broadcast(&w->ckpt_cond);
+		pthread_mutex_unlock(&w->ckpt_lock);
+	}
+}
+
+/**
+ * @brief 디렉터리의 로그를 열고 복구한 데이터를 트리에 채웁니다.
+ *
+ * @details 디렉터리가 없으면 만듭니다. 트리는 비어있어야 하며, 가장 최근의
+ * checkpoint와 그 뒤의 로그를 적용한 상태가 됩니다. 이후의 갱신은 새로운
+ * segment에 기록합니다.
+ *
+ * @param dir 로그와 checkpoint를 둘 디렉터리
+ * @param t 복구한 데이터를 채울 빈 트리
+ *
+ * @return 성공 시 로그, 로그가 손상되었거나 실패한 경우 NULL
+ */
+struct RTreeWal *RTreeWalOpen(const char *dir, struct RTree *t)
+{
+	struct RTreeWal *w;
+
+	assert(dir && t);
+
+	if (mkdir(dir, 0777) && errno != EEXIST)
+		return NULL;
+	w = (struct RTreeWal *)calloc(1, sizeof(struct RTreeWal));
+	if (!w)
+		return NULL;
+	w->fd = -1;
+	w->dir = strdup(dir);
+	w->buf = (char *)malloc(RTREE_WAL_BUFFER);
+	w->spare = (char *)malloc(RTREE_WAL_BUFFER);
+	if (!w->dir || !w->buf || !w->spare || RTreeWalRecover(w, t))
+		goto fail;
+	w->fd = RTreeWalNewSegment(w->dir, w->seq);
+	if (w->fd < 0)
+		goto fail;
+	w->next_lsn = 1;
+
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->flush_cond, NULL);
+	pthread_cond_init(&w->done_cond, NULL);
+	pthread_mutex_init(&w->ckpt_lock, NULL);
+	pthread_cond_init(&w->ckpt_cond, NULL);
+	if (pthread_create(&w->flusher, NULL, RTreeWalFlusher, w))
+		goto fail_sync;
+	if (pthread_create(&w->checkpointer, NULL, RTreeWalCheckpointer, w)) {
+		pthread_mutex_lock(&w->lock);
+		w->exit = true;
+		pthread_cond_signal(&w->flush_cond);
+		pthread_mutex_unlock(&w->lock);
+		pthread_join(w->flusher, NULL);
+		goto fail_sync;
+	}
+	return w;
+
+fail_sync:
+	pthread_mutex_destroy(&w->lock);
+	pthread_cond_destroy(&w->flush_cond);
+	pthread_cond_destroy(&w->done_cond);
+	pthread_mutex_destroy(&w->ckpt_lock);
+	pthread_cond_destroy(&w->ckpt_cond);
+fail:
+	if (w->fd >= 0)
+		close(w->fd);
+	free(w->dir);
+	free(w->buf);
+	free(w->spare);
+	free(w);
+	return NULL;
+}
+
+/**
+ * @brief 남은 로그를 디스크에 쓰고 진행 중인 checkpoint를 마친 후에 로그를
+ * 닫습니다.
+ *
+ * @return 모든 갱신이 디스크에 써진 경우 0, 그렇지 못했거나 마지막
+ * checkpoint를 만들지 못한 경우 -1
+ */
+int RTreeWalClose(struct RTreeWal *w)
+{
+	int ret;
+
+	if (!w)
+		return 0;
+	ret = RTreeWalSync(w);
+
+	pthread_mutex_lock(&w->lock);
+	w->exit = true;
+	pthread_cond_signal(&w->flush_cond);
+	pthread_mutex_unlock(&w->lock);
+	pthread_join(w->flusher, NULL);
+	pthread_mutex_lock(&w->ckpt_lock);
+	w->ckpt_exit = true;
+	pthread_cond_signal(&w->ckpt_cond);
+	pthread_mutex_unlock(&w->ckpt_lock);
+	pthread_join(w->checkpointer, NULL);
+	if (w->ckpt_failed)
+		ret = -1;
+
+	if (close(w->fd))
+		ret = -1;
+	pthread_mutex_destroy(&w->lock);
+	pthread_cond_destroy(&w->flush_cond);
+	pthread_cond_destroy(&w->done_cond);
+	pthread_mutex_destroy(&w->ckpt_lock);
+	pthread_cond_destroy(&w->ckpt_cond);
+	free(w->dir);
+	free(w->buf);
+	free(w->spare);
+	free(w);
+	return ret;
+}
+
+/**
+ * @brief 레코드 하나를 버퍼에 덧붙입니다.
+ *
+ * @details 버퍼가 가득 찬 경우에만 flush 스레드가 버퍼를 비울 때까지
+ * 기다립니다.
+ *
+ * @return 성공 시 0, 로그를 쓰지 못한 경우 -1
+ */
+static int RTreeWalAppend(struct RTreeWal *w, struct RTreeWalRecord *rec)
+{
+	pthread_mutex_lock(&w->lock);
+	while (!w->failed && w->len + sizeof(*rec) > RTREE_WAL_BUFFER) {
+		w->stats.stalls++;
+		w->sync = true;
+		pthread_cond_signal(&w->flush_cond);
+		pthread_cond_wait(&w->done_cond, &w->lock);
+	}
+	if (w->failed) {
+		pthread_mutex_unlock(&w->lock);
+		return -1;
+	}
+	rec->lsn = w->next_lsn++;
+	rec->sum = RTreeWalSum(rec);
+	memcpy(w->buf + w->len, rec, sizeof(*rec));
+	w->len += sizeof(*rec);
+	if (w->len == sizeof(*rec) || w->len >= RTREE_WAL_BUFFER / 2)
+		pthread_cond_signal(&w->flush_cond);
+	w->stats.appends++;
+	pthread_mutex_unlock(&w->lock);
+	return 0;
+}
+
+/**
+ * @brief 데이터의 삽입(같은 id가 있으면 옮김)을 로그에 기록합니다.
+ *
+ * @details 트리에는 적용하지 않으므로 호출한 쪽에서 적용해야 합니다.
+ *
+ * @param w 로그에 해당합니다.
+ * @param r 넣을 사각형에 해당합니다.
+ * @param tid 넣을 데이터의 id
+ *
+ * @return 성공 시 0, 로그를 쓰지 못한 경우 -1
+ */
+int RTreeWalInsert(struct RTreeWal *w, struct Rect *r, tid_t tid)
+{
+	struct RTreeWalRecord rec;
+	int i;
+
+	assert(w && r);
+
+	memset(&rec, 0, sizeof(rec));
+	rec.op = '+';
+	rec.id = (int64_t)tid;
+	for (i = 0; i < NUMSIDES; i++)
+		rec.boundary[i] = r->boundary[i];
+	return RTreeWalAppend(w, &rec);
+}
+
+/**
+ * @brief 데이터의 삭제를 로그에 기록합니다.
+ *
+ * @param w 로그에 해당합니다.
+ * @param tid 지울 데이터의 id
+ *
+ * @return 성공 시 0, 로그를 쓰지 못한 경우 -1
+ */
+int RTreeWalDelete(struct RTreeWal *w, tid_t tid)
+{
+	struct RTreeWalRecord rec;
+
+	assert(w);
+
+	memset(&rec, 0, sizeof(rec));
+	rec.op = '-';
+	rec.id = (int64_t)tid;
+	return RTreeWalAppend(w, &rec);
+}
+
+/**
+ * @brief 지금까지 기록한 갱신이 모두 디스크에 써질 때까지 기다립니다.
+ *
+ * @return 성공 시 0, 로그를 쓰지 못한 경우 -1
+ */
+int RTreeWalSync(struct RTreeWal *w)
+{
+	uint64_t lsn;
+	int ret;
+
+	assert(w);
+
+	pthread_mutex_lock(&w->lock);
+	lsn = w->next_lsn - 1;
+	while (!w->failed && w->durable < lsn) {
+		w->sync = true;
+		pthread_cond_signal(&w->flush_cond);
+		pthread_cond_wait(&w->done_cond, &w->lock);
+	}
+	ret = w->durable >= lsn ? 0 : -1;
+	pthread_mutex_unlock(&w->lock);
+	return ret;
+}
+
+/**
+ * @brief 트리의 checkpoint를 시작합니다.
+ *
+ * @details 트리의 데이터를 모으고 새로운 segment로 바꾼 후에 바로 돌아오며,
+ * 트리를 만들고 저장하는 일은 checkpoint 스레드가 합니다. 트리는 지금까지
+ * 기록한 갱신이 모두 적용된 상태여야 하고, 이 함수가 실행되는 동안에는
+ * 다른 스레드에서 갱신을 기록해서는 안 됩니다.
+ *
+ * @param w 로그에 해당합니다.
+ * @param t 로그의 갱신이 적용된 트리
+ *
+ * 이전 checkpoint를 만들지 못한 경우에는 새로 시작하지 않고 그 실패를 한 번
+ * 알리며, 다음 호출에서 다시 시작합니다. 실패한 checkpoint가 가리키던
+ * segment는 지워지지 않으므로 갱신을 잃지는 않습니다.
+ *
+ * @return 시작한 경우 0, 이전 checkpoint가 진행 중이라서 건너뛴 경우 1,
+ * 실패했거나 이전 checkpoint를 만들지 못한 경우 -1
+ */
+int RTreeWalCheckpoint(struct RTreeWal *w, struct RTree *t)
+{
+	struct Rect *rects;
+	tid_t *ids;
+	long n;
+	int fd, old;
+
+	assert(w && t);
+
+	pthread_mutex_lock(&w->ckpt_lock);
+	if (w->ckpt_failed) {
+		w->ckpt_failed = false;
+		pthread_mutex_unlock(&w->ckpt_lock);
+		return -1;
+	}
+	if (w->request || w->busy) {
+		pthread_mutex_unlock(&w->ckpt_lock);
+		pthread_mutex_lock(&w->lock);
+		w->stats.skipped++;
+		pthread_mutex_unlock(&w->lock);
+		return 1;
+	}
+	pthread_mutex_unlock(&w->ckpt_lock);
+
+	n = RTreeWalCollect(t, &rects, &ids);
+	if (n < 0)
+		return -1;
+	if (n > INT32_MAX || RTreeWalSync(w) ||
+	    (fd = RTreeWalNewSegment(w->dir, w->seq + 1)) < 0) {
+		free(rects);
+		free(ids);
+		return -1;
+	}
+
+	pthread_mutex_lock(&w->lock);
+	old = w->fd;
+	w->fd = fd;
+	w->seq++;
+	w->next_lsn = 1;
+	w->durable = 0;
+	pthread_mutex_unlock(&w->lock);
+	close(old);
+
+	pthread_mutex_lock(&w->ckpt_lock);
+	w->ckpt_rects = rects;
+	w->ckpt_ids = ids;
+	w->ckpt_n = n;
+	w->ckpt_seq = w->seq;
+	w->request = true;
+	pthread_cond_signal(&w->ckpt_cond);
+	pthread_mutex_unlock(&w->ckpt_lock);
+	return 0;
+}
+
+/**
+ * @brief 로그에 든 비용을 가져옵니다.
+ *
+ * @param w 로그에 해당합니다.
+ * @param stats 비용이 들어갑니다.
+ */
+void RTreeGetWalStats(struct RTreeWal *w, struct RTreeWalStats *stats)
+{
+	assert(w && stats);
+
+	pthread_mutex_lock(&w->lock);
+	*stats = w->stats;
+	pthread_mutex_unlock(&w->lock);
+}